@@ -0,0 +1,107 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import number, sensor, web_server_base
+from esphome.components.web_server_base import CONF_WEB_SERVER_BASE_ID
+from esphome.const import CONF_ID, CONF_SENSOR, CONF_OFFSET, CONF_PATH
+
+from ..mcp3561.sensor import MCP3561Sensor
+
+DEPENDENCIES = ["mcp3561"]
+MULTI_CONF = True
+
+CONF_VREF = "vref"
+CONF_RANGE = "range"
+CONF_RANGES = "ranges"
+CONF_UNITS_PER_VOLT = "units_per_volt"
+CONF_FACTOR = "factor"
+CONF_SET_COMPENSATION = "set_compensation"
+CONF_SETPOINT = "setpoint"
+CONF_COMMON_MODE = "common_mode"
+CONF_TABLES = "tables"
+
+adc_calibration_ns = cg.esphome_ns.namespace("adc_calibration")
+AdcCalibration = adc_calibration_ns.class_("AdcCalibration", cg.Component)
+AdcCalibrationTableHandler = adc_calibration_ns.class_("AdcCalibrationTableHandler", cg.Component)
+
+
+def validate_range(config):
+    if len(config[CONF_RANGES]) > 1 and CONF_RANGE not in config:
+        raise cv.Invalid(f"{CONF_RANGE} required with multiple {CONF_RANGES}")
+    return config
+
+
+RANGE_SCHEMA = cv.Schema(
+    {
+        # output units per ADC volt, from the hardware design, eg inverse of the divider ratio
+        cv.Required(CONF_UNITS_PER_VOLT): cv.float_,
+        # calibration numbers, multiplied with then added to the nominal value
+        cv.Required(CONF_FACTOR): cv.use_id(number.Number),
+        cv.Required(CONF_OFFSET): cv.use_id(number.Number),
+    }
+)
+
+CONFIG_SCHEMA = cv.All(cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(AdcCalibration),
+        cv.Required(CONF_SENSOR): cv.use_id(MCP3561Sensor),
+        cv.Optional(CONF_VREF, default=3.3): cv.positive_float,
+        cv.Required(CONF_RANGES): cv.All(cv.ensure_list(RANGE_SCHEMA), cv.Length(min=1, max=127)),
+        # returns the active range index, or -1 if none, required with multiple ranges
+        # evaluated as each conversion is read out (from the ADC conversion task), so it should only read state
+        cv.Optional(CONF_RANGE): cv.returning_lambda,
+        # compensation for DAC set-points coupling into the measurement, as factor * (ratio - setpoint ratio)
+        cv.Optional(CONF_SET_COMPENSATION, default=[]): cv.ensure_list(
+            cv.Schema(
+                {
+                    cv.Required(CONF_FACTOR): cv.use_id(number.Number),
+                    cv.Required(CONF_SETPOINT): cv.use_id(sensor.Sensor),
+                }
+            )
+        ),
+        # compensation for another ADC channel coupling into the measurement, as factor * its ratio
+        cv.Optional(CONF_COMMON_MODE): cv.Schema(
+            {
+                cv.Required(CONF_FACTOR): cv.use_id(number.Number),
+                cv.Required(CONF_SENSOR): cv.use_id(MCP3561Sensor),
+            }
+        ),
+        # serves the piecewise-linear residual tables over HTTP, to read and set them
+        # requires the web server (eg, web_server or sample_buffer) to be configured
+        # the tables are applied and persisted regardless
+        cv.Optional(CONF_TABLES): cv.Schema(
+            {
+                cv.GenerateID(): cv.declare_id(AdcCalibrationTableHandler),
+                cv.GenerateID(CONF_WEB_SERVER_BASE_ID): cv.use_id(web_server_base.WebServerBase),
+                cv.Required(CONF_PATH): cv.string_strict,
+            }
+        ),
+    }
+).extend(cv.COMPONENT_SCHEMA), validate_range)
+
+
+async def to_code(config):
+    meas_sensor = await cg.get_variable(config[CONF_SENSOR])
+    var = cg.new_Pvariable(config[CONF_ID], config[CONF_ID].id, meas_sensor, config[CONF_VREF])
+    await cg.register_component(var, config)
+
+    for range_conf in config[CONF_RANGES]:
+        factor = await cg.get_variable(range_conf[CONF_FACTOR])
+        offset = await cg.get_variable(range_conf[CONF_OFFSET])
+        cg.add(var.add_range(range_conf[CONF_UNITS_PER_VOLT], factor, offset))
+    if CONF_RANGE in config:
+        range_lambda = await cg.process_lambda(config[CONF_RANGE], [], return_type=cg.int8)
+        cg.add(var.set_range_function(range_lambda))
+    for compensation_conf in config[CONF_SET_COMPENSATION]:
+        factor = await cg.get_variable(compensation_conf[CONF_FACTOR])
+        setpoint = await cg.get_variable(compensation_conf[CONF_SETPOINT])
+        cg.add(var.add_set_compensation(factor, setpoint))
+    if CONF_COMMON_MODE in config:
+        factor = await cg.get_variable(config[CONF_COMMON_MODE][CONF_FACTOR])
+        common_sensor = await cg.get_variable(config[CONF_COMMON_MODE][CONF_SENSOR])
+        cg.add(var.set_common_mode(factor, common_sensor))
+
+    if tables_config := config.get(CONF_TABLES):
+        cg.add_define("USE_ADC_CALIBRATION_TABLE_HANDLER")
+        base = await cg.get_variable(tables_config[CONF_WEB_SERVER_BASE_ID])
+        handler = cg.new_Pvariable(tables_config[CONF_ID], var, base, tables_config[CONF_PATH])
+        await cg.register_component(handler, tables_config)
@@ -0,0 +1,121 @@
+#include "adc_calibration.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+
+using namespace esphome;
+namespace adc_calibration {
+
+static const char *const TAG = "adc_calibration";
+
+void AdcCalibration::setup() {
+  for (size_t i = 0; i < this->ranges_.size(); i++) {
+    CalibrationRange &cal = this->ranges_[i];
+    PwlTable::Points points;
+    cal.measPref = global_preferences->make_preference<PwlTable::Points>(
+        fnv1_hash(this->name_ + "_meas" + to_string(i)));
+    if (cal.measPref.load(&points)) {
+      cal.measTable.set(points);
+    }
+    cal.setPref = global_preferences->make_preference<PwlTable::Points>(
+        fnv1_hash(this->name_ + "_set" + to_string(i)));
+    if (cal.setPref.load(&points)) {
+      cal.setTable.set(points);
+    }
+  }
+
+  auto recompute = [this](float) { this->recompute(); };
+  for (auto &range : this->ranges_) {
+    range.factor->add_on_state_callback(recompute);
+    range.offset->add_on_state_callback(recompute);
+  }
+  for (auto &compensation : this->setCompensations_) {
+    compensation.factor->add_on_state_callback(recompute);
+    compensation.setpoint->add_on_state_callback(recompute);
+  }
+  if (this->commonModeFactor_ != nullptr) {
+    this->commonModeFactor_->add_on_state_callback(recompute);
+  }
+  this->recompute();
+
+  this->sensor_->set_calibration([this](const mcp3561::Sample &sample) { return this->calibrate(sample); });
+}
+
+void AdcCalibration::dump_config() {
+  ESP_LOGCONFIG(TAG, "AdcCalibration: %s", this->sensor_->get_name().c_str());
+  for (size_t i = 0; i < this->ranges_.size(); i++) {
+    const CalibrationRange &cal = this->ranges_[i];
+    ESP_LOGCONFIG(TAG, "  Range %u: %g units/V, factor %g, offset %g%s%s", i, cal.unitsPerVolt, cal.factor->state,
+                  cal.offset->state, cal.measTable.zero ? "" : ", meas table", cal.setTable.zero ? "" : ", set table");
+  }
+  ESP_LOGCONFIG(TAG, "  Set compensations: %u", this->setCompensations_.size());
+}
+
+void AdcCalibration::recompute() {
+  // adcRatio' = adcRatio * (1 + sum(setFactor)) - sum(setFactor * setpoint) + commonModeFactor * commonModeRatio
+  double ratioGain = 1, ratioOffset = 0;
+  for (const auto &compensation : this->setCompensations_) {
+    float setpoint = compensation.setpoint->has_state() ? compensation.setpoint->state : 0;
+    ratioGain += compensation.factor->state;
+    ratioOffset -= (double) compensation.factor->state * setpoint;
+  }
+  double commonModeFactor = this->commonModeFactor_ != nullptr ? this->commonModeFactor_->state : 0;
+
+  for (auto &cal : this->ranges_) {
+    cal.gain = (double) this->vref_ * cal.unitsPerVolt * cal.factor->state;
+    double countsGain = cal.gain * ratioGain / kCountsPerRatio * kNanoPerUnit;
+    double countsOffset = (cal.gain * ratioOffset + cal.offset->state) * kNanoPerUnit;
+    double commonModeGain = cal.gain * commonModeFactor / kCountsPerRatio * kNanoPerUnit;
+
+    // as many fraction bits as fit at full scale, since coefficient rounding is multiplied by the counts
+    // a calibration number that isn't a number (eg, not yet restored) or is too large to represent makes the
+    // range's values NaN, instead of converting the non-finite values to integers
+    double fullScale = (fabs(countsGain) + fabs(commonModeGain)) * (1 << 23) + fabs(countsOffset) + 1;
+    cal.valid = std::isfinite(fullScale) && fullScale < ldexp(1, kFixedMaxBits - 1);
+    if (!cal.valid) {
+      cal.countsGain = cal.countsOffset = cal.commonModeGain = 0;
+      cal.fractionBits = 1;
+      continue;
+    }
+    int fractionBits = kFixedMaxBits - (int) ceil(log2(fullScale));
+    cal.fractionBits = std::max(1, std::min(fractionBits, 40));
+    double scale = ldexp(1, cal.fractionBits);
+    cal.countsGain = llround(countsGain * scale);
+    cal.countsOffset = llround(countsOffset * scale) + ((int64_t) 1 << (cal.fractionBits - 1));  // round to nearest
+    cal.commonModeGain = llround(commonModeGain * scale);
+  }
+}
+
+void AdcCalibration::set_table(TableType type, size_t range, const PwlTable::Points &points) {
+  CalibrationRange &cal = this->ranges_[range];
+  if (type == kMeasTable) {
+    cal.measTable.set(points);
+    cal.measPref.save(&points);
+  } else {
+    cal.setTable.set(points);
+    cal.setPref.save(&points);
+  }
+}
+
+int64_t AdcCalibration::calibrate_nano(const mcp3561::Sample &sample) const {
+  if (sample.range < 0 || (size_t) sample.range >= this->ranges_.size()) {
+    return INT64_MIN;
+  }
+  const CalibrationRange &cal = this->ranges_[sample.range];
+  if (!cal.valid) {
+    return INT64_MIN;
+  }
+  // the common-mode counts are zero without a common-mode sensor, as is its gain without a factor
+  int64_t value = (int64_t) sample.value * cal.countsGain + cal.countsOffset +
+                  (int64_t) sample.commonModeValue * cal.commonModeGain;
+  value >>= cal.fractionBits;
+  if (!cal.measTable.zero) {
+    value += cal.measTable.correction(sample.value);
+  }
+  return value;
+}
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "esphome/core/component.h"
+#include "esphome/core/preferences.h"
+#include "esphome/components/number/number.h"
+#include "esphome/components/sensor/sensor.h"
+
+#include "../mcp3561/sensor/mcp3561_sensor.h"
+
+#include "pwl_table.h"
+
+using namespace esphome;
+namespace adc_calibration {
+
+const float kCountsPerRatio = 1 << 23;  // MCP3561 ADC counts per ADC ratio (input over vref)
+// calibrated values are computed in integer nano-units (nV, nA), with coefficients in nano-units per ADC count
+// as fixed-point, with fraction bits chosen per range so full-scale products stay under 2^kFixedMaxBits
+const int kFixedMaxBits = 61;
+const double kNanoPerUnit = 1e9;
+
+// measurement calibration of one range, from the ADC ratio, value = ratio * vref * unitsPerVolt * factor + offset
+struct CalibrationRange {
+  float unitsPerVolt;  // output units per ADC volt, from the hardware design
+  number::Number *factor;
+  number::Number *offset;
+
+  // fused coefficients, recomputed on any calibration or set-point change
+  double gain;  // units per ADC ratio, pre-compensation, for the inverse
+  int64_t countsGain;  // fixed-point nano-units per ADC count, including set-point compensation
+  int64_t countsOffset;  // fixed-point nano-units, including set-point compensation and rounding
+  int64_t commonModeGain;  // fixed-point nano-units per common-mode ADC count
+  uint8_t fractionBits;
+  bool valid;  // the coefficients are finite and representable, otherwise values are NaN
+
+  // nonlinear residuals, persisted in preferences
+  PwlTable measTable;  // added to the measured value, by measured ADC counts
+  PwlTable setTable;  // output error at a set-point, subtracted from targets, by target ADC counts
+  ESPPreferenceObject measPref;
+  ESPPreferenceObject setPref;
+};
+
+enum TableType {
+  kMeasTable,
+  kSetTable,
+};
+
+// compensation for a DAC set-point coupling into the measurement, adds factor * (ratio - set-point ratio)
+struct SetCompensation {
+  number::Number *factor;
+  sensor::Sensor *setpoint;  // DAC ratio
+};
+
+// Applies the SMU measurement calibration to a MCP3561 sensor, from its raw ADC counts in one integer
+// multiply-add per conversion, so the full ADC resolution is kept until the value is published as a float, as
+//   adcRatio' = adcRatio + sum(setFactor * (adcRatio - setpointRatio)) + commonModeFactor * commonModeRatio
+//   value = adcRatio' * vref * unitsPerVolt * factor + offset  (of the active range)
+//   value += measTable(adcCounts)  (of the active range)
+// The per-range coefficients are precomputed, and recomputed only when a calibration number or set-point changes
+class AdcCalibration : public Component {
+ public:
+  // name keys the persisted tables, and identifies this calibration to the table handler
+  AdcCalibration(const std::string &name, mcp3561::MCP3561Sensor *sensor, float vref) :
+    name_(name), sensor_(sensor), vref_(vref) {}
+
+  void add_range(float unitsPerVolt, number::Number *factor, number::Number *offset) {
+    this->ranges_.push_back({unitsPerVolt, factor, offset});
+  }
+  void add_set_compensation(number::Number *factor, sensor::Sensor *setpoint) {
+    this->setCompensations_.push_back({factor, setpoint});
+  }
+  // compensation for the ADC ratio of another sensor, eg voltage coupling into current, from its latest conversion
+  // as recorded with each conversion of the measured sensor
+  void set_common_mode(number::Number *factor, mcp3561::MCP3561Sensor *sensor) {
+    this->commonModeFactor_ = factor;
+    this->sensor_->set_common_mode_sensor(sensor);
+  }
+  // returns the active range index, or negative if none (in which case values are NaN), otherwise range 0
+  // evaluated as each conversion is read out and recorded with it, see MCP3561Sensor::set_range_function
+  void set_range_function(std::function<int8_t()> &&range) { this->sensor_->set_range_function(std::move(range)); }
+
+  void setup() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::DATA; }
+
+  // calibrated value of a conversion in its recorded range with its recorded common-mode counts, in nano-units,
+  // or INT64_MIN if it has no range or the range's calibration isn't a number
+  int64_t calibrate_nano(const mcp3561::Sample &sample) const;
+  // calibrated value of a conversion in its recorded range with its recorded common-mode counts, or NaN if it has
+  // no range or the range's calibration isn't a number
+  float calibrate(const mcp3561::Sample &sample) const {
+    int64_t nano = this->calibrate_nano(sample);
+    return nano == INT64_MIN ? NAN : (float) (nano / kNanoPerUnit);
+  }
+  // inverse of the uncompensated linear range calibration, the ADC ratio that measures as value, eg for
+  // measurement thresholds
+  float meas_value_to_ratio(float value, int8_t range) const {
+    const CalibrationRange &cal = this->ranges_[range];
+    return (value - cal.offset->state) / cal.gain;
+  }
+  // inverse of the uncompensated range calibration, the ADC ratio that would measure as value, eg for DAC targets,
+  // with the set-point table correction
+  float value_to_ratio(float value, int8_t range) const {
+    const CalibrationRange &cal = this->ranges_[range];
+    float ratio = this->meas_value_to_ratio(value, range);
+    if (!cal.setTable.zero) {
+      // clamped to the table domain, also so the conversion can't overflow
+      int32_t counts = std::min(std::max(ratio * kCountsPerRatio, -kCountsPerRatio), kCountsPerRatio);
+      ratio -= cal.setTable.correction(counts) / kNanoPerUnit / cal.gain;
+    }
+    return ratio;
+  }
+
+  void recompute();
+
+  const std::string &get_name() const { return this->name_; }
+  mcp3561::MCP3561Sensor *get_sensor() const { return this->sensor_; }
+  size_t range_count() const { return this->ranges_.size(); }
+  const PwlTable &get_table(TableType type, size_t range) const {
+    return type == kMeasTable ? this->ranges_[range].measTable : this->ranges_[range].setTable;
+  }
+  // sets and persists a table, from the main loop
+  void set_table(TableType type, size_t range, const PwlTable::Points &points);
+  // uncompensated calibrated value at a table breakpoint
+  float breakpoint_value(size_t range, size_t index) const {
+    const CalibrationRange &cal = this->ranges_[range];
+    return PwlTable::breakpoint_counts(index) / kCountsPerRatio * cal.gain + cal.offset->state;
+  }
+
+ protected:
+  std::string name_;
+  mcp3561::MCP3561Sensor *sensor_;
+  float vref_;
+  std::vector<CalibrationRange> ranges_;
+  std::vector<SetCompensation> setCompensations_;
+  number::Number *commonModeFactor_ = nullptr;
+};
+
+}
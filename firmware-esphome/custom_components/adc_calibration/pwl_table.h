@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace adc_calibration {
+
+const int kPwlCountsBits = 24;  // table domain, ADC counts in [-2^23, 2^23]
+const int kPwlSegmentBits = 4;  // 16 segments
+const size_t kPwlPoints = (1 << kPwlSegmentBits) + 1;
+
+// Piecewise-linear correction over the ADC count range, as nano-units at uniformly spaced breakpoints
+// (breakpoint i at counts -2^23 + i * 2^(24 - kPwlSegmentBits)), so the segment is found by a shift instead of
+// a search, and interpolated in integer math
+// Counts outside the domain clamp to the end breakpoints
+struct PwlTable {
+  using Points = std::array<int32_t, kPwlPoints>;
+  static const int kSegmentShift = kPwlCountsBits - kPwlSegmentBits;
+
+  Points points{};
+  bool zero = true;  // all points zero, so the correction can be skipped
+
+  void set(const Points &newPoints) {
+    this->points = newPoints;
+    this->zero = std::all_of(newPoints.begin(), newPoints.end(), [](int32_t point) { return point == 0; });
+  }
+
+  static int32_t breakpoint_counts(size_t index) {
+    return -(1 << (kPwlCountsBits - 1)) + (int32_t) (index << kSegmentShift);
+  }
+
+  int32_t correction(int32_t counts) const {
+    int32_t position = std::min(std::max(counts + (1 << (kPwlCountsBits - 1)), 0), (1 << kPwlCountsBits) - 1);
+    size_t segment = position >> kSegmentShift;
+    int32_t fraction = position & ((1 << kSegmentShift) - 1);
+    int32_t start = this->points[segment];
+    return start + (int32_t) (((int64_t) (this->points[segment + 1] - start) * fraction) >> kSegmentShift);
+  }
+};
+
+}
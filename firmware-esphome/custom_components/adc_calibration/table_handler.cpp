@@ -0,0 +1,90 @@
+#include "table_handler.h"
+
+#ifdef USE_ADC_CALIBRATION_TABLE_HANDLER
+
+#include <cstdlib>
+
+using namespace esphome;
+namespace adc_calibration {
+
+static const char *const TAG = "adc_calibration.tables";
+
+static const char *const kTableNames[] = {"meas", "set"};
+
+bool AdcCalibrationTableHandler::canHandle(AsyncWebServerRequest *request) const {
+  if (request->method() == HTTP_GET || request->method() == HTTP_POST) {
+    if (request->url() == this->path_.c_str())
+      return true;
+  }
+
+  return false;
+}
+
+void AdcCalibrationTableHandler::handleRequest(AsyncWebServerRequest *req) {
+  if (req->method() == HTTP_POST) {
+    PendingTable table;
+    if (req->arg("table") == kTableNames[kMeasTable]) {
+      table.type = kMeasTable;
+    } else if (req->arg("table") == kTableNames[kSetTable]) {
+      table.type = kSetTable;
+    } else {
+      req->send(400, "text/plain", "invalid table");
+      return;
+    }
+    char *endptr;
+    std::string rangeArg = req->arg("range");
+    long range = std::strtol(rangeArg.c_str(), &endptr, 10);
+    if (rangeArg.empty() || *endptr != '\0' || range < 0 || (size_t) range >= this->parent_->range_count()) {
+      req->send(400, "text/plain", "invalid range");
+      return;
+    }
+    table.range = range;
+    std::string pointsArg = req->arg("points");
+    const char *pos = pointsArg.c_str();
+    for (size_t i = 0; i < kPwlPoints; i++) {
+      long point = std::strtol(pos, &endptr, 10);
+      char expected = i < kPwlPoints - 1 ? ',' : '\0';
+      if (endptr == pos || *endptr != expected) {
+        req->send(400, "text/plain", "invalid points");
+        return;
+      }
+      table.points[i] = point;
+      pos = endptr + 1;
+    }
+
+    {
+      LockGuard lock(this->lock_);
+      this->pending_.push_back(table);
+    }
+    req->send(200, "text/plain", "");
+    return;
+  }
+
+  AsyncResponseStream *stream = req->beginResponseStream("text/plain; charset=utf-8");
+  LockGuard lock(this->lock_);  // tables are only set from loop() under the lock
+  for (size_t range = 0; range < this->parent_->range_count(); range++) {
+    for (TableType type : {kMeasTable, kSetTable}) {
+      const PwlTable &table = this->parent_->get_table(type, range);
+      stream->printf("%s %u %.9g %.9g ", kTableNames[type], range, this->parent_->breakpoint_value(range, 0),
+                     this->parent_->breakpoint_value(range, kPwlPoints - 1));
+      for (size_t i = 0; i < kPwlPoints; i++) {
+        stream->printf(i < kPwlPoints - 1 ? "%" PRIi32 "," : "%" PRIi32 "\n", table.points[i]);
+      }
+    }
+  }
+  req->send(stream);
+}
+
+void AdcCalibrationTableHandler::loop() {
+  LockGuard lock(this->lock_);
+  for (const auto &table : this->pending_) {
+    this->parent_->set_table(table.type, table.range, table.points);
+    ESP_LOGI(TAG, "Set %s %s table, range %u", this->parent_->get_name().c_str(), kTableNames[table.type],
+             table.range);
+  }
+  this->pending_.clear();
+}
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_ADC_CALIBRATION_TABLE_HANDLER
+
+#include <string>
+#include <vector>
+
+#include "esphome/components/web_server_base/web_server_base.h"
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+
+#include "adc_calibration.h"
+
+using namespace esphome;
+namespace adc_calibration {
+
+// Serves the calibration tables over HTTP, GET returning text lines per table of
+//   (meas|set) (range) (first breakpoint value) (last breakpoint value) (comma-separated nano-unit points)
+// with breakpoint values uncompensated, and POST with args table=(meas|set), range, and points (as above) setting
+// and persisting a table
+class AdcCalibrationTableHandler : public Component, public AsyncWebHandler {
+ public:
+  AdcCalibrationTableHandler(AdcCalibration *parent, web_server_base::WebServerBase *base, const std::string &path) :
+    parent_(parent), base_(base), path_(path) {}
+
+  bool canHandle(AsyncWebServerRequest *request) const override;
+
+  void handleRequest(AsyncWebServerRequest *req) override;
+
+  void setup() override {
+    this->base_->init();
+    this->base_->add_handler(this);
+  }
+  void loop() override;
+  float get_setup_priority() const override {
+    // After WiFi
+    return setup_priority::WIFI - 1.0f;
+  }
+
+ protected:
+  struct PendingTable {
+    TableType type;
+    size_t range;
+    PwlTable::Points points;
+  };
+
+  AdcCalibration *parent_;
+  web_server_base::WebServerBase *base_;
+  std::string path_;
+
+  Mutex lock_;  // guards the tables between the main loop and web server
+  std::vector<PendingTable> pending_;  // set requests from the web server, applied in loop()
+};
+
+}
+
+#endif
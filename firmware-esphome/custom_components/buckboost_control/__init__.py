@@ -0,0 +1,126 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+import esphome.final_validate as fv
+from esphome import automation
+from esphome.components import number, sensor, switch
+from esphome.const import (
+    CONF_ID,
+    CONF_TRIGGER_ID,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    UNIT_EMPTY,
+    UNIT_MICROSECOND,
+)
+
+from ..mcpwm_sync.output import McpwmSyncOutput, CONF_BLANK_TIME
+
+DEPENDENCIES = ["esp32"]
+AUTO_LOAD = ["sensor"]
+
+CONF_BUCK_OUTPUT = "buck_output"
+CONF_BOOST_OUTPUT = "boost_output"
+CONF_ENABLE = "enable"
+CONF_VIN = "vin"
+CONF_SET_VOLTAGE = "set_voltage"
+CONF_MEAS_VOLTAGE = "meas_voltage"
+CONF_PERIOD = "period"
+CONF_RAMP_RATE = "ramp_rate"
+CONF_HEADROOM = "headroom"
+CONF_DEADZONE = "deadzone"
+CONF_MAX_RATIO = "max_ratio"
+CONF_VIN_DROP = "vin_drop"
+CONF_MIN_VIN = "min_vin"
+CONF_ON_TARGET_REACHED = "on_target_reached"
+CONF_JITTER = "jitter"
+CONF_EXECUTION_TIME = "execution_time"
+CONF_RATIO = "ratio"
+
+buckboost_control_ns = cg.esphome_ns.namespace("buckboost_control")
+BuckBoostControl = buckboost_control_ns.class_("BuckBoostControl", cg.Component)
+TargetReachedTrigger = buckboost_control_ns.class_("TargetReachedTrigger", automation.Trigger.template())
+
+
+def stats_sensor_schema(unit, accuracy_decimals=0):
+    return sensor.sensor_schema(
+        unit_of_measurement=unit,
+        accuracy_decimals=accuracy_decimals,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    )
+
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(BuckBoostControl),
+        cv.Required(CONF_BUCK_OUTPUT): cv.use_id(McpwmSyncOutput),
+        cv.Required(CONF_BOOST_OUTPUT): cv.use_id(McpwmSyncOutput),
+        # converter runs while on, and is turned off (ratio 0) while off
+        cv.Required(CONF_ENABLE): cv.use_id(switch.Switch),
+        # converter input voltage, eg USB PD VBus
+        cv.Required(CONF_VIN): cv.use_id(sensor.Sensor),
+        # converter target is the greater of the set and measured output voltage, plus headroom
+        cv.Required(CONF_SET_VOLTAGE): cv.use_id(number.Number),
+        cv.Required(CONF_MEAS_VOLTAGE): cv.use_id(sensor.Sensor),
+        # control task period, the ramp advances by a fixed step each period
+        cv.Optional(CONF_PERIOD, default="2ms"): cv.All(
+            cv.positive_time_period_milliseconds, cv.Range(min=cv.TimePeriod(milliseconds=1))
+        ),
+        cv.Optional(CONF_RAMP_RATE, default=25): cv.positive_float,  # V/s of Vconv
+        cv.Optional(CONF_HEADROOM, default=0.5): cv.float_,  # V
+        # minimum boost and maximum buck duty cycle, so both always switch
+        cv.Optional(CONF_DEADZONE, default=0.03): cv.float_range(min=0, max=0.5),
+        cv.Optional(CONF_MAX_RATIO, default=1.5): cv.positive_float,
+        cv.Optional(CONF_VIN_DROP, default=0.4): cv.float_,  # V, input drop to the converter
+        cv.Optional(CONF_MIN_VIN, default=5.0): cv.positive_float,  # V, lower bound on the Vin estimate
+        # when Vconv reaches its target after ramping
+        cv.Optional(CONF_ON_TARGET_REACHED): automation.validate_automation(
+            {
+                cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(TargetReachedTrigger),
+            }
+        ),
+        # optional control task statistics, the maximum over each statistics interval (10s)
+        cv.Optional(CONF_JITTER): stats_sensor_schema(UNIT_MICROSECOND),
+        cv.Optional(CONF_EXECUTION_TIME): stats_sensor_schema(UNIT_MICROSECOND),
+        cv.Optional(CONF_RATIO): stats_sensor_schema(UNIT_EMPTY, accuracy_decimals=3),
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+
+def _final_validate(config):
+    full_config = fv.full_config.get()
+    for key in (CONF_BUCK_OUTPUT, CONF_BOOST_OUTPUT):
+        output_path = full_config.get_path_for_id(config[key])[:-1]
+        output_config = full_config.get_config_for_path(output_path)
+        if output_config.get(CONF_BLANK_TIME, 0) > 0:  # blanking from the output's loop() would race the task
+            raise cv.Invalid(f"{key} must not have a blank_time, since it is written from the control task")
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
+
+async def to_code(config):
+    buck = await cg.get_variable(config[CONF_BUCK_OUTPUT])
+    boost = await cg.get_variable(config[CONF_BOOST_OUTPUT])
+    enable = await cg.get_variable(config[CONF_ENABLE])
+    vin = await cg.get_variable(config[CONF_VIN])
+    set_voltage = await cg.get_variable(config[CONF_SET_VOLTAGE])
+    meas_voltage = await cg.get_variable(config[CONF_MEAS_VOLTAGE])
+    var = cg.new_Pvariable(config[CONF_ID], buck, boost, enable, vin, set_voltage, meas_voltage)
+    await cg.register_component(var, config)
+
+    cg.add(var.set_period_millis(config[CONF_PERIOD].total_milliseconds))
+    cg.add(var.set_ramp_rate(config[CONF_RAMP_RATE]))
+    cg.add(var.set_headroom(config[CONF_HEADROOM]))
+    cg.add(var.set_deadzone(config[CONF_DEADZONE]))
+    cg.add(var.set_max_ratio(config[CONF_MAX_RATIO]))
+    cg.add(var.set_vin_drop(config[CONF_VIN_DROP]))
+    cg.add(var.set_min_vin(config[CONF_MIN_VIN]))
+
+    for conf in config.get(CONF_ON_TARGET_REACHED, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [], conf)
+
+    for key in (CONF_JITTER, CONF_EXECUTION_TIME, CONF_RATIO):
+        if sensor_config := config.get(key):
+            sens = await sensor.new_sensor(sensor_config)
+            cg.add(getattr(var, f"set_{key}_sensor")(sens))
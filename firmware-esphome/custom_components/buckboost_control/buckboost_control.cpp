@@ -0,0 +1,174 @@
+#include "buckboost_control.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "esp_timer.h"
+#include "esphome/core/log.h"
+
+using namespace esphome;
+namespace buckboost_control {
+
+static const char *const TAG = "buckboost_control";
+
+static const UBaseType_t kTaskPriority = 4;  // above the main loop, below the MCP3561 conversion task
+static const BaseType_t kTaskCore = 1;
+
+void BuckBoostControl::setup() {
+  // the outputs are written from the control task, which blanking from their loop() would race
+  this->buck_->disable_blanking();
+  this->boost_->disable_blanking();
+
+  this->enable_->add_on_state_callback([this](bool state) { this->enabled_ = state; });
+  this->vin_->add_on_state_callback([this](float state) { this->vinVolts_ = state; });
+  this->setVoltage_->add_on_state_callback([this](float state) { this->setVolts_ = state; });
+  this->measVoltage_->add_on_state_callback([this](float state) { this->measVolts_ = state; });
+  this->enabled_ = this->enable_->state;
+  this->vinVolts_ = this->vin_->state;
+  this->setVolts_ = this->setVoltage_->state;
+  this->measVolts_ = this->measVoltage_->state;
+
+  {
+    LockGuard guard(this->lock_);
+    this->write_ratio(0);
+  }
+  if (xTaskCreatePinnedToCore(BuckBoostControl::control_task, "buckboost", 4096, this, kTaskPriority, &this->task_,
+                              kTaskCore) != pdPASS) {
+    ESP_LOGE(TAG, "failed to create control task");
+    this->task_ = nullptr;
+    this->mark_failed();
+    return;
+  }
+  this->statsStartMillis_ = esphome::millis();
+}
+
+void BuckBoostControl::dump_config() {
+  ESP_LOGCONFIG(TAG, "BuckBoostControl:");
+  ESP_LOGCONFIG(TAG, "  Period: %u ms, ramp rate: %.1f V/s", this->periodMillis_, this->rampRate_);
+  ESP_LOGCONFIG(TAG, "  Headroom: %.2f V, deadzone: %.3f, max ratio: %.2f", this->headroom_, this->deadzone_,
+                this->maxRatio_);
+}
+
+void BuckBoostControl::turn_off() {
+  LockGuard guard(this->lock_);
+  this->enabled_ = false;
+  this->write_ratio(0);
+}
+
+void BuckBoostControl::control_task(void *arg) {
+  BuckBoostControl *self = static_cast<BuckBoostControl *>(arg);
+  const TickType_t periodTicks = std::max(pdMS_TO_TICKS(self->periodMillis_), (TickType_t) 1);
+  const int64_t periodMicros = (int64_t) periodTicks * portTICK_PERIOD_MS * 1000;
+  self->stepSeconds_ = periodMicros / 1e6f;  // the actual period, rounded to (at least one) RTOS tick
+
+  TickType_t lastWake = xTaskGetTickCount();
+  vTaskDelayUntil(&lastWake, periodTicks);
+  int64_t scheduledMicros = esp_timer_get_time();  // schedule is relative to the first wake
+  while (true) {
+    int64_t startMicros = esp_timer_get_time();
+    self->control_step();
+    int64_t endMicros = esp_timer_get_time();
+
+    uint32_t jitterMicros = std::abs(startMicros - scheduledMicros);
+    uint32_t execMicros = endMicros - startMicros;
+    {
+      LockGuard guard(self->lock_);
+      self->iterations_++;
+      self->jitterSumMicros_ += jitterMicros;
+      self->jitterMaxMicros_ = std::max(self->jitterMaxMicros_, jitterMicros);
+      self->execSumMicros_ += execMicros;
+      self->execMaxMicros_ = std::max(self->execMaxMicros_, execMicros);
+    }
+
+    vTaskDelayUntil(&lastWake, periodTicks);
+    scheduledMicros += periodMicros;
+  }
+}
+
+void BuckBoostControl::control_step() {
+  LockGuard guard(this->lock_);
+  if (!this->enabled_) {
+    if (this->ratio_ != 0) {
+      this->write_ratio(0);
+    }
+    this->atTarget_ = false;
+    return;
+  }
+
+  // set buck-boost to minimum needed + headroom
+  float vinVolts = std::max(this->minVin_, this->vinVolts_ - this->vinDrop_);  // always expect at least min_vin
+  // must be higher than measured output to avoid the output back-driving Vconv through the FET body diode
+  float targetVolts = std::max((float) this->setVolts_, (float) this->measVolts_) + this->headroom_;
+  float nextVolts = std::min(this->ratio_ * vinVolts + this->rampRate_ * this->stepSeconds_, targetVolts);
+  this->write_ratio(nextVolts / vinVolts);
+
+  bool atTarget = nextVolts == targetVolts;
+  if (atTarget && !this->atTarget_) {
+    this->targetReached_ = true;
+  }
+  this->atTarget_ = atTarget;
+}
+
+void BuckBoostControl::write_ratio(float ratio) {
+  ratio = std::min(std::max(ratio, 0.0f), this->maxRatio_);
+  // initialize DC at ratio = 1
+  float buckDc = 1 - this->deadzone_, boostDc = this->deadzone_;
+  if (ratio == 0) {  // turn off converter
+    buckDc = 0;
+    boostDc = 0;
+  } else if (ratio <= 1) {  // adjust buck dc
+    float boostRatio = 1 / (1 - boostDc);
+    buckDc = ratio / boostRatio;  // offset the minimal boost PWM
+  } else {  // adjust boost dc
+    float boostRatio = ratio / buckDc;  // offset the maximum buck PWM
+    boostDc = 1 - (1 / boostRatio);
+  }
+  this->buck_->write_state(buckDc);
+  this->boost_->write_state(boostDc);
+  this->ratio_ = ratio;
+}
+
+void BuckBoostControl::loop() {
+  if (this->targetReached_.exchange(false)) {
+    this->targetReachedCallback_.call();
+  }
+
+  uint32_t now = esphome::millis();
+  if (now - this->statsStartMillis_ >= kStatsIntervalMillis) {
+    ControlStats stats;
+    float ratio;
+    {
+      LockGuard guard(this->lock_);
+      stats.iterations = this->iterations_;
+      if (this->iterations_ > 0) {
+        stats.jitterAvgMicros = this->jitterSumMicros_ / this->iterations_;
+        stats.execAvgMicros = this->execSumMicros_ / this->iterations_;
+      }
+      stats.jitterMaxMicros = this->jitterMaxMicros_;
+      stats.execMaxMicros = this->execMaxMicros_;
+      this->stats_ = stats;
+      this->iterations_ = 0;
+      this->jitterSumMicros_ = 0;
+      this->jitterMaxMicros_ = 0;
+      this->execSumMicros_ = 0;
+      this->execMaxMicros_ = 0;
+      ratio = this->ratio_;
+    }
+    this->statsStartMillis_ = now;
+
+    ESP_LOGD(TAG, "%u iterations, jitter avg %u us, max %u us, execution avg %u us, max %u us", stats.iterations,
+             stats.jitterAvgMicros, stats.jitterMaxMicros, stats.execAvgMicros, stats.execMaxMicros);
+    if (this->jitterSensor_ != nullptr) {
+      this->jitterSensor_->publish_state(stats.jitterMaxMicros);
+    }
+    if (this->executionTimeSensor_ != nullptr) {
+      this->executionTimeSensor_->publish_state(stats.execMaxMicros);
+    }
+    if (this->ratioSensor_ != nullptr) {
+      this->ratioSensor_->publish_state(ratio);
+    }
+  }
+}
+
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "esphome/core/automation.h"
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+#include "esphome/components/number/number.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/switch/switch.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "../mcpwm_sync/McpwmSyncComponent.h"
+
+using namespace esphome;
+namespace buckboost_control {
+
+const uint32_t kStatsIntervalMillis = 10000;  // interval for logging and publishing statistics
+
+// control task timing over the last statistics interval
+struct ControlStats {
+  uint32_t iterations = 0;
+  uint32_t jitterAvgMicros = 0;  // wake time relative to the fixed schedule
+  uint32_t jitterMaxMicros = 0;
+  uint32_t execAvgMicros = 0;  // control step execution time
+  uint32_t execMaxMicros = 0;
+};
+
+// Ramps the buck-boost converter output (Vconv) to the output target voltage plus headroom, at a fixed rate from
+// a pinned task at a fixed period, so the ramp is independent of main loop timing
+// The converter ratio (Vconv / Vin) is split into buck and boost PWM duty cycles written directly to the MCPWM
+// outputs, with a minimum boost (and maximum buck) duty deadzone so both always switch
+// Inputs (enable, Vin, set and measured voltages) are updated from state callbacks in the main loop
+class BuckBoostControl : public Component {
+ public:
+  BuckBoostControl(mcpwm_sync::McpwmSyncComponent *buck, mcpwm_sync::McpwmSyncComponent *boost,
+                   switch_::Switch *enable, sensor::Sensor *vin, number::Number *setVoltage,
+                   sensor::Sensor *measVoltage) :
+    buck_(buck), boost_(boost), enable_(enable), vin_(vin), setVoltage_(setVoltage), measVoltage_(measVoltage) {}
+
+  void set_period_millis(uint32_t periodMillis) { this->periodMillis_ = periodMillis; }
+  void set_ramp_rate(float voltsPerSecond) { this->rampRate_ = voltsPerSecond; }
+  void set_headroom(float volts) { this->headroom_ = volts; }
+  void set_deadzone(float duty) { this->deadzone_ = duty; }
+  void set_max_ratio(float ratio) { this->maxRatio_ = ratio; }
+  // Vin is estimated as the measured input minus this drop, and at least min_vin
+  void set_vin_drop(float volts) { this->vinDrop_ = volts; }
+  void set_min_vin(float volts) { this->minVin_ = volts; }
+
+  // optional sensors, published every statistics interval
+  void set_jitter_sensor(sensor::Sensor *sensor) { this->jitterSensor_ = sensor; }
+  void set_execution_time_sensor(sensor::Sensor *sensor) { this->executionTimeSensor_ = sensor; }
+  void set_ratio_sensor(sensor::Sensor *sensor) { this->ratioSensor_ = sensor; }
+
+  // called from loop() when Vconv reaches its target after ramping
+  void add_on_target_reached_callback(std::function<void()> &&callback) {
+    this->targetReachedCallback_.add(std::move(callback));
+  }
+
+  void setup() override;
+  void loop() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::DATA; }
+
+  // immediately turns off the converter, eg on a fault, until the enable switch is next turned on
+  void turn_off();
+
+  float get_ratio() const { return this->ratio_; }
+  // returns a snapshot of the control task timing, thread-safe
+  ControlStats get_stats() {
+    LockGuard guard(this->lock_);
+    return this->stats_;
+  }
+
+ protected:
+  static void control_task(void *arg);
+  void control_step();  // from the control task
+  void write_ratio(float ratio);  // with lock_ held
+
+  mcpwm_sync::McpwmSyncComponent *buck_;
+  mcpwm_sync::McpwmSyncComponent *boost_;
+  switch_::Switch *enable_;
+  sensor::Sensor *vin_;
+  number::Number *setVoltage_;
+  sensor::Sensor *measVoltage_;
+
+  uint32_t periodMillis_ = 2;
+  float stepSeconds_ = 0;  // actual control period, set by the control task before its first step
+  float rampRate_ = 25;  // V/s
+  float headroom_ = 0.5;
+  float deadzone_ = 0.03;
+  float maxRatio_ = 1.5;
+  float vinDrop_ = 0.4;
+  float minVin_ = 5;
+
+  // inputs, written from the main loop
+  std::atomic<bool> enabled_{false};
+  std::atomic<float> vinVolts_{NAN};
+  std::atomic<float> setVolts_{NAN};
+  std::atomic<float> measVolts_{NAN};
+
+  TaskHandle_t task_ = nullptr;
+  Mutex lock_;  // guards the outputs and statistics between the control task and main loop
+  float ratio_ = 0;  // written with lock_ held
+  bool atTarget_ = false;  // control task only
+  std::atomic<bool> targetReached_{false};  // set by the control task, handled in loop()
+  CallbackManager<void()> targetReachedCallback_;
+
+  // statistics accumulating over the current interval, guarded by lock_
+  uint32_t iterations_ = 0;
+  uint64_t jitterSumMicros_ = 0;
+  uint32_t jitterMaxMicros_ = 0;
+  uint64_t execSumMicros_ = 0;
+  uint32_t execMaxMicros_ = 0;
+  ControlStats stats_;  // of the last interval, guarded by lock_
+  uint32_t statsStartMillis_ = 0;
+
+  sensor::Sensor *jitterSensor_ = nullptr;
+  sensor::Sensor *executionTimeSensor_ = nullptr;
+  sensor::Sensor *ratioSensor_ = nullptr;
+};
+
+class TargetReachedTrigger : public Trigger<> {
+ public:
+  explicit TargetReachedTrigger(BuckBoostControl *parent) {
+    parent->add_on_target_reached_callback([this]() { this->trigger(); });
+  }
+};
+
+}
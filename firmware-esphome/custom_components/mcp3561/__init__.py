@@ -1,15 +1,45 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.components import spi
-from esphome.const import CONF_ID
+from esphome import pins
+from esphome.components import spi, sensor, web_server_base
+from esphome.components.web_server_base import CONF_WEB_SERVER_BASE_ID
+from esphome.const import (
+    CONF_ID,
+    CONF_PATH,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_EMPTY,
+    UNIT_MICROSECOND,
+)
 
 DEPENDENCIES = ["spi"]
+AUTO_LOAD = ["sensor"]
 MULTI_CONF = True
 
 CONF_OSR = "osr"
+CONF_IRQ_PIN = "irq_pin"
+CONF_POLL_INTERVAL = "poll_interval"
+CONF_SCAN = "scan"
+CONF_SCAN_TIMER = "scan_timer"
+CONF_STREAM_BUFFER_SIZE = "stream_buffer_size"
+CONF_TELEMETRY = "telemetry"
+CONF_STREAM = "stream"
+CONF_CAPTURE_SIZE = "capture_size"
+CONF_CONVERSION_RATE = "conversion_rate"
+CONF_TIMEOUTS = "timeouts"
+CONF_DROPPED = "dropped"
+CONF_COALESCED = "coalesced"
+CONF_LATENCY = "latency"
+CONF_LATENCY_MAX = "latency_max"
+CONF_SPI_TIME = "spi_time"
+
+UNIT_CONVERSIONS_PER_SECOND = "conv/s"
 
 mcp3561_ns = cg.esphome_ns.namespace("mcp3561")
 MCP3561 = mcp3561_ns.class_("MCP3561", cg.Component, spi.SPIDevice)
+MCP3561TelemetryHandler = mcp3561_ns.class_("MCP3561TelemetryHandler", cg.Component)
+MCP3561StreamHandler = mcp3561_ns.class_("MCP3561StreamHandler", cg.Component)
 
 MCP3561Mux = MCP3561.enum("Mux")  # Table 5-1
 MUX = {
@@ -30,6 +60,13 @@ MUX = {
     "VCM": MCP3561Mux.kVCm,
 }
 
+# (channel, channel_neg) pairs available in SCAN mode, Table 5-14
+SCAN_CHANNELS = (
+    [(f"CH{i}", "AGND") for i in range(8)]
+    + [(f"CH{i}", f"CH{i + 1}") for i in range(0, 8, 2)]
+    + [("TEMPP", "TEMPM"), ("AVDD", "AGND"), ("VCM", "AGND"), ("AGND", "AGND")]
+)
+
 MCP3561Osr = MCP3561.enum("Osr")  # Table 5-6
 OSR = {
     32: MCP3561Osr.k32,  # 16b, 38400-153600 Hz
@@ -62,7 +99,58 @@ GAIN = {
     "X64": MCP3561Gain.kX64,
 }
 
-CONFIG_SCHEMA = cv.Schema(
+def telemetry_sensor_schema(unit, state_class=STATE_CLASS_MEASUREMENT, accuracy_decimals=1):
+    return sensor.sensor_schema(
+        unit_of_measurement=unit,
+        accuracy_decimals=accuracy_decimals,
+        state_class=state_class,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    )
+
+
+# optional telemetry sensors, published every statistics interval (10s)
+# counters are totals since boot, latency (data ready to read) is only measured with the IRQ pin
+TELEMETRY_SENSORS = {
+    CONF_CONVERSION_RATE: telemetry_sensor_schema(UNIT_CONVERSIONS_PER_SECOND),
+    CONF_TIMEOUTS: telemetry_sensor_schema(UNIT_EMPTY, STATE_CLASS_TOTAL_INCREASING, 0),
+    CONF_DROPPED: telemetry_sensor_schema(UNIT_EMPTY, STATE_CLASS_TOTAL_INCREASING, 0),
+    CONF_COALESCED: telemetry_sensor_schema(UNIT_EMPTY, STATE_CLASS_TOTAL_INCREASING, 0),
+    CONF_LATENCY: telemetry_sensor_schema(UNIT_MICROSECOND, accuracy_decimals=0),
+    CONF_LATENCY_MAX: telemetry_sensor_schema(UNIT_MICROSECOND, accuracy_decimals=0),
+    CONF_SPI_TIME: telemetry_sensor_schema(UNIT_MICROSECOND),  # per conversion
+}
+
+# serves the telemetry (including the latency histogram and per-sensor rates) over HTTP
+# requires the web server (eg, web_server or sample_buffer) to be configured
+TELEMETRY_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(MCP3561TelemetryHandler),
+        cv.GenerateID(CONF_WEB_SERVER_BASE_ID): cv.use_id(web_server_base.WebServerBase),
+        cv.Optional(CONF_PATH, default="/mcp3561"): cv.string_strict,
+    }
+)
+
+# captures bursts of back-to-back conversions of one sensor in streaming mode over HTTP, see stream_handler.h
+# requires the stream buffer and the web server
+STREAM_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(MCP3561StreamHandler),
+        cv.GenerateID(CONF_WEB_SERVER_BASE_ID): cv.use_id(web_server_base.WebServerBase),
+        cv.Optional(CONF_PATH, default="/mcp3561/stream"): cv.string_strict,
+        cv.Optional(CONF_CAPTURE_SIZE, default=2048): cv.int_range(min=1, max=65536),  # in samples, 16 B each
+    }
+)
+
+
+def validate_stream(config):
+    if CONF_STREAM in config and config[CONF_STREAM_BUFFER_SIZE] == 0:
+        raise cv.Invalid("stream requires stream_buffer_size")
+    if CONF_STREAM in config and config[CONF_SCAN]:
+        raise cv.Invalid("stream not available in SCAN mode")
+    return config
+
+
+CONFIG_SCHEMA = cv.All(cv.Schema(
     {
         cv.GenerateID(): cv.declare_id(MCP3561),
     }
@@ -70,8 +158,20 @@ CONFIG_SCHEMA = cv.Schema(
 ).extend(
     {
         cv.Optional(CONF_OSR, default='256'): cv.enum(OSR),
+        cv.Optional(CONF_IRQ_PIN): pins.internal_gpio_input_pin_schema,
+        # without the IRQ pin, polls for data ready from a high-priority task at this period (rounded to
+        # RTOS ticks), instead of from the main loop, bounding readout latency independently of loop stalls
+        cv.Optional(CONF_POLL_INTERVAL): cv.All(cv.positive_time_period_milliseconds,
+                                                cv.Range(min=cv.TimePeriod(milliseconds=1))),
+        cv.Optional(CONF_SCAN, default=False): cv.boolean,
+        cv.Optional(CONF_SCAN_TIMER, default=0): cv.int_range(min=0, max=0xffffff),  # in DMCLK periods
+        cv.Optional(CONF_STREAM_BUFFER_SIZE, default=0): cv.int_range(min=0, max=65536),  # in samples, 0 to disable
+        cv.Optional(CONF_TELEMETRY): TELEMETRY_SCHEMA,
+        cv.Optional(CONF_STREAM): STREAM_SCHEMA,
     }
-)
+).extend(
+    {cv.Optional(key): schema for key, schema in TELEMETRY_SENSORS.items()}
+), validate_stream)
 
 
 async def to_code(config):
@@ -81,3 +181,33 @@ async def to_code(config):
     )
     await cg.register_component(var, config)
     await spi.register_spi_device(var, config)
+
+    if config[CONF_STREAM_BUFFER_SIZE] > 0:
+        cg.add(var.set_stream_buffer_size(config[CONF_STREAM_BUFFER_SIZE]))
+
+    if config[CONF_SCAN]:
+        cg.add(var.set_scan(config[CONF_SCAN_TIMER]))
+
+    if CONF_IRQ_PIN in config:
+        irq_pin = await cg.gpio_pin_expression(config[CONF_IRQ_PIN])
+        cg.add(var.set_irq_pin(irq_pin))
+    elif CONF_POLL_INTERVAL in config:
+        cg.add(var.set_poll_interval(config[CONF_POLL_INTERVAL].total_milliseconds))
+
+    for key in TELEMETRY_SENSORS:
+        if sensor_config := config.get(key):
+            sens = await sensor.new_sensor(sensor_config)
+            cg.add(getattr(var, f"set_{key}_sensor")(sens))
+
+    if telemetry_config := config.get(CONF_TELEMETRY):
+        cg.add_define("USE_MCP3561_TELEMETRY_HANDLER")
+        base = await cg.get_variable(telemetry_config[CONF_WEB_SERVER_BASE_ID])
+        handler = cg.new_Pvariable(telemetry_config[CONF_ID], var, base, telemetry_config[CONF_PATH])
+        await cg.register_component(handler, telemetry_config)
+
+    if stream_config := config.get(CONF_STREAM):
+        cg.add_define("USE_MCP3561_STREAM_HANDLER")
+        base = await cg.get_variable(stream_config[CONF_WEB_SERVER_BASE_ID])
+        handler = cg.new_Pvariable(stream_config[CONF_ID], var, base, stream_config[CONF_PATH],
+                                   stream_config[CONF_CAPTURE_SIZE])
+        await cg.register_component(handler, stream_config)
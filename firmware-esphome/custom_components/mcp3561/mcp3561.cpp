@@ -7,12 +7,16 @@ namespace mcp3561 {
 
 static const char *const TAG = "mcp3561";
 
+static const UBaseType_t kTaskPriority = 5;  // above the main loop, so conversions are read out independently of it
+static const BaseType_t kTaskCore = 1;
+
 MCP3561::MCP3561(Osr osr, uint8_t device_address) :
   osr_(osr), device_address_(device_address) {}
 
 float MCP3561::get_setup_priority() const { return setup_priority::HARDWARE; }
 
 void MCP3561::setup() {
+  LockGuard guard(this->lock_);  // setup may be re-run (eg, on Vin ramp) while the conversion task is active
   this->spi_setup();
 
   uint8_t reservedVal = readReg(Register::RESERVED, 2);
@@ -26,25 +30,176 @@ void MCP3561::setup() {
     ESP_LOGW(TAG, "MCP356x unexpected Reserved (device ID) value %04x", reservedVal);
   }
 
+  this->shadowValid_ = 0;  // the device may have been reset (eg, power cycled), so the shadow is no longer known
   writeReg8(Register::CONFIG0, 0x22);  // external VREF, internal clock w/ no CLK out, ADC standby
   writeReg8(Register::CONFIG1, (this->osr_ & 0xf) << 2);
 
-  writeReg8(Register::CONFIG3, 0x80);  // one-shot conversion into standby, 24b encoding
-  writeReg8(Register::IRQ, 0x07);  // enable fast command and start-conversion IRQ, IRQ logic high)
+  if (this->irq_pin_ == nullptr) {
+    writeReg8(Register::IRQ, 0x07);  // enable fast command and start-conversion IRQ, IRQ logic high)
+  } else {  // disable the start-conversion IRQ, so IRQ falling edges are only data ready
+    writeReg8(Register::IRQ, 0x06);  // enable fast command, IRQ logic high
+  }
+
+  if (this->results_.capacity() == 0) {  // allocate once, setup may be re-run
+    this->results_.init(kResultsDepth);
+  }
+  if (this->streamBufferSize_ > 0 && this->stream_.capacity() == 0) {
+    this->stream_.init(this->streamBufferSize_);
+  }
+  this->streaming_ = nullptr;
+  for (auto *sensor : this->sensors_) {
+    sensor->dueMicros_ = esp_timer_get_time();
+  }
+
+  if (!this->scanMode_) {
+    writeReg8(Register::CONFIG3, 0x80);  // one-shot conversion into standby, 24b encoding
+  } else if (!this->setup_scan()) {
+    this->mark_failed();
+    return;
+  }
+
+  if ((this->irq_pin_ != nullptr || this->pollIntervalMillis_ > 0) && this->task_ == nullptr) {
+    if (this->irq_pin_ != nullptr) {
+      this->irq_pin_->setup();
+    }
+    TaskFunction_t task = this->irq_pin_ != nullptr ? MCP3561::conversion_task : MCP3561::poll_task;
+    if (xTaskCreatePinnedToCore(task, "mcp3561", 4096, this, kTaskPriority, &this->task_, kTaskCore) != pdPASS) {
+      ESP_LOGE(TAG, "failed to create conversion task");
+      this->task_ = nullptr;
+      this->mark_failed();
+      return;
+    }
+    if (this->irq_pin_ != nullptr) {
+      this->irq_pin_->attach_interrupt(MCP3561::gpio_intr, this, gpio::INTERRUPT_FALLING_EDGE);
+    }
+  }
+  this->statsStartMillis_ = esphome::millis();
 }
 
 void MCP3561::dump_config() {
   ESP_LOGCONFIG(TAG, "MCP3561:");
   LOG_PIN("  CS Pin:", this->cs_);
+  LOG_PIN("  IRQ Pin:", this->irq_pin_);
+  if (this->irq_pin_ == nullptr && this->pollIntervalMillis_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Poll interval: %u ms", this->pollIntervalMillis_);
+  }
   ESP_LOGCONFIG(TAG, "  OSR: %u", this->osr_);
+  if (this->scanMode_) {
+    ESP_LOGCONFIG(TAG, "  SCAN mode, timer: %u", this->scanTimer_);
+  }
+  if (this->streamBufferSize_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Stream buffer: %u samples", this->streamBufferSize_);
+  }
+}
+
+uint32_t MCP3561::osr_value(Osr osr) {
+  static const uint32_t kOsrValues[16] = {32,   64,   128,   256,   512,   1024,  2048,  4096,
+                                          8192, 16384, 20480, 24576, 40960, 49152, 81920, 98304};
+  return kOsrValues[osr & 0xf];
+}
+
+int8_t MCP3561::scan_channel(Mux channel, Mux channel_neg) {
+  if (channel <= Mux::kCh7 && channel_neg == Mux::kAGnd) {  // single-ended
+    return channel;
+  } else if (channel <= Mux::kCh7 && (channel % 2) == 0 && channel_neg == channel + 1) {  // differential pairs
+    return 8 + channel / 2;
+  } else if (channel == Mux::kTempDiodeP && channel_neg == Mux::kTempDiodeM) {
+    return 12;
+  } else if (channel == Mux::kVdd && channel_neg == Mux::kAGnd) {
+    return 13;
+  } else if (channel == Mux::kVCm && channel_neg == Mux::kAGnd) {
+    return 14;
+  } else if (channel == Mux::kAGnd && channel_neg == Mux::kAGnd) {  // offset
+    return 15;
+  }
+  return -1;
+}
+
+bool MCP3561::setup_scan() {
+  uint16_t scanChannels = 0;
+  for (auto *sensor : this->sensors_) {
+    int8_t scanChannel = scan_channel(sensor->channel_, sensor->channel_neg_);
+    if (scanChannel < 0) {
+      ESP_LOGE(TAG, "channel %u-%u not available in SCAN mode", sensor->channel_, sensor->channel_neg_);
+      return false;
+    } else if (scanChannels & (1 << scanChannel)) {
+      ESP_LOGE(TAG, "duplicate SCAN channel %i", scanChannel);
+      return false;
+    } else if (sensor->gain_ != this->sensors_[0]->gain_) {
+      ESP_LOGE(TAG, "SCAN mode requires the same gain on all channels");
+      return false;
+    } else if (sensor->osr_.value_or(this->osr_) != this->osr_) {
+      ESP_LOGE(TAG, "SCAN mode requires the same OSR on all channels");
+      return false;
+    }
+    scanChannels |= 1 << scanChannel;
+    this->scanSensors_[scanChannel] = sensor;
+  }
+  if (scanChannels == 0) {
+    ESP_LOGE(TAG, "no SCAN channels");
+    return false;
+  }
+
+  writeReg8(Register::CONFIG2, config2(this->sensors_[0]->gain_));
+  writeReg8(Register::CONFIG3, 0xf0);  // continuous conversion, 32b encoding with channel ID
+  writeReg(Register::SCAN, scanChannels, 3);  // no delay between channels
+  writeReg(Register::TIMER, this->scanTimer_ & 0xffffff, 3);
+  fastCommand(FastCommand::kStartConversion);
+  conversionStartMicros_ = esp_timer_get_time();
+  return true;
+}
+
+void IRAM_ATTR MCP3561::gpio_intr(MCP3561 *arg) {
+  arg->irqMicros_ = esp_timer_get_time();
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(arg->task_, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+void MCP3561::conversion_task(void *arg) {
+  MCP3561 *self = static_cast<MCP3561 *>(arg);
+  TickType_t waitTicks = pdMS_TO_TICKS(kConversionTimeoutMillis);
+  while (true) {
+    // the timeout allows conversion timeouts to be detected even if the IRQ never fires
+    ulTaskNotifyTake(pdTRUE, waitTicks);
+    LockGuard guard(self->lock_);
+    self->service_conversion();
+    waitTicks = self->idle_wait_ticks();
+  }
+}
+
+void MCP3561::poll_task(void *arg) {
+  MCP3561 *self = static_cast<MCP3561 *>(arg);
+  TickType_t periodTicks = std::max<TickType_t>(pdMS_TO_TICKS(self->pollIntervalMillis_), 1);
+  TickType_t lastWake = xTaskGetTickCount();
+  while (true) {
+    vTaskDelayUntil(&lastWake, periodTicks);
+    LockGuard guard(self->lock_);
+    self->service_conversion();
+  }
+}
+
+TickType_t MCP3561::idle_wait_ticks() const {
+  if (converting_ != nullptr || this->streaming_ != nullptr || this->scanMode_) {
+    return pdMS_TO_TICKS(kConversionTimeoutMillis);
+  }
+  // idle, wake for the next sensor with a target rate coming due
+  int64_t now = esp_timer_get_time();
+  int64_t waitMicros = (int64_t)kConversionTimeoutMillis * 1000;
+  for (auto *sensor : this->sensors_) {
+    if (sensor->ratePeriodMicros_ > 0) {
+      waitMicros = std::min(waitMicros, sensor->dueMicros_ - now);
+    }
+  }
+  return std::max<int64_t>(waitMicros / 1000 / portTICK_PERIOD_MS, 1);
 }
 
 // sends a fast command, returning the status code
 uint8_t MCP3561::fastCommand(FastCommand fastCommandCode) {
-  this->enable();
+  this->spi_begin();
   uint8_t status = this->transfer_byte(
     ((this->device_address_ & 0x3) << 6) | ((fastCommandCode & 0xf) << 2) | CommandType::kFastCommand);
-  this->disable();
+  this->spi_end(1);
 
   return status;
 }
@@ -54,7 +209,7 @@ uint8_t MCP3561::fastCommand(FastCommand fastCommandCode) {
 bool MCP3561::readRaw24(int32_t* outValue) {
   bool valid = false;
 
-  this->enable();
+  this->spi_begin();
   uint8_t status = this->transfer_byte(
     ((this->device_address_ & 0x3) << 6) | ((Register::ADCDATA & 0xf) << 2) | CommandType::kStaticRead);
   if ((status & 0x04) == 0) {  // STAT[2] /DataReady
@@ -70,98 +225,435 @@ bool MCP3561::readRaw24(int32_t* outValue) {
     }
     valid = true;
   }
-  this->disable();
+  this->spi_end(valid ? 4 : 1);
+
+  return valid;
+}
+
+// tries to read the ADC as a signed 24-bit value in a single 4-byte transfer, returning whether the ADC had new data
+// used for streaming, where data is expected to be ready, so this minimizes per-sample SPI overhead
+bool MCP3561::readRaw24Single(int32_t* outValue) {
+  uint8_t buf[4] = {
+    (uint8_t)(((this->device_address_ & 0x3) << 6) | ((Register::ADCDATA & 0xf) << 2) | CommandType::kStaticRead),
+    0, 0, 0};
+  this->spi_begin();
+  this->transfer_array(buf, sizeof(buf));
+  this->spi_end(sizeof(buf));
+
+  if ((buf[0] & 0x04) != 0) {  // STAT[2] /DataReady
+    return false;
+  }
+  *outValue = (int32_t)((uint32_t)buf[1] << 24 | (uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 8) >> 8;  // sign extend
+  return true;
+}
+
+// tries to read the ADC in the 32-bit with channel ID data format (used in SCAN mode),
+// returning whether the ADC had new data
+bool MCP3561::readRaw32(int32_t* outValue, uint8_t* outChannelId) {
+  bool valid = false;
+
+  this->spi_begin();
+  uint8_t status = this->transfer_byte(
+    ((this->device_address_ & 0x3) << 6) | ((Register::ADCDATA & 0xf) << 2) | CommandType::kStaticRead);
+  if ((status & 0x04) == 0) {  // STAT[2] /DataReady
+    uint32_t raw = 0;
+    for (uint8_t i=0; i<4; i++) {
+      raw = raw << 8 | this->transfer_byte(0);
+    }
+    *outChannelId = raw >> 28;
+    *outValue = (int32_t)(raw << 4) >> 4;  // sign extend from the SGN bits
+    valid = true;
+  }
+  this->spi_end(valid ? 5 : 1);
 
   return valid;
 }
 
 // writes 8 bits into a single register, returning the status code
+// unconditionally writes, and updates the shadow copy for 8-bit registers
 uint8_t MCP3561::writeReg8(uint8_t regAddr, uint8_t data) {
-  this->enable();
+  return writeRegs8(regAddr, &data, 1);
+}
+
+// writes consecutive 8-bit registers in a single incremental write, returning the status code
+uint8_t MCP3561::writeRegs8(uint8_t regAddr, const uint8_t* data, uint8_t count) {
+  this->spi_begin();
+  uint8_t result = this->transfer_byte(((this->device_address_ & 0x3) << 6) | ((regAddr & 0xf) << 2) | CommandType::kIncrementalWrite);
+  for (uint8_t i=0; i<count; i++) {
+    this->transfer_byte(data[i]);
+    if (regAddr + i < kShadowRegisters) {
+      this->shadow_[regAddr + i] = data[i];
+      this->shadowValid_ |= 1 << (regAddr + i);
+    }
+  }
+  this->spi_end(1 + count);
+  return result;
+}
+
+// writes only the consecutive 8-bit registers that differ from the shadow copy, as a single incremental write
+// covering the first through last changed register
+void MCP3561::updateRegs8(uint8_t regAddr, const uint8_t* data, uint8_t count) {
+  int8_t first = -1, last = -1;
+  for (uint8_t i=0; i<count; i++) {
+    if (!(this->shadowValid_ & (1 << (regAddr + i))) || this->shadow_[regAddr + i] != data[i]) {
+      if (first < 0) {
+        first = i;
+      }
+      last = i;
+    }
+  }
+  if (first >= 0) {
+    writeRegs8(regAddr + first, data + first, last - first + 1);
+  }
+}
+
+// writes a multi-byte (eg, 24-bit SCAN and TIMER) register MSB first, returning the status code
+uint8_t MCP3561::writeReg(uint8_t regAddr, uint32_t data, uint8_t bytes) {
+  this->spi_begin();
   uint8_t result = this->transfer_byte(((this->device_address_ & 0x3) << 6) | ((regAddr & 0xf) << 2) | CommandType::kIncrementalWrite);
-  this->transfer_byte(data);
-  this->disable();
+  for (int8_t i=bytes-1; i>=0; i--) {
+    this->transfer_byte((data >> (i * 8)) & 0xff);
+  }
+  this->spi_end(1 + bytes);
   return result;
 }
 
 uint32_t MCP3561::readReg(uint8_t regAddr, uint8_t bytes) {
   uint32_t out = 0;
-  this->enable();
+  this->spi_begin();
   this->transfer_byte(((this->device_address_ & 0x3) << 6) | ((regAddr & 0xf) << 2) | CommandType::kStaticRead);
   for (uint8_t i=0; i<bytes; i++) {
     uint8_t result = this->transfer_byte(0);
     out = out << 8;
     out |= result;
   }
-  this->disable();
+  this->spi_end(1 + bytes);
   return out;
 }
 
-void MCP3561::start_conversion(MCP3561Sensor* sensor) {
-  writeReg8(Register::CONFIG2, 
-    (2 << 6) |  // default BOOST
-    ((sensor->gain_ & 7) << 3) | 
+uint8_t MCP3561::config2(Gain gain) {
+  return (2 << 6) |  // default BOOST
+    ((gain & 7) << 3) |
     (1 << 1) |  // default AZ_REF EN
-    (1)  // RESERVED=1
-  );
-  writeReg8(Register::MUX, ((sensor->channel_ & 0xf) << 4) | (sensor->channel_neg_ & 0xf));
+    (1);  // RESERVED=1
+}
+
+void MCP3561::start_conversion(MCP3561Sensor* sensor) {
+  // CONFIG1 through MUX, only the changed registers are written, in one transaction
+  // the start conversion fast command must be its own transaction
+  uint8_t regs[Register::MUX - Register::CONFIG1 + 1];
+  for (uint8_t i=0; i<sizeof(regs); i++) {
+    regs[i] = this->shadow_[Register::CONFIG1 + i];
+  }
+  regs[Register::CONFIG1 - Register::CONFIG1] = (sensor->osr_.value_or(this->osr_) & 0xf) << 2;
+  regs[Register::CONFIG2 - Register::CONFIG1] = config2(sensor->gain_);
+  regs[Register::MUX - Register::CONFIG1] = ((sensor->channel_ & 0xf) << 4) | (sensor->channel_neg_ & 0xf);
+  updateRegs8(Register::CONFIG1, regs, sizeof(regs));
   fastCommand(FastCommand::kStartConversion);
-  conversionStartMillis_ = esphome::millis();
+  conversionStartMicros_ = esp_timer_get_time();
+}
+
+bool MCP3561::start_stream(MCP3561Sensor* sensor, Osr osr) {
+  LockGuard guard(this->lock_);
+  if (this->stream_.capacity() == 0 || this->scanMode_) {
+    ESP_LOGE(TAG, "streaming not available");
+    return false;
+  }
+
+  if (converting_ != nullptr) {  // abandon any one-shot conversion, its sensor is re-requested for after streaming
+    converting_->pending_ = true;
+    converting_ = nullptr;
+  }
+  this->streaming_ = sensor;
+  this->stream_.clear();
+  this->streamPeriodMicros_ = osr_value(osr) * 4 * 1e6f / kInternalClockHz;  // DMCLK = MCLK / 4, no prescaler
+  this->streamReadyMicros_ = 0;
+  MCP3561Sensor *commonMode = sensor->commonModeSensor_;
+  this->streamCommonModeValue_ = commonMode != nullptr ? commonMode->latestCounts_ : 0;
+
+  uint8_t regs[Register::MUX - Register::CONFIG1 + 1];
+  for (uint8_t i=0; i<sizeof(regs); i++) {
+    regs[i] = this->shadow_[Register::CONFIG1 + i];
+  }
+  regs[Register::CONFIG1 - Register::CONFIG1] = (osr & 0xf) << 2;
+  regs[Register::CONFIG2 - Register::CONFIG1] = config2(sensor->gain_);
+  regs[Register::CONFIG3 - Register::CONFIG1] = 0xc0;  // continuous conversion, 24b encoding
+  regs[Register::MUX - Register::CONFIG1] = ((sensor->channel_ & 0xf) << 4) | (sensor->channel_neg_ & 0xf);
+  updateRegs8(Register::CONFIG1, regs, sizeof(regs));
+  fastCommand(FastCommand::kStartConversion);
+  conversionStartMicros_ = esp_timer_get_time();
+  return true;
+}
+
+void MCP3561::stop_stream() {
+  LockGuard guard(this->lock_);
+  if (this->streaming_ == nullptr) {
+    return;
+  }
+  this->streaming_ = nullptr;
+  fastCommand(FastCommand::kStandbyMode);
+  writeReg8(Register::CONFIG3, 0x80);  // one-shot conversion into standby, 24b encoding
+  start_next_conversion();
 }
 
 void MCP3561::enqueue(MCP3561Sensor* sensor) {
-  if (((queueWrite_ + 1) % kQueueDepth) == queueRead_) {
-    ESP_LOGE(TAG, "queue full, dropping request");
+  LockGuard guard(this->lock_);
+  if (sensor->pending_) {  // previous request not yet serviced, the requested rate is above what the ADC achieves
+    sensor->coalescedRequests_++;
     return;
   }
-  // don't allow enqueueing duplicates - silently discard if there is a fundamental rate mismatch
-  if (queueRead_ <= queueWrite_) {  // doesn't wraparound
-    for (size_t i=queueRead_; i<queueWrite_; i++) {
-      if (queue_[i] == sensor) {
-        return;
+  sensor->pending_ = true;
+  if (this->scanMode_) {  // conversions are sequenced by the device, the result is published when available
+    return;
+  }
+
+  this->scheduler_.join(sensor);
+  if (converting_ == nullptr && this->streaming_ == nullptr) {
+    start_next_conversion();
+  }
+}
+
+void MCP3561::release_due(int64_t now) {
+  for (auto *sensor : this->sensors_) {
+    uint32_t period = sensor->ratePeriodMicros_;
+    if (period == 0 || now < sensor->dueMicros_) {
+      continue;
+    }
+    if (sensor->pending_) {  // previous request not yet serviced, the target rate is above what the ADC achieves
+      sensor->coalescedRequests_++;
+    } else {
+      sensor->pending_ = true;
+      if (!this->scanMode_) {
+        this->scheduler_.join(sensor);
       }
     }
-  } else {  // wraps around
-    for (size_t i=queueRead_; i<kQueueDepth; i++) {
-      if (queue_[i] == sensor) {
-        return;
+    // periods missed entirely (eg, while streaming) are coalesced rather than caught up
+    uint32_t missed = (now - sensor->dueMicros_) / period;
+    sensor->coalescedRequests_ += missed;
+    sensor->dueMicros_ += (int64_t)(missed + 1) * period;
+  }
+}
+
+// see StrideScheduler for the scheduling policy
+void MCP3561::start_next_conversion() {
+  this->release_due(esp_timer_get_time());
+  converting_ = this->scheduler_.next(this->sensors_);
+  if (converting_ != nullptr) {
+    // the request is consumed as the conversion starts, so requests made during the conversion keep the sensor
+    // in the schedule and its weight sets its share of a saturated ADC
+    converting_->pending_ = false;
+    start_conversion(converting_);
+  }
+}
+
+Sample MCP3561::read_out(MCP3561Sensor* sensor, int32_t value, int64_t readyMicros) {
+  sensor->latestCounts_ = value;
+  int32_t commonModeValue = sensor->commonModeSensor_ != nullptr ? sensor->commonModeSensor_->latestCounts_ : 0;
+  int8_t range = sensor->rangeFunction_ ? sensor->rangeFunction_() : 0;
+  return {sensor, value, conversionStartMicros_, readyMicros, NAN, commonModeValue, range};
+}
+
+void MCP3561::push_result(MCP3561Sensor* sensor, int32_t value, int64_t readyMicros) {
+  Sample sample = this->read_out(sensor, value, readyMicros);
+  call_result_hooks(sample);
+  sensor->conversions_++;
+  // if full, the conversion is dropped and counted in the dropped telemetry, reported from the main loop instead of
+  // logged here, since logging from the conversion task on every drop would only worsen the overrun
+  results_.push(sample);
+}
+
+void MCP3561::record_conversion(int64_t now) {
+  statsConversions_++;
+  if (this->irq_pin_ != nullptr) {
+    uint32_t latencyMicros = now - irqMicros_;
+    statsLatencyTotalMicros_ += latencyMicros;
+    statsLatencyMaxMicros_ = std::max(statsLatencyMaxMicros_, latencyMicros);
+    uint8_t bucket = 0;
+    while (bucket < kLatencyBuckets - 1 && latencyMicros >= (16u << bucket)) {
+      bucket++;
+    }
+    latencyHistogram_[bucket]++;
+  }
+}
+
+void MCP3561::service_conversion() {
+  if (this->streaming_ != nullptr) {
+    int32_t result;
+    int64_t now = esp_timer_get_time();
+    if (this->readRaw24Single(&result)) {
+      int64_t readyMicros = data_ready_micros(now);
+      if (this->streamReadyMicros_ != 0) {  // conversions completing between readouts overwrite each other
+        float periods = (readyMicros - this->streamReadyMicros_) / this->streamPeriodMicros_;
+        if (periods >= 1.5f) {
+          this->streamOverwritten_ += (uint32_t) (periods - 0.5f);
+        }
       }
+      this->streamReadyMicros_ = readyMicros;
+      Sample sample = this->read_out(this->streaming_, result, readyMicros);
+      call_result_hooks(sample);
+      this->stream_.push({sample.value, sample.range, sample.readyMicros});
+      conversionStartMicros_ = readyMicros;  // continuous, so the next conversion has already started
+      record_conversion(now);
+    } else if (conversion_timed_out(now)) {
+      ESP_LOGE(TAG, "stream conversion timed out, restarting");
+      timeouts_++;
+      fastCommand(FastCommand::kStartConversion);
+      conversionStartMicros_ = esp_timer_get_time();
     }
-    for (size_t i=0; i<queueWrite_; i++) {
-      if (queue_[i] == sensor) {
-        return;
+    return;
+  }
+
+  if (this->scanMode_) {
+    int32_t result;
+    uint8_t channelId;
+    int64_t now = esp_timer_get_time();
+    if (this->readRaw32(&result, &channelId)) {
+      int64_t readyMicros = data_ready_micros(now);
+      this->release_due(now);
+      MCP3561Sensor* sensor = scanSensors_[channelId];
+      if (sensor != nullptr && sensor->pending_) {
+        sensor->pending_ = false;
+        push_result(sensor, result, readyMicros);
       }
+      conversionStartMicros_ = readyMicros;  // continuous, so the next conversion has already started
+      record_conversion(now);
+    } else if (conversion_timed_out(now)) {
+      ESP_LOGE(TAG, "scan conversion timed out, restarting");
+      timeouts_++;
+      fastCommand(FastCommand::kStartConversion);
+      conversionStartMicros_ = esp_timer_get_time();
     }
+    return;
   }
 
+  if (converting_ == nullptr) {  // no conversion in progress, start one if a sensor with a target rate is due
+    start_next_conversion();
+    return;
+  }
 
-  queue_[queueWrite_] = sensor;
-  if (queueWrite_ == queueRead_) {  // queue empty, start a conversion
-    start_conversion(sensor);
+  int32_t result;
+  int64_t now = esp_timer_get_time();
+  if (this->readRaw24(&result)) {
+    push_result(converting_, result, data_ready_micros(now));
+    record_conversion(now);
+    start_next_conversion();
+  } else if (conversion_timed_out(now)) {
+    ESP_LOGE(TAG, "conversion timed out");
+    timeouts_++;
+    start_next_conversion();
   }
-  queueWrite_ = (queueWrite_ + 1) % kQueueDepth;
 }
 
 void MCP3561::loop() {
-  if (queueWrite_ == queueRead_) {  // queue empty, no conversion in progress
-    return;
+  if (this->task_ == nullptr) {  // polling from loop()
+    LockGuard guard(this->lock_);
+    this->service_conversion();
   }
 
-  size_t prevQueueRead = queueRead_;
-  int32_t result;
-  if (this->readRaw24(&result)) {
-    queue_[queueRead_]->conversion_result(result);
-    queueRead_ = (queueRead_ + 1) % kQueueDepth;
-  } else {
-    if ((esphome::millis() - conversionStartMillis_) >= 1000) {
-      ESP_LOGE(TAG, "conversion timed out");
-      queueRead_ = (queueRead_ + 1) % kQueueDepth;
+  // process completed conversions in blocks, this must run in the main loop and not the conversion task
+  Sample block[kResultsBlockSize];
+  size_t count;
+  while ((count = results_.pop(block, kResultsBlockSize)) > 0) {
+    for (size_t i=0; i<count; i++) {
+      block[i].calibrated = block[i].sensor->calibrate(block[i]);
+    }
+    for (auto &consumer : this->blockConsumers_) {
+      consumer(block, count);
+    }
+    for (size_t i=0; i<count; i++) {
+      block[i].sensor->conversion_result(block[i]);
     }
   }
 
-  if (queueRead_ != prevQueueRead && queueWrite_ != queueRead_) {  // finished conversion and another is in the queue
-    start_conversion(queue_[queueRead_]);
+  uint32_t now = esphome::millis();
+  if (now - statsStartMillis_ >= kStatsIntervalMillis) {
+    Telemetry telemetry;
+    {
+      LockGuard guard(this->lock_);
+      this->update_telemetry(now);
+      telemetry = this->telemetry_;
+    }
+    if (this->irq_pin_ != nullptr && telemetry.conversions > 0) {
+      ESP_LOGD(TAG, "%.1f conversions/s, data ready to read latency avg %u us, max %u us", telemetry.conversionRate,
+               telemetry.latencyAvgMicros, telemetry.latencyMaxMicros);
+    } else {
+      ESP_LOGD(TAG, "%.1f conversions/s", telemetry.conversionRate);
+    }
+    ESP_LOGD(TAG, "  SPI: %.1f us, %.1f transactions, %.1f bytes per conversion", telemetry.spiMicrosPerConversion,
+             telemetry.spiTransactionsPerConversion, telemetry.spiBytesPerConversion);
+    if (telemetry.timeouts > 0 || telemetry.dropped > 0) {
+      ESP_LOGD(TAG, "  %u timeouts, %u dropped conversions", telemetry.timeouts, telemetry.dropped);
+    }
+    for (auto *sensor : this->sensors_) {
+      ESP_LOGV(TAG, "  channel %u-%u: %.1f conversions/s, %u coalesced requests", sensor->channel_,
+               sensor->channel_neg_, sensor->achievedRate_, sensor->coalescedRequests_);
+      if (sensor->achievedRateSensor_ != nullptr) {
+        sensor->achievedRateSensor_->publish_state(sensor->achievedRate_);
+      }
+    }
+
+    if (this->conversionRateSensor_ != nullptr) {
+      this->conversionRateSensor_->publish_state(telemetry.conversionRate);
+    }
+    if (this->timeoutsSensor_ != nullptr) {
+      this->timeoutsSensor_->publish_state(telemetry.timeouts);
+    }
+    if (this->droppedSensor_ != nullptr) {
+      this->droppedSensor_->publish_state(telemetry.dropped);
+    }
+    if (this->coalescedSensor_ != nullptr) {
+      this->coalescedSensor_->publish_state(telemetry.coalesced);
+    }
+    if (this->latencySensor_ != nullptr && this->irq_pin_ != nullptr) {
+      this->latencySensor_->publish_state(telemetry.latencyAvgMicros);
+    }
+    if (this->latencyMaxSensor_ != nullptr && this->irq_pin_ != nullptr) {
+      this->latencyMaxSensor_->publish_state(telemetry.latencyMaxMicros);
+    }
+    if (this->spiTimeSensor_ != nullptr) {
+      this->spiTimeSensor_->publish_state(telemetry.spiMicrosPerConversion);
+    }
+  }
+}
+
+void MCP3561::update_telemetry(uint32_t now) {
+  uint32_t intervalMillis = now - statsStartMillis_;
+  Telemetry &telemetry = this->telemetry_;
+  telemetry.conversionRate = statsConversions_ * 1000.0f / intervalMillis;
+  if (statsConversions_ > 0) {
+    telemetry.spiMicrosPerConversion = (float)statsSpiMicros_ / statsConversions_;
+    telemetry.spiTransactionsPerConversion = (float)statsSpiTransactions_ / statsConversions_;
+    telemetry.spiBytesPerConversion = (float)statsSpiBytes_ / statsConversions_;
+    telemetry.latencyAvgMicros = statsLatencyTotalMicros_ / statsConversions_;
+  } else {
+    telemetry.spiMicrosPerConversion = 0;
+    telemetry.spiTransactionsPerConversion = 0;
+    telemetry.spiBytesPerConversion = 0;
+    telemetry.latencyAvgMicros = 0;
   }
+  telemetry.latencyMaxMicros = statsLatencyMaxMicros_;
+
+  telemetry.conversions += statsConversions_;
+  telemetry.timeouts = timeouts_;
+  telemetry.dropped = results_.overruns() + stream_.overruns();
+  telemetry.streamOverwritten = this->streamOverwritten_;
+  telemetry.coalesced = 0;
+  for (auto *sensor : this->sensors_) {
+    sensor->achievedRate_ = sensor->conversions_ * 1000.0f / intervalMillis;
+    sensor->conversions_ = 0;
+    telemetry.coalesced += sensor->coalescedRequests_;
+  }
+  for (uint8_t i=0; i<kLatencyBuckets; i++) {
+    telemetry.latencyHistogram[i] = latencyHistogram_[i];
+  }
+
+  statsStartMillis_ = now;
+  statsConversions_ = 0;
+  statsLatencyTotalMicros_ = 0;
+  statsLatencyMaxMicros_ = 0;
+  statsSpiTransactions_ = 0;
+  statsSpiBytes_ = 0;
+  statsSpiMicros_ = 0;
 }
 
 }
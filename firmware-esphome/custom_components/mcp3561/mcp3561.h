@@ -1,16 +1,72 @@
 #pragma once
 
+#include <functional>
+#include <vector>
+
 #include "esphome/core/component.h"
 #include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
 #include "esphome/components/spi/spi.h"
+#include "esphome/components/sensor/sensor.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "sample_ring.h"
+#include "stride_scheduler.h"
 
 using namespace esphome;
 namespace mcp3561 {
 
-const size_t kQueueDepth = 8;
+const size_t kResultsDepth = 64;  // conversions waiting to be processed by loop()
+const size_t kResultsBlockSize = 16;  // conversions processed (and passed to block consumers) at a time
+const size_t kScanChannels = 16;
+const uint8_t kShadowRegisters = 7;  // 8-bit registers CONFIG0 through MUX, indexed by address
+const uint32_t kConversionTimeoutMillis = 1000;
+const uint32_t kStatsIntervalMillis = 10000;  // interval for logging and publishing telemetry
+const uint8_t kLatencyBuckets = 12;  // data ready to read latency histogram, power-of-two buckets from 16 us
+const float kInternalClockHz = 4915200;  // nominal internal oscillator (untrimmed), the low end of Table 5-6 data rates
 
 class MCP3561Sensor;
 
+// a completed conversion, passed in blocks to consumers
+struct Sample {
+  MCP3561Sensor* sensor;
+  int32_t value;  // signed 24-bit ADC counts
+  int64_t startMicros;  // esp_timer_get_time() at conversion start
+  int64_t readyMicros;  // esp_timer_get_time() at data ready
+  float calibrated;  // from the sensor's calibration function, or ADC ratio if none
+  // recorded by the conversion task at readout, so calibration sees the conditions of this conversion
+  int32_t commonModeValue;  // latest ADC counts of the sensor's common-mode sensor, or 0 if none
+  int8_t range;  // from the sensor's range function, or 0 if none
+};
+
+struct StreamSample {
+  int32_t value;  // signed 24-bit ADC counts
+  int8_t range;  // from the sensor's range function at readout, or 0 if none
+  int64_t micros;  // esp_timer_get_time() at data ready
+};
+
+// conversion statistics, the rates and per-conversion figures are over the last statistics interval
+// while the counters and histogram are totals since boot
+struct Telemetry {
+  float conversionRate = 0;  // conversions/s
+  float spiMicrosPerConversion = 0;  // SPI bus time, including register writes and command overhead
+  float spiTransactionsPerConversion = 0;
+  float spiBytesPerConversion = 0;
+  uint32_t latencyAvgMicros = 0;  // data ready interrupt to read complete, IRQ mode only
+  uint32_t latencyMaxMicros = 0;
+
+  uint32_t conversions = 0;
+  uint32_t timeouts = 0;
+  uint32_t dropped = 0;  // conversions dropped with the results or stream buffer full
+  uint32_t coalesced = 0;  // requests made while the sensor's previous request was pending, over all sensors
+  // stream conversions overwritten on the device before readout, estimated from data ready intervals
+  uint32_t streamOverwritten = 0;
+  uint32_t latencyHistogram[kLatencyBuckets] = {0};  // bucket i counts latencies below 16 << i us, the last the rest
+};
+
 // note: device compatible with SPI Modes 0,0 and 1,1
 class MCP3561 : public Component,
                 public spi::SPIDevice<spi::BIT_ORDER_MSB_FIRST, spi::CLOCK_POLARITY_LOW, spi::CLOCK_PHASE_LEADING,
@@ -104,23 +160,201 @@ class MCP3561 : public Component,
   void dump_config() override;
   float get_setup_priority() const override;
 
+  // if set, uses the device SCAN mode to sequence all registered sensors in continuous conversion,
+  // with timer being the delay between scan cycles in DMCLK periods
+  // all sensors must be on a channel available in SCAN mode (see scan_channel) and have the same gain
+  void set_scan(uint32_t timer) { this->scanMode_ = true; this->scanTimer_ = timer; }
+
+  // optional, if set uses the IRQ pin (active-low data ready) to read out conversions from a high-priority task,
+  // instead of polling from loop()
+  void set_irq_pin(InternalGPIOPin *pin) { this->irq_pin_ = pin; }
+  // optional without the IRQ pin, polls for data ready from a high-priority task at this period (at least one
+  // RTOS tick), instead of from loop(), so readout (and result hooks) don't wait on main loop stalls
+  void set_poll_interval(uint32_t intervalMillis) { this->pollIntervalMillis_ = intervalMillis; }
+
+  // registers a consumer called from loop() with each block of completed conversions (in order, from all sensors),
+  // before the sensors publish them, eg for native per-conversion processing like MCP3561Sensor integrals
+  void add_block_consumer(std::function<void(const Sample*, size_t)> &&consumer) {
+    this->blockConsumers_.push_back(std::move(consumer));
+  }
+
+  // registers a hook called with each conversion as soon as it is read out (with its recorded range and common-mode
+  // counts, but not yet calibrated), before it is queued for loop(), eg for protection, called from the conversion
+  // task in IRQ or task polling mode (otherwise from loop()) with the lock held,
+  // so it must be fast and must not call back into this component
+  void add_result_hook(std::function<void(const Sample &)> &&hook) {
+    LockGuard guard(this->lock_);  // the conversion task may already be running
+    this->resultHooks_.push_back(std::move(hook));
+  }
+
+  // capacity of the streaming ring buffer in samples, streaming is not available if zero
+  void set_stream_buffer_size(size_t size) { this->streamBufferSize_ = size; }
+
+  void register_sensor(MCP3561Sensor* sensor) { this->sensors_.push_back(sensor); }
+
+  // puts the ADC into continuous conversion of a single sensor's channel at the specified OSR,
+  // with samples read into the stream buffer instead of being published to the sensor
+  // other sensors are not converted while streaming, not available in SCAN mode
+  // back-to-back sampling requires the IRQ pin, otherwise samples are read out at the loop() rate
+  bool start_stream(MCP3561Sensor* sensor, Osr osr);
+  // returns the ADC to scheduled one-shot conversions
+  void stop_stream();
+  bool is_streaming() const { return this->streaming_ != nullptr; }
+  // reads up to max samples from the stream buffer, returning the number read, from the main loop only
+  size_t read_stream(StreamSample* out, size_t max) { return this->stream_.pop(out, max); }
+  // the latest ADC counts of the streamed sensor's common-mode sensor at the start of the stream, for calibrating
+  // stream samples, since no other sensor is converted while streaming, from the main loop only
+  int32_t get_stream_common_mode_value() const { return this->streamCommonModeValue_; }
+  // samples dropped because the stream buffer was full
+  uint32_t get_stream_overruns() const { return this->stream_.overruns(); }
+  // conversions overwritten on the device because they weren't read out before the next completed, estimated
+  // from the nominal conversion period, eg when reading out at the loop rate without the IRQ pin, thread-safe
+  uint32_t get_stream_overwritten() {
+    LockGuard guard(this->lock_);
+    return this->streamOverwritten_;
+  }
+
+  // requests a conversion for the sensor, which is scheduled by the sensor's priority and weight
+  // if the sensor already has a pending request, the request is coalesced and counted
   void enqueue(MCP3561Sensor* sensor);
 
+  // returns a snapshot of the conversion statistics, thread-safe
+  Telemetry get_telemetry() {
+    LockGuard guard(this->lock_);
+    return this->telemetry_;
+  }
+  const std::vector<MCP3561Sensor*> &get_sensors() const { return this->sensors_; }
+
+  // optional sensors, published every statistics interval
+  void set_conversion_rate_sensor(sensor::Sensor *sensor) { this->conversionRateSensor_ = sensor; }
+  void set_timeouts_sensor(sensor::Sensor *sensor) { this->timeoutsSensor_ = sensor; }
+  void set_dropped_sensor(sensor::Sensor *sensor) { this->droppedSensor_ = sensor; }
+  void set_coalesced_sensor(sensor::Sensor *sensor) { this->coalescedSensor_ = sensor; }
+  void set_latency_sensor(sensor::Sensor *sensor) { this->latencySensor_ = sensor; }
+  void set_latency_max_sensor(sensor::Sensor *sensor) { this->latencyMaxSensor_ = sensor; }
+  void set_spi_time_sensor(sensor::Sensor *sensor) { this->spiTimeSensor_ = sensor; }
+
+  // returns the SCAN channel ID (Table 5-14) for a MUX input pair, or -1 if not available in SCAN mode
+  static int8_t scan_channel(Mux channel, Mux channel_neg);
+  // returns the oversampling ratio of an OSR setting
+  static uint32_t osr_value(Osr osr);
+
 protected:
+  static void gpio_intr(MCP3561 *arg);
+  static void conversion_task(void *arg);
+  static void poll_task(void *arg);
+
+  // reads out a completed conversion (if any) into the results queue and starts the next scheduled conversion
+  // called from loop() when polling, or from the conversion task in IRQ mode
+  // caller must hold lock_
+  void service_conversion();
+  void start_next_conversion();  // caller must hold lock_
+  // requests conversions for sensors with a target rate that have come due, caller must hold lock_
+  void release_due(int64_t now);
+  // conversion task wait before servicing again without an IRQ, caller must hold lock_
+  TickType_t idle_wait_ticks() const;
+
+  // writes the SCAN mode registers and starts continuous conversion, returning false on an invalid configuration
+  bool setup_scan();
+  // returns a conversion read out at readyMicros, with the sensor's range and common-mode counts at readout, and
+  // records it as the sensor's latest counts, caller must hold lock_
+  Sample read_out(MCP3561Sensor* sensor, int32_t value, int64_t readyMicros);
+  void push_result(MCP3561Sensor* sensor, int32_t value, int64_t readyMicros);  // caller must hold lock_
+  void call_result_hooks(const Sample &sample) {  // caller must hold lock_
+    for (auto &hook : this->resultHooks_) {
+      hook(sample);
+    }
+  }
+  // returns the data ready time of a conversion read out at now: the IRQ time in IRQ mode, otherwise now
+  int64_t data_ready_micros(int64_t now) const { return this->irq_pin_ != nullptr ? this->irqMicros_ : now; }
+  bool conversion_timed_out(int64_t now) const {
+    return now - this->conversionStartMicros_ >= (int64_t)kConversionTimeoutMillis * 1000;
+  }
+  void record_conversion(int64_t now);  // updates statistics on a completed conversion, caller must hold lock_
+  void update_telemetry(uint32_t now);  // computes the telemetry snapshot for the interval ending now
+
+  // bracket each SPI transaction (instead of enable / disable), to account bus time
+  void spi_begin() {
+    this->spiBeginMicros_ = esp_timer_get_time();
+    this->enable();
+  }
+  void spi_end(uint8_t bytes) {
+    this->disable();
+    statsSpiMicros_ += esp_timer_get_time() - this->spiBeginMicros_;
+    statsSpiTransactions_++;
+    statsSpiBytes_ += bytes;
+  }
+
   uint8_t fastCommand(FastCommand fastCommandCode);
   bool readRaw24(int32_t* outValue);
+  bool readRaw32(int32_t* outValue, uint8_t* outChannelId);
+  bool readRaw24Single(int32_t* outValue);
   uint8_t writeReg8(uint8_t regAddr, uint8_t data);
+  uint8_t writeRegs8(uint8_t regAddr, const uint8_t* data, uint8_t count);
+  void updateRegs8(uint8_t regAddr, const uint8_t* data, uint8_t count);
+  uint8_t writeReg(uint8_t regAddr, uint32_t data, uint8_t bytes);
+  static uint8_t config2(Gain gain);
   uint32_t readReg(uint8_t regAddr, uint8_t bytes = 1);
   void start_conversion(MCP3561Sensor* sensor);
 
-  Osr osr_;
+  Osr osr_;  // default, for sensors that don't specify their own
   uint8_t device_address_;
 
-  uint32_t conversionStartMillis_ = 0;
-  MCP3561Sensor* queue_[kQueueDepth] = {0};
-  size_t queueWrite_ = 0;  // current conversion, index into queue
-  size_t queueRead_ = 0;  // last item in the queue, empty if read == write
+  // last written values of the 8-bit registers, so unchanged registers aren't rewritten
+  uint8_t shadow_[kShadowRegisters] = {0};
+  uint8_t shadowValid_ = 0;  // bitmask by register address
+
+  std::vector<MCP3561Sensor*> sensors_;
+
+  bool scanMode_ = false;
+  uint32_t scanTimer_ = 0;
+  MCP3561Sensor* scanSensors_[kScanChannels] = {0};  // indexed by SCAN channel ID
+
+  size_t streamBufferSize_ = 0;
+  SampleRing<StreamSample> stream_;
+  MCP3561Sensor* streaming_ = nullptr;  // sensor being streamed, if in streaming mode
+  float streamPeriodMicros_ = 0;  // nominal continuous conversion period
+  int64_t streamReadyMicros_ = 0;  // data ready time of the last stream sample read out, or 0 if none yet
+  int32_t streamCommonModeValue_ = 0;  // see get_stream_common_mode_value
+  uint32_t streamOverwritten_ = 0;
+
+  InternalGPIOPin *irq_pin_ = nullptr;
+  uint32_t pollIntervalMillis_ = 0;  // if nonzero without the IRQ pin, polled from the task
+  TaskHandle_t task_ = nullptr;  // conversion task, in IRQ or task polling mode
+  volatile int64_t irqMicros_ = 0;  // esp_timer_get_time() of the last data ready interrupt
+
+  Mutex lock_;  // guards the SPI device, scheduler and results between loop() and the conversion task
+
+  // timestamps are esp_timer_get_time() micros, which has the same base as millis() but doesn't wrap
+  int64_t conversionStartMicros_ = 0;
+  MCP3561Sensor* converting_ = nullptr;  // sensor of the conversion in progress, if any
+  StrideScheduler<MCP3561Sensor> scheduler_;
+
+  // completed conversions waiting to be processed from loop(), since publishing must run in the main loop
+  // produced under lock_ by service_conversion, consumed lock-free by loop()
+  SampleRing<Sample> results_;
+  std::vector<std::function<void(const Sample*, size_t)>> blockConsumers_;
+  std::vector<std::function<void(const Sample &)>> resultHooks_;
+
+  uint32_t statsStartMillis_ = 0;
+  uint32_t statsConversions_ = 0;
+  uint32_t statsLatencyTotalMicros_ = 0;  // data ready interrupt to read complete, IRQ mode only
+  uint32_t statsLatencyMaxMicros_ = 0;
+  uint32_t statsSpiTransactions_ = 0;
+  uint32_t statsSpiBytes_ = 0;
+  uint32_t statsSpiMicros_ = 0;
+  int64_t spiBeginMicros_ = 0;
+  uint32_t timeouts_ = 0;
+  uint32_t latencyHistogram_[kLatencyBuckets] = {0};
+  Telemetry telemetry_;  // guarded by lock_
 
+  sensor::Sensor *conversionRateSensor_ = nullptr;
+  sensor::Sensor *timeoutsSensor_ = nullptr;
+  sensor::Sensor *droppedSensor_ = nullptr;
+  sensor::Sensor *coalescedSensor_ = nullptr;
+  sensor::Sensor *latencySensor_ = nullptr;
+  sensor::Sensor *latencyMaxSensor_ = nullptr;
+  sensor::Sensor *spiTimeSensor_ = nullptr;
 };
 
 }
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mcp3561 {
+
+// Fixed-capacity single-producer single-consumer ring buffer, lock-free between the producer and consumer.
+// Storage is allocated once by init, push and pop don't allocate.
+template<typename T> class SampleRing {
+ public:
+  void init(size_t capacity) {
+    this->buffer_.resize(capacity + 1);  // one slot is always empty to distinguish full from empty
+    this->read_.store(0);
+    this->write_.store(0);
+  }
+
+  size_t capacity() const { return this->buffer_.size() > 0 ? this->buffer_.size() - 1 : 0; }
+
+  // producer only, returns false (and counts an overrun) if the ring is full
+  bool push(const T &value) {
+    size_t write = this->write_.load(std::memory_order_relaxed);
+    size_t next = (write + 1) % this->buffer_.size();
+    if (next == this->read_.load(std::memory_order_acquire)) {
+      this->overruns_++;
+      return false;
+    }
+    this->buffer_[write] = value;
+    this->write_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only, pops up to max elements into out, returning the number popped
+  size_t pop(T *out, size_t max) {
+    size_t read = this->read_.load(std::memory_order_relaxed);
+    size_t write = this->write_.load(std::memory_order_acquire);
+    size_t count = 0;
+    while (read != write && count < max) {
+      out[count++] = this->buffer_[read];
+      read = (read + 1) % this->buffer_.size();
+    }
+    this->read_.store(read, std::memory_order_release);
+    return count;
+  }
+
+  // consumer only, discards all elements
+  void clear() { this->read_.store(this->write_.load(std::memory_order_acquire), std::memory_order_release); }
+
+  size_t available() const {
+    size_t read = this->read_.load(std::memory_order_acquire);
+    size_t write = this->write_.load(std::memory_order_acquire);
+    return (write + this->buffer_.size() - read) % this->buffer_.size();
+  }
+
+  uint32_t overruns() const { return this->overruns_; }
+
+ protected:
+  std::vector<T> buffer_;
+  std::atomic<size_t> read_{0};
+  std::atomic<size_t> write_{0};
+  uint32_t overruns_ = 0;
+};
+
+}
@@ -1,15 +1,32 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
+import esphome.final_validate as fv
 from esphome.components import sensor, voltage_sampler
-from esphome.const import CONF_ID, CONF_CHANNEL, UNIT_VOLT, STATE_CLASS_MEASUREMENT, DEVICE_CLASS_VOLTAGE
+from esphome.const import CONF_ID, CONF_CHANNEL, CONF_PLATFORM, CONF_PRIORITY, CONF_SENSOR, CONF_TIME_UNIT, \
+    CONF_POWER, CONF_VOLTAGE, UNIT_VOLT, STATE_CLASS_MEASUREMENT, STATE_CLASS_TOTAL, DEVICE_CLASS_VOLTAGE
 
-from .. import mcp3561_ns, MCP3561, MUX, GAIN
+from .. import mcp3561_ns, MCP3561, MUX, GAIN, OSR, SCAN_CHANNELS, CONF_SCAN, CONF_OSR, \
+    UNIT_CONVERSIONS_PER_SECOND, telemetry_sensor_schema
 
 AUTO_LOAD = ["voltage_sampler"]
 DEPENDENCIES = ["mcp3561"]
 
 CONF_CHANNEL_NEG = "channel_neg"
 CONF_GAIN = "gain"
+CONF_WEIGHT = "weight"
+CONF_INTEGRAL = "integral"
+CONF_ENERGY = "energy"
+CONF_RATE = "rate"
+CONF_ACHIEVED_RATE = "achieved_rate"
+CONF_PUBLISH_INTERVAL = "publish_interval"
+
+# integral time units, in seconds
+TIME_UNITS = {
+    "s": 1,
+    "min": 60,
+    "h": 3600,
+    "d": 86400,
+}
 
 MCP3561Sensor = mcp3561_ns.class_(
     "MCP3561Sensor",
@@ -20,7 +37,13 @@ MCP3561Sensor = mcp3561_ns.class_(
 )
 CONF_MCP3561_ID = "mcp3561_id"
 
-CONFIG_SCHEMA = (
+INTEGRAL_SCHEMA = sensor.sensor_schema(state_class=STATE_CLASS_TOTAL).extend(
+    {
+        cv.Optional(CONF_TIME_UNIT, default="h"): cv.enum(TIME_UNITS, lower=True),
+    }
+)
+
+CONFIG_SCHEMA = cv.All(
     sensor.sensor_schema(
       MCP3561Sensor,
       accuracy_decimals=7,
@@ -32,13 +55,62 @@ CONFIG_SCHEMA = (
             cv.Required(CONF_CHANNEL): cv.enum(MUX, upper=True),
             cv.Optional(CONF_CHANNEL_NEG, default="AGND"): cv.enum(MUX, upper=True),
             cv.Optional(CONF_GAIN, default="X1"): cv.enum(GAIN, upper=True),
+            # overrides the ADC OSR for this channel, eg for a fast low-resolution protection reading alongside
+            # a precise reading (as a separate sensor) of the same channel
+            cv.Optional(CONF_OSR): cv.enum(OSR),
+            # share of ADC time relative to other pending sensors at the same priority
+            cv.Optional(CONF_WEIGHT, default=1): cv.int_range(min=1, max=255),
+            # pending sensors at a higher priority are always converted first, eg use -1 for background channels
+            cv.Optional(CONF_PRIORITY, default=0): cv.int_range(min=-128, max=127),
+            # target conversion rate, requested by the ADC schedule instead of on each update (update_interval
+            # is then unused), keeping the sensor eligible so weight sets its share when the ADC is saturated
+            cv.Optional(CONF_RATE): cv.All(cv.frequency, cv.Range(min=0.1, max=100000)),
+            # publishes the mean of the conversions over this interval (with the integral, power and energy)
+            # instead of every conversion, to limit the per-conversion cost of filters, callbacks and the API
+            # integrals and full-rate consumers (eg, sample_buffer conversion sources) still see every conversion
+            cv.Optional(CONF_PUBLISH_INTERVAL): cv.positive_time_period_milliseconds,
+            # conversions/s actually achieved for this channel, published every statistics interval (10s)
+            cv.Optional(CONF_ACHIEVED_RATE): telemetry_sensor_schema(UNIT_CONVERSIONS_PER_SECOND),
+            # integral of the calibrated value over conversion acquisition times, accumulated natively from every
+            # conversion (instead of on publish, like the integration platform), published with the sensor
+            cv.Optional(CONF_INTEGRAL): INTEGRAL_SCHEMA,
+            # product with the latest conversion of the voltage sensor (eg, power from current), at the acquisition
+            # time of each conversion of this sensor, and its integral like integral
+            cv.Optional(CONF_POWER): sensor.sensor_schema(state_class=STATE_CLASS_MEASUREMENT).extend(
+                {
+                    cv.Required(CONF_VOLTAGE): cv.use_id(MCP3561Sensor),
+                }
+            ),
+            cv.Optional(CONF_ENERGY): INTEGRAL_SCHEMA,
         }
     )
-    .extend(cv.polling_component_schema("60s"))
+    .extend(cv.polling_component_schema("60s")),
+    cv.has_none_or_all_keys(CONF_POWER, CONF_ENERGY),
 )
 
 
+def _final_validate(config):
+    full_config = fv.full_config.get()
+    hub_path = full_config.get_path_for_id(config[CONF_MCP3561_ID])[:-1]
+    hub_config = full_config.get_config_for_path(hub_path)
+    if hub_config[CONF_SCAN] and \
+            (str(config[CONF_CHANNEL]), str(config[CONF_CHANNEL_NEG])) not in SCAN_CHANNELS:
+        raise cv.Invalid(f"channel {config[CONF_CHANNEL]}-{config[CONF_CHANNEL_NEG]} not available in SCAN mode")
+    if hub_config[CONF_SCAN] and config.get(CONF_OSR, hub_config[CONF_OSR]) != hub_config[CONF_OSR]:
+        raise cv.Invalid("per-channel OSR not available in SCAN mode")
+    if hub_config[CONF_SCAN]:  # the device applies one gain to the whole scan
+        for other in full_config.get(CONF_SENSOR, []):
+            if other[CONF_PLATFORM] == "mcp3561" and str(other[CONF_MCP3561_ID]) == str(config[CONF_MCP3561_ID]) \
+                    and str(other[CONF_GAIN]) != str(config[CONF_GAIN]):
+                raise cv.Invalid(f"gain {config[CONF_GAIN]} differs from {other[CONF_GAIN]} of another sensor, "
+                                 "SCAN mode requires the same gain on all channels")
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
+
 async def to_code(config):
+    paren = await cg.get_variable(config[CONF_MCP3561_ID])
     var = cg.new_Pvariable(
         config[CONF_ID],
         config[CONF_CHANNEL],
@@ -46,28 +118,75 @@ async def to_code(config):
         config[CONF_GAIN],
     )
     await cg.register_parented(var, config[CONF_MCP3561_ID])
+    cg.add(paren.register_sensor(var))
+    if CONF_OSR in config:
+        cg.add(var.set_osr(config[CONF_OSR]))
+    cg.add(var.set_weight(config[CONF_WEIGHT]))
+    cg.add(var.set_priority(config[CONF_PRIORITY]))
+    if CONF_RATE in config:
+        cg.add(var.set_rate(config[CONF_RATE]))
+    if CONF_PUBLISH_INTERVAL in config:
+        cg.add(var.set_publish_interval(config[CONF_PUBLISH_INTERVAL]))
+    if achieved_rate_config := config.get(CONF_ACHIEVED_RATE):
+        sens = await sensor.new_sensor(achieved_rate_config)
+        cg.add(var.set_achieved_rate_sensor(sens))
+    if integral_config := config.get(CONF_INTEGRAL):
+        sens = await sensor.new_sensor(integral_config)
+        cg.add(var.set_integral_sensor(sens, TIME_UNITS[integral_config[CONF_TIME_UNIT]]))
+    if power_config := config.get(CONF_POWER):
+        voltage = await cg.get_variable(power_config[CONF_VOLTAGE])
+        sens = await sensor.new_sensor(power_config)
+        cg.add(var.set_power_sensor(voltage, sens))
+        energy_config = config[CONF_ENERGY]
+        sens = await sensor.new_sensor(energy_config)
+        cg.add(var.set_energy_sensor(sens, TIME_UNITS[energy_config[CONF_TIME_UNIT]]))
     await cg.register_component(var, config)
     await sensor.register_sensor(var, config)
 
 
-from esphome.const import CONF_WINDOW_SIZE, CONF_SEND_EVERY
+from esphome.const import CONF_WINDOW_SIZE, CONF_SEND_EVERY, CONF_TYPE
 from esphome.components.sensor import Filter, FILTER_REGISTRY
-range_filter_ns = cg.esphome_ns.namespace("range_filter")
-RangeFilter = range_filter_ns.class_("RangeFilter", Filter)
+window_stats_ns = cg.esphome_ns.namespace("window_stats")
+WindowStatsFilter = window_stats_ns.class_("WindowStatsFilter", Filter)
+WindowStatsType = window_stats_ns.enum("WindowStatsType")
 
-RANGE_SCHEMA = cv.All(
-    cv.Schema(
-        {
-            cv.Optional(CONF_WINDOW_SIZE, default=5): cv.positive_not_null_int,
-            cv.Optional(CONF_SEND_EVERY, default=5): cv.positive_not_null_int,
-        }
-    ),
+WINDOW_STATS_TYPES = {
+    "range": WindowStatsType.kRange,
+    "min": WindowStatsType.kMin,
+    "max": WindowStatsType.kMax,
+    "mean": WindowStatsType.kMean,
+    "stddev": WindowStatsType.kStdDev,
+    "rms": WindowStatsType.kRms,
+}
+
+WINDOW_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_WINDOW_SIZE, default=5): cv.positive_not_null_int,
+        cv.Optional(CONF_SEND_EVERY, default=5): cv.positive_not_null_int,
+    }
+)
+
+WINDOW_STATS_SCHEMA = WINDOW_SCHEMA.extend(
+    {
+        cv.Required(CONF_TYPE): cv.enum(WINDOW_STATS_TYPES, lower=True),
+    }
 )
 
-@FILTER_REGISTRY.register("range", RangeFilter, RANGE_SCHEMA)
-async def min_filter_to_code(config, filter_id):
+@FILTER_REGISTRY.register("window_stats", WindowStatsFilter, WINDOW_STATS_SCHEMA)
+async def window_stats_filter_to_code(config, filter_id):
+    return cg.new_Pvariable(
+        filter_id,
+        config[CONF_TYPE],
+        config[CONF_WINDOW_SIZE],
+        config[CONF_SEND_EVERY],
+    )
+
+# shorthand for window_stats with type: range
+@FILTER_REGISTRY.register("range", WindowStatsFilter, WINDOW_SCHEMA)
+async def range_filter_to_code(config, filter_id):
     return cg.new_Pvariable(
         filter_id,
+        WindowStatsType.kRange,
         config[CONF_WINDOW_SIZE],
         config[CONF_SEND_EVERY],
     )
@@ -17,16 +17,79 @@ void MCP3561Sensor::dump_config() {
   LOG_SENSOR("", "MCP3561Sensor Sensor", this);
   ESP_LOGCONFIG(TAG, "  Pin: %u", this->channel_);
   ESP_LOGCONFIG(TAG, "  Pin neg: %u", this->channel_neg_);
+  if (this->osr_.has_value()) {
+    ESP_LOGCONFIG(TAG, "  OSR: %u", *this->osr_);
+  }
+  ESP_LOGCONFIG(TAG, "  Weight: %u, priority: %i", this->weight_, this->priority_);
+  if (this->publishIntervalMicros_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Publish interval: %u ms", this->publishIntervalMicros_ / 1000);
+  }
+  if (this->ratePeriodMicros_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Target rate: %.1f conversions/s", 1e6f / this->ratePeriodMicros_);
+  }
   LOG_UPDATE_INTERVAL(this);
+  if (this->integral_.sensor != nullptr) {
+    LOG_SENSOR("  ", "Integral", this->integral_.sensor);
+  }
+  if (this->powerSensor_ != nullptr) {
+    LOG_SENSOR("  ", "Power", this->powerSensor_);
+  }
+  if (this->energy_.sensor != nullptr) {
+    LOG_SENSOR("  ", "Energy", this->energy_.sensor);
+  }
 }
 
 void MCP3561Sensor::update() {
-  this->parent_->enqueue(this);
+  if (this->ratePeriodMicros_ == 0) {  // otherwise requested by the parent at the target rate
+    this->parent_->enqueue(this);
+  }
 }
 
-void MCP3561Sensor::conversion_result(int32_t adcCounts) {
-  rawValue = adcCounts;
-  this->publish_state(adcCounts / (float)(1 << 23)); 
+void MCP3561Sensor::conversion_result(const Sample &sample) {
+  // every conversion is integrated and passed to the conversion callbacks, independently of the publish interval
+  // conversions of all sensors come in order, so the voltage sensor's latest is the one before this conversion
+  int64_t micros = sample.startMicros + (sample.readyMicros - sample.startMicros) / 2;  // see conversion_micros
+  this->latestCalibrated_ = sample.calibrated;
+  this->integral_.add(sample.calibrated, micros);
+  float power = NAN;
+  if (this->powerVoltage_ != nullptr) {
+    power = sample.calibrated * this->powerVoltage_->latestCalibrated_;
+    this->energy_.add(power, micros);
+  }
+  this->conversionCallback_.call(sample.calibrated, micros);
+
+  if (this->windowConversions_ == 0) {
+    this->windowStartMicros_ = sample.startMicros;
+  }
+  this->windowConversions_++;
+  this->windowCounts_ += sample.value;
+  this->windowValue_.add(sample.calibrated);
+  this->windowPower_.add(power);
+  if (sample.readyMicros - this->windowStartMicros_ < (int64_t) this->publishIntervalMicros_) {
+    return;
+  }
+
+  rawValue = this->windowCounts_ / this->windowConversions_;
+  conversionRange = sample.range;
+  conversionStartMicros = this->windowStartMicros_;
+  conversionReadyMicros = sample.readyMicros;
+  float value = this->windowValue_.mean();
+  float meanPower = this->windowPower_.mean();
+  this->windowConversions_ = 0;
+  this->windowCounts_ = 0;
+  this->windowValue_.reset();
+  this->windowPower_.reset();
+
+  this->publish_state(value);
+  if (this->integral_.sensor != nullptr) {
+    this->integral_.sensor->publish_state(this->integral_.total);
+  }
+  if (this->powerSensor_ != nullptr) {
+    this->powerSensor_->publish_state(meanPower);
+  }
+  if (this->energy_.sensor != nullptr) {
+    this->energy_.sensor->publish_state(this->energy_.total);
+  }
 }
 
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/voltage_sampler/voltage_sampler.h"
 #include "esphome/core/component.h"
@@ -9,6 +11,41 @@
 using namespace esphome;
 namespace mcp3561 {
 
+// left (sample and hold) integral over acquisition times, NaN values integrate as zero until the next valid value
+struct AcquisitionIntegral {
+  sensor::Sensor *sensor = nullptr;  // published with the total, if set
+  double timeUnitMicros = 1e6;
+  double total = 0;
+  float last = NAN;  // value of the last sample, held until the next
+  int64_t lastMicros = 0;
+
+  void add(float value, int64_t micros) {
+    if (!std::isnan(this->last)) {
+      this->total += this->last * ((micros - this->lastMicros) / this->timeUnitMicros);
+    }
+    this->last = value;
+    this->lastMicros = micros;
+  }
+};
+
+// mean of the finite values added since the last reset, NaN if none
+struct PublishMean {
+  double sum = 0;
+  uint32_t count = 0;
+
+  void add(float value) {
+    if (std::isfinite(value)) {
+      this->sum += value;
+      this->count++;
+    }
+  }
+  float mean() const { return this->count > 0 ? this->sum / this->count : NAN; }
+  void reset() {
+    this->sum = 0;
+    this->count = 0;
+  }
+};
+
 class MCP3561Sensor : public PollingComponent,
                       public sensor::Sensor,
                       public Parented<MCP3561> {
@@ -20,13 +57,127 @@ class MCP3561Sensor : public PollingComponent,
   void dump_config() override;
   float get_setup_priority() const override;
 
-  void conversion_result(int32_t adcCounts);  // called by the parent on a conversion result for this sensor
+  // called by the parent on each conversion result for this sensor in order, with its calibrated value
+  void conversion_result(const Sample &sample);
+
+  // publishes at most once per interval (by conversion time) instead of with every conversion, the mean of the
+  // conversions since the last publish, along with the integral, power and energy sensors, to limit the
+  // per-conversion cost of filters, callbacks and the API, while the integrals and conversion callbacks still see
+  // every conversion
+  void set_publish_interval(uint32_t intervalMillis) { this->publishIntervalMicros_ = intervalMillis * 1000; }
+  // registers a callback called from loop() with the calibrated value and acquisition time (see conversion_micros)
+  // of every conversion, including those not published, eg for recording at the full conversion rate
+  void add_on_conversion_callback(std::function<void(float, int64_t)> &&callback) {
+    this->conversionCallback_.add(std::move(callback));
+  }
+
+  // returns the calibrated value of a conversion, or the ADC ratio if no calibration function is set
+  // this is also the published value, so filters receive calibrated values
+  float calibrate(const Sample &sample) const {
+    return this->calibration_ ? this->calibration_(sample) : sample.value / (float)(1 << 23);
+  }
+  void set_calibration(std::function<float(const Sample &)> &&calibration) {
+    this->calibration_ = std::move(calibration);
+  }
+  // optional, evaluated by the parent as each conversion is read out and recorded with it as its range (eg, of a
+  // switched current sense), from the conversion task in IRQ or task polling mode, so it must be fast and safe to
+  // call from there, eg reading switch states, and must be set before setup
+  void set_range_function(std::function<int8_t()> &&range) { this->rangeFunction_ = std::move(range); }
+  // optional, the latest conversion of which (in ADC counts) is recorded with each conversion of this sensor, eg for
+  // common-mode compensation in calibration
+  void set_common_mode_sensor(MCP3561Sensor *sensor) { this->commonModeSensor_ = sensor; }
 
-  int32_t rawValue;
+  // optional, published with this sensor with the integral of the calibrated value over acquisition time
+  // (eg, charge from current) in value * time unit, accumulated natively from every conversion
+  // NaN values (eg, no calibrated range) integrate as zero until the next valid conversion
+  void set_integral_sensor(sensor::Sensor *sensor, float timeUnitSeconds) {
+    this->integral_.sensor = sensor;
+    this->integral_.timeUnitMicros = timeUnitSeconds * 1e6;
+  }
+  // optional, published with this sensor with the product of the calibrated value and the latest calibrated
+  // conversion of the voltage sensor (eg, power from current) at the acquisition time of each conversion, as the
+  // mean over the conversions since the last publish
+  void set_power_sensor(MCP3561Sensor *voltage, sensor::Sensor *sensor) {
+    this->powerVoltage_ = voltage;
+    this->powerSensor_ = sensor;
+  }
+  // optional with the power sensor, its integral over acquisition time like the integral sensor
+  void set_energy_sensor(sensor::Sensor *sensor, float timeUnitSeconds) {
+    this->energy_.sensor = sensor;
+    this->energy_.timeUnitMicros = timeUnitSeconds * 1e6;
+  }
+  void reset_integrals() {
+    this->integral_.total = 0;
+    this->energy_.total = 0;
+  }
+
+  // acquisition time of the last published value, as the center of the conversions it is the mean of (or of the
+  // conversion), in esp_timer_get_time() micros
+  int64_t conversion_micros() const {
+    return this->conversionStartMicros + (this->conversionReadyMicros - this->conversionStartMicros) / 2;
+  }
+
+  // overrides the parent's OSR for this sensor's conversions
+  void set_osr(MCP3561::Osr osr) { this->osr_ = osr; }
+
+  // relative share of ADC time when multiple sensors at the same priority have pending conversions
+  void set_weight(uint8_t weight) { this->weight_ = weight; }
+  // pending sensors at a higher priority are always converted before those at a lower priority
+  void set_priority(int8_t priority) { this->priority_ = priority; }
+  // requests conversions at a target rate (conversions/s) from the parent's schedule instead of on update(),
+  // so the sensor stays eligible between conversions and, with the ADC saturated, gets its weighted share
+  void set_rate(float rate) { this->ratePeriodMicros_ = 1e6f / rate; }
+
+  // conversions per second over the last statistics interval
+  float get_achieved_rate() const { return this->achievedRate_; }
+  // total requests (updates) made while a previous request was still pending
+  uint32_t get_coalesced_requests() const { return this->coalescedRequests_; }
+  // optional, published with the achieved rate every statistics interval
+  void set_achieved_rate_sensor(sensor::Sensor *sensor) { this->achievedRateSensor_ = sensor; }
+
+  int32_t rawValue;  // of the last published value, the mean ADC counts of its conversions
+  int8_t conversionRange = 0;  // recorded range of the last published conversion, see set_range_function
+  int64_t conversionStartMicros = 0;
+  int64_t conversionReadyMicros = 0;
 
   MCP3561::Mux channel_;
   MCP3561::Mux channel_neg_;
   MCP3561::Gain gain_;
+  optional<MCP3561::Osr> osr_;  // if not set, uses the parent's OSR
+
+  // scheduler state, managed by the parent under its lock
+  uint8_t weight_ = 1;
+  int8_t priority_ = 0;
+  bool pending_ = false;  // a conversion is requested and not yet started
+  uint32_t pass_ = 0;
+  uint32_t ratePeriodMicros_ = 0;  // target rate period, or zero for conversions on update() only
+  int64_t dueMicros_ = 0;  // esp_timer_get_time() when the next target rate conversion is requested
+  uint32_t conversions_ = 0;  // in the current statistics interval
+  uint32_t coalescedRequests_ = 0;
+  float achievedRate_ = 0;
+  sensor::Sensor *achievedRateSensor_ = nullptr;
+  // conversion context, read by the parent at readout under its lock
+  std::function<int8_t()> rangeFunction_;
+  MCP3561Sensor *commonModeSensor_ = nullptr;
+  int32_t latestCounts_ = 0;  // of the latest conversion read out, written by the parent under its lock
+
+ protected:
+  std::function<float(const Sample &)> calibration_;
+  CallbackManager<void(float, int64_t)> conversionCallback_;
+  float latestCalibrated_ = NAN;  // of the latest conversion, eg for sensors with this as their power voltage
+
+  AcquisitionIntegral integral_;
+  MCP3561Sensor *powerVoltage_ = nullptr;
+  sensor::Sensor *powerSensor_ = nullptr;
+  AcquisitionIntegral energy_;
+
+  // conversions since the last publish
+  uint32_t publishIntervalMicros_ = 0;  // publishes every conversion if zero
+  uint32_t windowConversions_ = 0;
+  int64_t windowCounts_ = 0;  // sum of ADC counts
+  int64_t windowStartMicros_ = 0;  // conversion start of the first
+  PublishMean windowValue_;
+  PublishMean windowPower_;
 };
 
 }
@@ -0,0 +1,123 @@
+#include "window_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "esphome/core/log.h"
+
+using namespace esphome;
+namespace window_stats {
+
+static const char *const TAG = "window_stats";
+
+WindowStatsFilter::WindowStatsFilter(WindowStatsType type, size_t window_size, size_t send_every)
+    : type_(type), window_size_(window_size), send_every_(send_every),
+      window_(new float[window_size]) {
+  this->min_queue_.indices.reset(new uint32_t[window_size]);
+  this->max_queue_.indices.reset(new uint32_t[window_size]);
+}
+
+void WindowStatsFilter::queue_push(MonotonicQueue &queue, uint32_t index, bool isMax) {
+  // drop values from the back that can no longer be the extreme, since the new value outlasts them
+  float value = this->window_[this->slot_of(index)];
+  while (queue.size > 0) {
+    float back = this->window_[this->slot_of(queue.indices[(queue.head + queue.size - 1) % this->window_size_])];
+    if (isMax ? back > value : back < value) {
+      break;
+    }
+    queue.size--;
+  }
+  queue.indices[(queue.head + queue.size) % this->window_size_] = index;
+  queue.size++;
+}
+
+void WindowStatsFilter::recompute_sums() {
+  this->sumOffset_ = this->count_ > 0 ? this->sumOffset_ + this->sum_ / this->count_ : 0;
+  this->sum_ = 0;
+  this->sumSquares_ = 0;
+  for (size_t i = 0; i < this->filled_; i++) {
+    float v = this->window_[i];
+    if (!std::isnan(v)) {
+      double offset = v - this->sumOffset_;
+      this->sum_ += offset;
+      this->sumSquares_ += offset * offset;
+    }
+  }
+}
+
+optional<float> WindowStatsFilter::new_value(float value) {
+  uint32_t index = this->next_index_++;
+  size_t slot = this->next_slot_;
+  this->next_slot_ = (slot + 1) % this->window_size_;
+  // expire the queue fronts that are leaving the window, at most one each since this runs every value
+  for (MonotonicQueue *queue : {&this->min_queue_, &this->max_queue_}) {
+    if (queue->size > 0 && index - queue->indices[queue->head] >= this->window_size_) {
+      queue->head = (queue->head + 1) % this->window_size_;
+      queue->size--;
+    }
+  }
+  if (this->filled_ == this->window_size_) {  // evict the oldest value
+    float old = this->window_[slot];
+    if (!std::isnan(old)) {
+      double offset = old - this->sumOffset_;
+      this->sum_ -= offset;
+      this->sumSquares_ -= offset * offset;
+      this->count_--;
+    }
+  } else {
+    this->filled_++;
+  }
+  this->window_[slot] = value;
+  if (!std::isnan(value)) {
+    double offset = value - this->sumOffset_;
+    this->sum_ += offset;
+    this->sumSquares_ += offset * offset;
+    this->count_++;
+    this->queue_push(this->min_queue_, index, false);
+    this->queue_push(this->max_queue_, index, true);
+  }
+  if (slot == this->window_size_ - 1) {  // once per window, so amortized O(1)
+    this->recompute_sums();
+  }
+
+  this->send_at_++;
+  if (this->send_at_ < this->send_every_) {
+    return {};
+  }
+  this->send_at_ = 0;
+
+  if (this->count_ == 0) {
+    return NAN;
+  }
+  float min = this->window_[this->slot_of(this->min_queue_.indices[this->min_queue_.head])];
+  float max = this->window_[this->slot_of(this->max_queue_.indices[this->max_queue_.head])];
+  double meanOffset = this->sum_ / this->count_;
+  double variance = std::max(0.0, this->sumSquares_ / this->count_ - meanOffset * meanOffset);
+  double mean = this->sumOffset_ + meanOffset;
+  float result;
+  switch (this->type_) {
+    case kRange:
+      result = max - min;
+      break;
+    case kMin:
+      result = min;
+      break;
+    case kMax:
+      result = max;
+      break;
+    case kMean:
+      result = mean;
+      break;
+    case kStdDev:
+      result = std::sqrt(variance);
+      break;
+    case kRms:
+    default:
+      result = std::sqrt(variance + mean * mean);
+      break;
+  }
+  ESP_LOGVV(TAG, "WindowStatsFilter(%p)::new_value(%f) SENDING %f", this, value, result);
+  return result;
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/sensor/filter.h"
+#include "esphome/core/component.h"
+
+using namespace esphome;
+namespace window_stats {
+
+enum WindowStatsType {
+  kRange,
+  kMin,
+  kMax,
+  kMean,
+  kStdDev,  // population standard deviation
+  kRms,
+};
+
+// Sliding window statistics (ignoring NaNs) over the last window_size values, emitted every send_every values
+// Amortized O(1) per value without allocation after construction: min and max are tracked with monotonic queues
+// (of indices into the window ring), and the mean, standard deviation and RMS from running sums
+class WindowStatsFilter : public sensor::Filter {
+ public:
+  WindowStatsFilter(WindowStatsType type, size_t window_size, size_t send_every);
+
+  optional<float> new_value(float value) override;
+
+protected:
+  // bounded double-ended queue of value indices, with values monotonic from front to back
+  struct MonotonicQueue {
+    std::unique_ptr<uint32_t[]> indices;
+    size_t head = 0;  // position of the front in indices
+    size_t size = 0;
+  };
+  void queue_push(MonotonicQueue &queue, uint32_t index, bool isMax);
+  // returns the window slot of a value index, which must be in the window
+  size_t slot_of(uint32_t index) const {
+    uint32_t age = this->next_index_ - 1 - index;  // wrap-safe
+    return (this->next_slot_ + this->window_size_ - 1 - age) % this->window_size_;
+  }
+  // sums are of the values offset by sumOffset_, which is reset to the window mean periodically (eliminating
+  // accumulated rounding error), so the variance doesn't suffer from cancellation when the mean is far from zero
+  void recompute_sums();
+
+  WindowStatsType type_;
+  size_t window_size_;
+  size_t send_every_;
+
+  size_t send_at_ = 0;
+
+  std::unique_ptr<float[]> window_;  // indexed by slot, which advances with the value index
+  uint32_t next_index_ = 0;  // index of the next value, wraps, so only differences of indices are meaningful
+  size_t next_slot_ = 0;  // slot of the next value, kept separately since index modulo window_size_ jumps on wrap
+  size_t filled_ = 0;  // values in the window, up to window_size_
+  MonotonicQueue min_queue_;  // increasing
+  MonotonicQueue max_queue_;  // decreasing
+
+  size_t count_ = 0;  // non-NaN values in the window
+  double sumOffset_ = 0;
+  double sum_ = 0;
+  double sumSquares_ = 0;
+};
+
+}
@@ -0,0 +1,134 @@
+#include "stream_handler.h"
+
+#ifdef USE_MCP3561_STREAM_HANDLER
+
+#include <cinttypes>
+
+#include "esphome/core/log.h"
+
+#include "sensor/mcp3561_sensor.h"
+
+using namespace esphome;
+namespace mcp3561 {
+
+static const char *const TAG = "mcp3561.stream";
+
+static const size_t kReadBlockSize = 32;  // samples read from the stream buffer at a time
+
+void MCP3561StreamHandler::setup() {
+  this->capture_.reserve(this->captureSize_);
+  this->base_->init();
+  this->base_->add_handler(this);
+}
+
+void MCP3561StreamHandler::loop() {
+  LockGuard guard(this->lock_);
+  if (this->startRequested_) {
+    this->startRequested_ = false;
+    this->capture_.clear();
+    this->overwrittenStart_ = this->parent_->get_stream_overwritten();
+    this->droppedStart_ = this->parent_->get_stream_overruns();
+    if (this->parent_->start_stream(this->sensor_, this->osr_)) {
+      ESP_LOGI(TAG, "capturing %u samples of %s at OSR %u", (unsigned) this->samples_,
+               this->sensor_->get_name().c_str(), MCP3561::osr_value(this->osr_));
+      this->state_ = kCapturing;
+    } else {
+      this->state_ = kFailed;
+    }
+  }
+  if (this->state_ != kCapturing) {
+    return;
+  }
+
+  StreamSample block[kReadBlockSize];
+  size_t count;
+  int32_t commonModeValue = this->parent_->get_stream_common_mode_value();
+  while ((count = this->parent_->read_stream(block, std::min(kReadBlockSize,
+                                                             this->samples_ - this->capture_.size()))) > 0) {
+    for (size_t i=0; i<count; i++) {
+      Sample sample{this->sensor_, block[i].value, block[i].micros, block[i].micros, NAN, commonModeValue,
+                    block[i].range};
+      this->capture_.push_back({block[i].micros, block[i].value, this->sensor_->calibrate(sample)});
+    }
+  }
+  this->overwritten_ = this->parent_->get_stream_overwritten() - this->overwrittenStart_;
+  this->dropped_ = this->parent_->get_stream_overruns() - this->droppedStart_;
+  if (this->capture_.size() >= this->samples_) {
+    this->parent_->stop_stream();
+    this->state_ = kComplete;
+    ESP_LOGI(TAG, "capture complete, %" PRIu32 " overwritten, %" PRIu32 " dropped", this->overwritten_,
+             this->dropped_);
+  }
+}
+
+bool MCP3561StreamHandler::canHandle(AsyncWebServerRequest *request) const {
+  if (request->method() == HTTP_GET || request->method() == HTTP_POST) {
+    if (request->url() == this->path_.c_str())
+      return true;
+  }
+
+  return false;
+}
+
+void MCP3561StreamHandler::handleRequest(AsyncWebServerRequest *req) {
+  if (req->method() == HTTP_POST) {
+    this->handle_start(req);
+    return;
+  }
+
+  static const char *const kStateNames[] = {"idle", "capturing", "complete", "failed"};
+  AsyncResponseStream *stream = req->beginResponseStream("text/plain; version=0.0.4; charset=utf-8");
+  LockGuard guard(this->lock_);
+  std::string out;
+  char buf[64];
+  snprintf(buf, sizeof(buf), "state,%s,%u,%" PRIu32 ",%" PRIu32 "\n", kStateNames[this->state_],
+           (unsigned) this->capture_.size(), this->overwritten_, this->dropped_);
+  out.append(buf);
+  if (this->state_ == kComplete) {
+    for (const auto &sample : this->capture_) {
+      snprintf(buf, sizeof(buf), "%" PRIu32 ".%03u,%" PRIi32 ",%g\n", (uint32_t)(sample.micros / 1000),
+               (unsigned)(sample.micros % 1000), sample.value, sample.calibrated);
+      out.append(buf);
+    }
+  }
+  stream->write((const uint8_t *) out.data(), out.size());
+  req->send(stream);
+}
+
+void MCP3561StreamHandler::handle_start(AsyncWebServerRequest *req) {
+  MCP3561Sensor *sensor = nullptr;
+  std::string name = req->arg("sensor").c_str();
+  for (auto *candidate : this->parent_->get_sensors()) {
+    if (candidate->get_name() == name) {
+      sensor = candidate;
+    }
+  }
+  int osr = -1;
+  uint32_t osrValue = req->hasArg("osr") ? std::strtoul(req->arg("osr").c_str(), nullptr, 10) : 32;
+  for (uint8_t i=0; i<16; i++) {
+    if (MCP3561::osr_value((MCP3561::Osr) i) == osrValue) {
+      osr = i;
+    }
+  }
+  size_t samples = req->hasArg("samples") ? std::strtoul(req->arg("samples").c_str(), nullptr, 10) :
+                                            this->captureSize_;
+  if (sensor == nullptr || osr < 0 || samples == 0 || samples > this->captureSize_) {
+    req->send(400, "text/plain", "invalid sensor, osr or samples");
+    return;
+  }
+
+  LockGuard guard(this->lock_);
+  if (this->state_ == kCapturing || this->startRequested_) {
+    req->send(409, "text/plain", "capture in progress");
+    return;
+  }
+  this->sensor_ = sensor;
+  this->osr_ = (MCP3561::Osr) osr;
+  this->samples_ = samples;
+  this->startRequested_ = true;
+  req->send(200, "text/plain", "started");
+}
+
+}
+
+#endif
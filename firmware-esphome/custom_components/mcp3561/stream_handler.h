@@ -0,0 +1,83 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_MCP3561_STREAM_HANDLER
+
+#include <string>
+#include <vector>
+
+#include "esphome/components/web_server_base/web_server_base.h"
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+
+#include "mcp3561.h"
+
+using namespace esphome;
+namespace mcp3561 {
+
+// Captures a burst of back-to-back conversions of one sensor's channel in streaming mode, over HTTP:
+// POST starts a capture, with args
+//   sensor: sensor name to stream the channel of
+//   osr: oversampling ratio, default 32 (the fastest)
+//   samples: number of samples, default and at most the capture size
+// GET returns the latest capture, as text lines of
+//   state,(idle, capturing, complete or failed),(samples),(overwritten),(dropped)
+// followed, once complete, by the samples as
+//   (timestamp in millis, with three decimal places),(ADC counts),(calibrated value)
+// where overwritten counts conversions lost on the device between readouts, and dropped those lost with the
+// stream buffer full (both should be zero for back-to-back captures)
+// the ADC returns to scheduled conversions when the capture completes
+class MCP3561StreamHandler : public Component, public AsyncWebHandler {
+ public:
+  MCP3561StreamHandler(MCP3561 *parent, web_server_base::WebServerBase *base, const std::string &path,
+                       size_t captureSize) :
+    parent_(parent), base_(base), path_(path), captureSize_(captureSize) {}
+
+  bool canHandle(AsyncWebServerRequest *request) const override;
+
+  void handleRequest(AsyncWebServerRequest *req) override;
+
+  void setup() override;
+  void loop() override;
+  float get_setup_priority() const override {
+    // After WiFi
+    return setup_priority::WIFI - 1.0f;
+  }
+
+ protected:
+  enum CaptureState : uint8_t {
+    kIdle = 0,
+    kCapturing = 1,
+    kComplete = 2,
+    kFailed = 3,
+  };
+
+  struct CaptureSample {
+    int64_t micros;  // esp_timer_get_time() at data ready
+    int32_t value;  // signed 24-bit ADC counts
+    float calibrated;
+  };
+
+  void handle_start(AsyncWebServerRequest *req);
+
+  MCP3561 *parent_;
+  web_server_base::WebServerBase *base_;
+  std::string path_;
+  size_t captureSize_;
+
+  Mutex lock_;  // guards the capture and its state between loop() and the web server
+  std::vector<CaptureSample> capture_;
+  CaptureState state_ = kIdle;
+  MCP3561Sensor *sensor_ = nullptr;
+  MCP3561::Osr osr_ = MCP3561::k32;
+  size_t samples_ = 0;  // requested
+  bool startRequested_ = false;  // set by the web server, started from loop() since streaming is main-loop only
+  uint32_t overwrittenStart_ = 0;
+  uint32_t droppedStart_ = 0;
+  uint32_t overwritten_ = 0;
+  uint32_t dropped_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace mcp3561 {
+
+const uint32_t kStrideScale = 1 << 16;  // scheduler pass advance for a weight-1 sensor
+
+// Stride scheduling: among the pending entries of the highest priority, selects the one with the lowest pass
+// (virtual time), which advances by a stride inversely proportional to the entry's weight on each selection.
+// This gives each pending entry a share of selections proportional to its weight, without starvation
+// within a priority level.
+// Entries are any type with the fields pending_, priority_, weight_ and pass_ (eg, MCP3561Sensor).
+// Kept free of ESPHome and device dependencies, so the scheduling policy can be built and exercised off-target.
+template<typename T> class StrideScheduler {
+ public:
+  // a request for an entry re-joining the schedule starts it at the current virtual time,
+  // so it can't claim time it spent idle
+  void join(T *entry) {
+    if ((int32_t)(entry->pass_ - this->pass_) < 0) {
+      entry->pass_ = this->pass_;
+    }
+  }
+
+  // returns the next pending entry and advances its pass, or nullptr if none are pending
+  // the caller clears pending_ as the entry's work starts, so an entry requested again meanwhile stays eligible
+  T *next(const std::vector<T*> &entries) {
+    T *next = nullptr;
+    for (auto *entry : entries) {
+      if (!entry->pending_) {
+        continue;
+      }
+      if (next == nullptr || entry->priority_ > next->priority_ ||
+          (entry->priority_ == next->priority_ && (int32_t)(entry->pass_ - next->pass_) < 0)) {
+        next = entry;
+      }
+    }
+    if (next != nullptr) {
+      this->pass_ = next->pass_;
+      next->pass_ += kStrideScale / next->weight_;
+    }
+    return next;
+  }
+
+ protected:
+  uint32_t pass_ = 0;  // virtual time, the pass of the last selected entry
+};
+
+}
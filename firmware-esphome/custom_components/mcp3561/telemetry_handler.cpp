@@ -0,0 +1,55 @@
+#include "telemetry_handler.h"
+
+#ifdef USE_MCP3561_TELEMETRY_HANDLER
+
+#include "sensor/mcp3561_sensor.h"
+
+using namespace esphome;
+namespace mcp3561 {
+
+bool MCP3561TelemetryHandler::canHandle(AsyncWebServerRequest *request) const {
+  if (request->method() == HTTP_GET) {
+    if (request->url() == this->path_.c_str())
+      return true;
+  }
+
+  return false;
+}
+
+void MCP3561TelemetryHandler::handleRequest(AsyncWebServerRequest *req) {
+  AsyncResponseStream *stream = req->beginResponseStream("text/plain; version=0.0.4; charset=utf-8");
+  Telemetry telemetry = this->parent_->get_telemetry();
+
+  stream->printf("mcp3561_conversion_rate %.2f\n", telemetry.conversionRate);
+  stream->printf("mcp3561_spi_micros_per_conversion %.2f\n", telemetry.spiMicrosPerConversion);
+  stream->printf("mcp3561_spi_transactions_per_conversion %.2f\n", telemetry.spiTransactionsPerConversion);
+  stream->printf("mcp3561_spi_bytes_per_conversion %.2f\n", telemetry.spiBytesPerConversion);
+  stream->printf("mcp3561_latency_avg_micros %" PRIu32 "\n", telemetry.latencyAvgMicros);
+  stream->printf("mcp3561_latency_max_micros %" PRIu32 "\n", telemetry.latencyMaxMicros);
+  stream->printf("mcp3561_conversions_total %" PRIu32 "\n", telemetry.conversions);
+  stream->printf("mcp3561_timeouts_total %" PRIu32 "\n", telemetry.timeouts);
+  stream->printf("mcp3561_dropped_total %" PRIu32 "\n", telemetry.dropped);
+  stream->printf("mcp3561_coalesced_total %" PRIu32 "\n", telemetry.coalesced);
+  stream->printf("mcp3561_stream_overwritten_total %" PRIu32 "\n", telemetry.streamOverwritten);
+
+  uint32_t cumulative = 0;
+  for (uint8_t i=0; i<kLatencyBuckets - 1; i++) {
+    cumulative += telemetry.latencyHistogram[i];
+    stream->printf("mcp3561_latency_micros_bucket{le=\"%u\"} %" PRIu32 "\n", 16u << i, cumulative);
+  }
+  cumulative += telemetry.latencyHistogram[kLatencyBuckets - 1];
+  stream->printf("mcp3561_latency_micros_bucket{le=\"+Inf\"} %" PRIu32 "\n", cumulative);
+
+  for (auto *sensor : this->parent_->get_sensors()) {
+    stream->printf("mcp3561_sensor_conversion_rate{sensor=\"%s\"} %.2f\n", sensor->get_name().c_str(),
+                   sensor->get_achieved_rate());
+    stream->printf("mcp3561_sensor_coalesced_total{sensor=\"%s\"} %" PRIu32 "\n", sensor->get_name().c_str(),
+                   sensor->get_coalesced_requests());
+  }
+
+  req->send(stream);
+}
+
+}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_MCP3561_TELEMETRY_HANDLER
+
+#include <string>
+
+#include "esphome/components/web_server_base/web_server_base.h"
+#include "esphome/core/component.h"
+
+#include "mcp3561.h"
+
+using namespace esphome;
+namespace mcp3561 {
+
+// Serves the MCP3561 telemetry over HTTP GET, as Prometheus-style text lines of
+//   (metric name){(labels)} (value)
+// with the latency histogram as cumulative buckets and per-sensor rates labeled by sensor name
+class MCP3561TelemetryHandler : public Component, public AsyncWebHandler {
+ public:
+  MCP3561TelemetryHandler(MCP3561 *parent, web_server_base::WebServerBase *base, const std::string &path) :
+    parent_(parent), base_(base), path_(path) {}
+
+  bool canHandle(AsyncWebServerRequest *request) const override;
+
+  void handleRequest(AsyncWebServerRequest *req) override;
+
+  void setup() override {
+    this->base_->init();
+    this->base_->add_handler(this);
+  }
+  float get_setup_priority() const override {
+    // After WiFi
+    return setup_priority::WIFI - 1.0f;
+  }
+
+ protected:
+  MCP3561 *parent_;
+  web_server_base::WebServerBase *base_;
+  std::string path_;
+};
+
+}
+
+#endif
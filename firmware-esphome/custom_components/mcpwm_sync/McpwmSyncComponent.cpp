@@ -124,30 +124,38 @@ void McpwmSyncComponent::write_state(float state) {
     return;
   }
 
-  duty_ = state;
-  if (duty_ < 0) {
-    ESP_LOGE(TAG, "invalid duty: %f", duty_);
-    duty_ = 0;
-  } else if (duty_ > max_duty_) {
-    ESP_LOGE(TAG, "duty clamped to max: %f", duty_);
-    duty_ = max_duty_;
+  float duty = state;  // converted locally, then published to duty_ whole
+  if (duty < 0) {
+    ESP_LOGE(TAG, "invalid duty: %f", duty);
+    duty = 0;
+  } else if (duty > max_duty_) {
+    ESP_LOGE(TAG, "duty clamped to max: %f", duty);
+    duty = max_duty_;
   }
   if (inverted_) {
-    duty_ = 1.0f - duty_;
+    duty = 1.0f - duty;
   }
 
-  duty_ = duty_ * 100;  // format conversion for ESP API
-  if (duty_ > 0) {  // compensate for rising deadtime which is rolled into the high duty cycle
-    duty_ += deadtime_duty_comp_;
+  duty = duty * 100;  // format conversion for ESP API
+  if (duty > 0) {  // compensate for rising deadtime which is rolled into the high duty cycle
+    duty += deadtime_duty_comp_;
   }
-  if (duty_ > 100 - deadtime_duty_comp_) {  // ensure it keeps pulsing
-    duty_ = 100 - deadtime_duty_comp_;
+  if (duty > 100 - deadtime_duty_comp_) {  // ensure it keeps pulsing
+    duty = 100 - deadtime_duty_comp_;
   }
-  mcpwm_set_duty(mcpwmUnit_, MCPWM_TIMER_0, MCPWM_GEN_A, duty_);
+  duty_ = duty;
+  mcpwm_set_duty(mcpwmUnit_, MCPWM_TIMER_0, MCPWM_GEN_A, duty);
 }
 
 float McpwmSyncComponent::get_state() { return duty_; }
 
+void McpwmSyncComponent::disable_blanking() {
+  if (blank_time_ms_ > 0) {
+    ESP_LOGW(TAG, "blanking disabled, output is written from another task");
+  }
+  blank_time_ms_ = 0;
+}
+
 void McpwmSyncComponent::loop() {
   if (blank_time_ms_ > 0 && esphome::millis() >= nextBlankTime_) {
     mcpwm_set_duty(mcpwmUnit_, MCPWM_TIMER_0, MCPWM_GEN_A, 0);  // blank
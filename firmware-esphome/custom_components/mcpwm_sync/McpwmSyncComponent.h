@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include "esphome/core/component.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/automation.h"
@@ -13,6 +15,8 @@ namespace mcpwm_sync {
 
 using namespace esphome;
 
+// write_state may be called from another task (eg, the buckboost_control task), but blanking from loop() is not
+// synchronized with it, so outputs owned by another task must have blanking disabled (see disable_blanking)
 class McpwmSyncComponent : public output::FloatOutput, public Component {
 public:
   McpwmSyncComponent(InternalGPIOPin *pin,
@@ -26,6 +30,8 @@ public:
   void write_state(float state) override;
 
   float get_state();
+  // disables blanking, for outputs written from another task, which blanking from loop() would race
+  void disable_blanking();
 
   void loop() override;
 
@@ -41,7 +47,7 @@ public:
   bool initialized_ = false;
   adc::ADCSensor *sample_adc_ = nullptr;
   uint32_t blank_period_ms_, blank_time_ms_;
-  float duty_ = 0;
+  std::atomic<float> duty_{0};  // in ESP API percent, published whole so loop() never sees a partial conversion
 
   uint32_t nextBlankTime_ = 0;  // for blanking, in millis()
 
@@ -0,0 +1,144 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+import esphome.final_validate as fv
+from esphome.components import sensor, switch, text_sensor
+from esphome.const import (
+    CONF_ID,
+    CONF_MAX,
+    CONF_MIN,
+    CONF_SENSOR,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    UNIT_MICROSECOND,
+)
+
+from ..adc_calibration import AdcCalibration, CONF_RANGES
+from ..buckboost_control import BuckBoostControl
+
+DEPENDENCIES = ["esp32", "mcp3561"]
+AUTO_LOAD = ["sensor"]
+
+CONF_ERROR = "error"
+CONF_ENABLE = "enable"
+CONF_BUCKBOOST = "buckboost"
+CONF_SHUTDOWN = "shutdown"
+CONF_LIMITS = "limits"
+CONF_CALIBRATION = "calibration"
+CONF_MIN_REASON = "min_reason"
+CONF_MAX_REASON = "max_reason"
+CONF_SAMPLES = "samples"
+CONF_SENSOR_LIMITS = "sensor_limits"
+CONF_REASON = "reason"
+CONF_PWM_LATENCY = "pwm_latency"
+CONF_SHUTDOWN_LATENCY = "shutdown_latency"
+
+protection_ns = cg.esphome_ns.namespace("protection")
+Protection = protection_ns.class_("Protection", cg.Component)
+
+
+def validate_limit(config):
+    if CONF_MIN not in config and CONF_MAX not in config:
+        raise cv.Invalid(f"at least one of {CONF_MIN} or {CONF_MAX} required")
+    if CONF_MIN in config and CONF_MIN_REASON not in config:
+        raise cv.Invalid(f"{CONF_MIN_REASON} required with {CONF_MIN}")
+    if CONF_MAX in config and CONF_MAX_REASON not in config:
+        raise cv.Invalid(f"{CONF_MAX_REASON} required with {CONF_MAX}")
+    return config
+
+
+def latency_sensor_schema():
+    return sensor.sensor_schema(
+        unit_of_measurement=UNIT_MICROSECOND,
+        accuracy_decimals=0,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    )
+
+
+CONFIG_SCHEMA = cv.Schema(
+    {
+        cv.GenerateID(): cv.declare_id(Protection),
+        # set to the trip reason on a trip (unless there is already an error), cleared to reset
+        # setting any error elsewhere also trips
+        cv.Required(CONF_ERROR): cv.use_id(text_sensor.TextSensor),
+        # published off on a trip, and held off while tripped
+        cv.Required(CONF_ENABLE): cv.use_id(switch.Switch),
+        # turned off immediately on a trip, from the conversion readout
+        cv.Optional(CONF_BUCKBOOST): cv.use_id(BuckBoostControl),
+        # turned off from loop() on a trip, and held off while tripped
+        cv.Optional(CONF_SHUTDOWN, default=[]): cv.ensure_list(cv.use_id(switch.Switch)),
+        # limits on calibrated measurements, checked on each conversion as it is read out
+        cv.Optional(CONF_LIMITS, default=[]): cv.ensure_list(cv.All(
+            cv.Schema(
+                {
+                    cv.Required(CONF_CALIBRATION): cv.use_id(AdcCalibration),
+                    # in calibrated units, one value for all ranges or a list by calibration range, eg so each
+                    # range's limit is within the measurable swing of that range
+                    cv.Optional(CONF_MIN): cv.ensure_list(cv.float_),
+                    cv.Optional(CONF_MIN_REASON): cv.string_strict,
+                    cv.Optional(CONF_MAX): cv.ensure_list(cv.float_),
+                    cv.Optional(CONF_MAX_REASON): cv.string_strict,
+                    # consecutive conversions beyond a limit to trip, more than one where the range changes
+                    cv.Optional(CONF_SAMPLES, default=1): cv.int_range(min=1, max=255),
+                }
+            ),
+            validate_limit,
+        )),
+        # upper limits on slower sensors (eg temperatures), checked on each of their updates
+        cv.Optional(CONF_SENSOR_LIMITS, default=[]): cv.ensure_list(
+            cv.Schema(
+                {
+                    cv.Required(CONF_SENSOR): cv.use_id(sensor.Sensor),
+                    cv.Required(CONF_MAX): cv.float_,
+                    cv.Required(CONF_REASON): cv.string_strict,
+                }
+            )
+        ),
+        # optional trip latency sensors, from detection to the converter PWM off and to the complete shutdown,
+        # published on each trip
+        cv.Optional(CONF_PWM_LATENCY): latency_sensor_schema(),
+        cv.Optional(CONF_SHUTDOWN_LATENCY): latency_sensor_schema(),
+    }
+).extend(cv.COMPONENT_SCHEMA)
+
+
+def _final_validate(config):
+    full_config = fv.full_config.get()
+    for limit_conf in config[CONF_LIMITS]:
+        calibration_path = full_config.get_path_for_id(limit_conf[CONF_CALIBRATION])[:-1]
+        range_count = len(full_config.get_config_for_path(calibration_path)[CONF_RANGES])
+        for key in (CONF_MIN, CONF_MAX):
+            if len(limit_conf.get(key, [])) not in (0, 1, range_count):
+                raise cv.Invalid(f"{key} must be one value or one per calibration range ({range_count})")
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
+
+async def to_code(config):
+    error = await cg.get_variable(config[CONF_ERROR])
+    enable = await cg.get_variable(config[CONF_ENABLE])
+    var = cg.new_Pvariable(config[CONF_ID], error, enable)
+    await cg.register_component(var, config)
+
+    if CONF_BUCKBOOST in config:
+        buckboost = await cg.get_variable(config[CONF_BUCKBOOST])
+        cg.add(var.set_buckboost(buckboost))
+    for output_id in config[CONF_SHUTDOWN]:
+        output = await cg.get_variable(output_id)
+        cg.add(var.add_shutdown_switch(output))
+    for limit_conf in config[CONF_LIMITS]:
+        calibration = await cg.get_variable(limit_conf[CONF_CALIBRATION])
+        cg.add(var.add_conversion_limit(
+            calibration,
+            limit_conf.get(CONF_MIN, []), limit_conf.get(CONF_MIN_REASON, ""),
+            limit_conf.get(CONF_MAX, []), limit_conf.get(CONF_MAX_REASON, ""),
+            limit_conf[CONF_SAMPLES]))
+    for limit_conf in config[CONF_SENSOR_LIMITS]:
+        limit_sensor = await cg.get_variable(limit_conf[CONF_SENSOR])
+        cg.add(var.add_sensor_limit(limit_sensor, limit_conf[CONF_MAX], limit_conf[CONF_REASON]))
+
+    for key in (CONF_PWM_LATENCY, CONF_SHUTDOWN_LATENCY):
+        if sensor_config := config.get(key):
+            sens = await sensor.new_sensor(sensor_config)
+            cg.add(getattr(var, f"set_{key}_sensor")(sens))
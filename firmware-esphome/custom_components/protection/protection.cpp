@@ -0,0 +1,183 @@
+#include "protection.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "esp_timer.h"
+#include "esphome/core/log.h"
+
+using namespace esphome;
+namespace protection {
+
+static const char *const TAG = "protection";
+
+// thresholds are clamped well beyond the ADC count range, so the float conversion can't overflow
+static const float kMaxThresholdCounts = 1 << 30;
+static const int32_t kFullScaleCounts = 1 << 23;
+
+// limit value in a calibration range, or NaN if none
+static float limit_value(const std::vector<float> &values, size_t range) {
+  if (values.empty()) {
+    return NAN;
+  }
+  return values.size() == 1 ? values[0] : values[range];
+}
+
+void Protection::setup() {
+  for (auto &limit : this->conversionLimits_) {
+    limit.thresholds.reset(new CountThresholds[limit.calibration->range_count()]);
+  }
+  this->update_thresholds();
+  for (auto &limit : this->conversionLimits_) {
+    for (size_t range = 0; range < limit.calibration->range_count(); range++) {
+      const CountThresholds &thresholds = limit.thresholds[range];
+      if ((thresholds.min != INT32_MIN && thresholds.min < -kFullScaleCounts) ||
+          (thresholds.max != INT32_MAX && thresholds.max > kFullScaleCounts)) {
+        ESP_LOGW(TAG, "%s: limit beyond the ADC full scale in range %u, can't trip",
+                 limit.calibration->get_name().c_str(), range);
+      }
+    }
+  }
+
+  for (auto &limit : this->sensorLimits_) {
+    SensorLimit *limitPtr = &limit;
+    limit.sensor->add_on_state_callback([this, limitPtr](float state) {
+      if (state > limitPtr->max) {
+        this->trip(limitPtr->reason);
+      }
+    });
+  }
+  this->error_->add_on_state_callback([this](const std::string &state) {
+    if (state.empty()) {  // error cleared
+      this->tripped_ = false;
+    } else if (!this->tripped_) {  // an error set elsewhere (eg, DAC separation) shuts down the same as a limit
+      this->trip("Error");
+    }
+  });
+
+  std::vector<mcp3561::MCP3561 *> parents;
+  for (auto &limit : this->conversionLimits_) {
+    mcp3561::MCP3561 *parent = limit.calibration->get_sensor()->get_parent();
+    if (std::find(parents.begin(), parents.end(), parent) == parents.end()) {
+      parents.push_back(parent);
+      parent->add_result_hook([this](const mcp3561::Sample &sample) { this->on_conversion(sample); });
+    }
+  }
+}
+
+void Protection::dump_config() {
+  ESP_LOGCONFIG(TAG, "Protection:");
+  for (auto &limit : this->conversionLimits_) {
+    ESP_LOGCONFIG(TAG, "  %s: %u samples", limit.calibration->get_name().c_str(), limit.samples);
+    for (size_t range = 0; range < limit.calibration->range_count(); range++) {
+      ESP_LOGCONFIG(TAG, "    range %u: min %.4f (%s), max %.4f (%s)", range, limit_value(limit.min, range),
+                    limit.minReason, limit_value(limit.max, range), limit.maxReason);
+    }
+  }
+  for (auto &limit : this->sensorLimits_) {
+    ESP_LOGCONFIG(TAG, "  %s: max %.1f (%s)", limit.sensor->get_name().c_str(), limit.max, limit.reason);
+  }
+}
+
+// returns the ADC count threshold of a limit value in a calibration range, or fallback if unset or uncalibrated
+// measured values are uncorrected by the set-point table, so this is the measurement inverse
+static int32_t threshold_counts(adc_calibration::AdcCalibration *calibration, size_t range, float value,
+                                int32_t fallback) {
+  float counts = calibration->meas_value_to_ratio(value, range) * adc_calibration::kCountsPerRatio;
+  if (std::isnan(counts)) {
+    return fallback;
+  }
+  return std::min(std::max(counts, -kMaxThresholdCounts), kMaxThresholdCounts);
+}
+
+void Protection::update_thresholds() {
+  for (auto &limit : this->conversionLimits_) {
+    for (size_t range = 0; range < limit.calibration->range_count(); range++) {
+      CountThresholds &thresholds = limit.thresholds[range];
+      thresholds.min = threshold_counts(limit.calibration, range, limit_value(limit.min, range), INT32_MIN);
+      thresholds.max = threshold_counts(limit.calibration, range, limit_value(limit.max, range), INT32_MAX);
+    }
+  }
+}
+
+void Protection::on_conversion(const mcp3561::Sample &sample) {
+  for (auto &limit : this->conversionLimits_) {
+    if (limit.calibration->get_sensor() != sample.sensor) {
+      continue;
+    }
+    // the range recorded with this conversion at readout
+    int8_t range = sample.range;
+    int32_t counts = sample.value;
+    if (range < 0 || (size_t) range >= limit.calibration->range_count() || this->tripped_) {
+      // no measurement, or already shut down
+      limit.belowCount = 0;
+      limit.aboveCount = 0;
+      continue;
+    }
+    const CountThresholds &thresholds = limit.thresholds[range];
+    limit.belowCount = counts < thresholds.min ? std::min(limit.belowCount + 1, 255) : 0;
+    limit.aboveCount = counts > thresholds.max ? std::min(limit.aboveCount + 1, 255) : 0;
+    if (limit.belowCount >= limit.samples) {
+      this->trip(limit.minReason);
+    } else if (limit.aboveCount >= limit.samples) {
+      this->trip(limit.maxReason);
+    }
+  }
+}
+
+void Protection::trip(const char *reason) {
+  int64_t detectMicros = esp_timer_get_time();
+  if (this->tripped_.exchange(true)) {
+    return;
+  }
+  if (this->buckboost_ != nullptr) {
+    this->buckboost_->turn_off();
+  }
+  this->tripPwmOffMicros_ = esp_timer_get_time();
+  this->tripDetectMicros_ = detectMicros;
+  this->tripReason_ = reason;
+  this->tripPending_ = true;
+}
+
+void Protection::loop() {
+  this->update_thresholds();  // inexpensive, and picks up calibration changes
+
+  if (this->tripPending_.exchange(false)) {
+    for (auto output : this->shutdownSwitches_) {
+      output->turn_off();
+    }
+    int64_t shutdownMicros = esp_timer_get_time();
+    this->enable_->publish_state(false);
+    if (this->error_->state.empty()) {  // don't replace an existing error
+      this->error_->publish_state(this->tripReason_);
+    }
+
+    this->tripCount_++;
+    uint32_t pwmLatencyMicros = this->tripPwmOffMicros_ - this->tripDetectMicros_;
+    uint32_t shutdownLatencyMicros = shutdownMicros - this->tripDetectMicros_;
+    ESP_LOGW(TAG, "trip %u: %s, PWM off in %u us, shutdown in %u us", this->tripCount_, this->error_->state.c_str(),
+             pwmLatencyMicros, shutdownLatencyMicros);
+    if (this->pwmLatencySensor_ != nullptr) {
+      this->pwmLatencySensor_->publish_state(pwmLatencyMicros);
+    }
+    if (this->shutdownLatencySensor_ != nullptr) {
+      this->shutdownLatencySensor_->publish_state(shutdownLatencyMicros);
+    }
+  }
+
+  if (this->tripped_) {  // hold off until the error is cleared
+    if (this->buckboost_ != nullptr) {
+      this->buckboost_->turn_off();
+    }
+    if (this->enable_->state) {
+      this->enable_->publish_state(false);
+    }
+    for (auto output : this->shutdownSwitches_) {
+      if (output->state) {
+        output->turn_off();
+      }
+    }
+  }
+}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "esphome/core/component.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/switch/switch.h"
+#include "esphome/components/text_sensor/text_sensor.h"
+
+#include "../adc_calibration/adc_calibration.h"
+#include "../buckboost_control/buckboost_control.h"
+
+using namespace esphome;
+namespace protection {
+
+// ADC count thresholds of a limit in one calibration range, written from loop() and read from the result hook
+struct CountThresholds {
+  std::atomic<int32_t> min{INT32_MIN};  // trips below, never by default
+  std::atomic<int32_t> max{INT32_MAX};  // trips above, never by default
+};
+
+// limit on a calibrated MCP3561 measurement, checked on the ADC counts of each conversion
+// values are by calibration range, or a single value for all ranges, and empty if none
+struct ConversionLimit {
+  adc_calibration::AdcCalibration *calibration;
+  std::vector<float> min;
+  const char *minReason;
+  std::vector<float> max;
+  const char *maxReason;
+  uint8_t samples;  // consecutive conversions beyond a limit to trip
+  std::unique_ptr<CountThresholds[]> thresholds;  // by calibration range
+
+  // consecutive conversions beyond each limit, from the result hook
+  uint8_t belowCount = 0;
+  uint8_t aboveCount = 0;
+};
+
+// limit on a slow sensor, eg a temperature, checked on each of its updates
+struct SensorLimit {
+  sensor::Sensor *sensor;
+  float max;
+  const char *reason;
+};
+
+// Fault protection, evaluating measurement limits on the ADC counts of each conversion as it is read out by the
+// MCP3561 (from its conversion task in IRQ mode), instead of on the published values in the main loop
+// Limit values are converted to ADC count thresholds of each calibration range in loop() with the linear
+// measurement calibration (not the set-point table, which corrects DAC targets), so the per-conversion
+// check is integer compares against the range recorded with the conversion at readout - where ranges change,
+// samples should be more than one, so a conversion started before the change can't trip against the new range
+// On a trip, the buck-boost converter PWM is turned off immediately from the detecting context, and the rest of
+// the shutdown (output switches on the I2C IO expander, error and enable state) is done from the next loop()
+// Any other error being set (eg, from a script) also trips, and the outputs are held off until the error is cleared
+class Protection : public Component {
+ public:
+  Protection(text_sensor::TextSensor *error, switch_::Switch *enable) : error_(error), enable_(enable) {}
+
+  void set_buckboost(buckboost_control::BuckBoostControl *buckboost) { this->buckboost_ = buckboost; }
+  // turned off (if on) on a trip, and held off while tripped
+  void add_shutdown_switch(switch_::Switch *output) { this->shutdownSwitches_.push_back(output); }
+  // min and max are by calibration range (eg, a fraction of each range's full scale), or a single value for all
+  // ranges, or empty if unused, limits must be on calibrations with positive gain
+  void add_conversion_limit(adc_calibration::AdcCalibration *calibration, std::vector<float> min,
+                            const char *minReason, std::vector<float> max, const char *maxReason, uint8_t samples) {
+    this->conversionLimits_.push_back(
+        {calibration, std::move(min), minReason, std::move(max), maxReason, samples, nullptr});
+  }
+  void add_sensor_limit(sensor::Sensor *sensor, float max, const char *reason) {
+    this->sensorLimits_.push_back({sensor, max, reason});
+  }
+
+  // optional sensors, published on each trip
+  void set_pwm_latency_sensor(sensor::Sensor *sensor) { this->pwmLatencySensor_ = sensor; }
+  void set_shutdown_latency_sensor(sensor::Sensor *sensor) { this->shutdownLatencySensor_ = sensor; }
+
+  void setup() override;
+  void loop() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::DATA; }
+
+  // trips protection with reason as the error, if not already tripped, turning off the converter immediately
+  // thread-safe, reason must be a static string
+  void trip(const char *reason);
+  bool is_tripped() const { return this->tripped_; }
+
+ protected:
+  void on_conversion(const mcp3561::Sample &sample);  // from the MCP3561 result hook
+  void update_thresholds();
+
+  text_sensor::TextSensor *error_;
+  switch_::Switch *enable_;
+  buckboost_control::BuckBoostControl *buckboost_ = nullptr;
+  std::vector<switch_::Switch *> shutdownSwitches_;
+  std::vector<ConversionLimit> conversionLimits_;
+  std::vector<SensorLimit> sensorLimits_;
+
+  std::atomic<bool> tripped_{false};  // set on a trip, cleared with the error
+  // trip details, written by trip() before tripPending_ is set, and read in loop() after it is cleared
+  std::atomic<bool> tripPending_{false};
+  const char *tripReason_ = nullptr;
+  int64_t tripDetectMicros_ = 0;  // esp_timer_get_time()
+  int64_t tripPwmOffMicros_ = 0;
+  uint32_t tripCount_ = 0;
+
+  sensor::Sensor *pwmLatencySensor_ = nullptr;
+  sensor::Sensor *shutdownLatencySensor_ = nullptr;
+};
+
+}
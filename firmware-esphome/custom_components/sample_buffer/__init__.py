@@ -4,34 +4,227 @@ from esphome.const import (
     CONF_ID,
     CONF_NAME,
     CONF_SOURCE,
+    CONF_STATE,
+    CONF_ABOVE,
+    CONF_BELOW,
+    CONF_BINARY_SENSOR,
+    CONF_TEXT_SENSOR,
+    CONF_VOLTAGE,
+    CONF_CURRENT,
+    CONF_POWER,
+    CONF_ACCURACY_DECIMALS,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    UNIT_MILLISECOND,
 )
 from esphome.components.web_server_base import CONF_WEB_SERVER_BASE_ID
-from esphome.components import web_server_base, sensor
+from esphome.components import web_server_base, sensor, binary_sensor, text_sensor
 from esphome.cpp_types import EntityBase
 
 CONF_SOURCES = "sources"
+CONF_PAIRS = "pairs"
+CONF_MAX_SKEW = "max_skew"
+CONF_TIMESTAMP = "timestamp"
+CONF_CONVERSIONS = "conversions"
+CONF_CONVERSIONS = "conversions"
+CONF_BUFFER_SIZE = "buffer_size"
+CONF_PSRAM = "psram"
+CONF_STREAM_PORT = "stream_port"
+CONF_CAPTURE = "capture"
+CONF_PRE_SAMPLES = "pre_samples"
+CONF_POST_SAMPLES = "post_samples"
+CONF_TRIGGERS = "triggers"
+CONF_AGGREGATE = "aggregate"
+CONF_FLASH_LOG = "flash_log"
+CONF_PARTITION = "partition"
+CONF_FLUSH_INTERVAL = "flush_interval"
+CONF_WRITE_RATE = "write_rate"
+CONF_STALL_TIME = "stall_time"
 
-AUTO_LOAD = ["web_server_base"]
+UNIT_BYTES_PER_SECOND = "B/s"
+
+# aggregate tiers by option name, in number of periods, and the period in seconds
+AGGREGATE_TIERS = {
+    "seconds": 1,
+    "minutes": 60,
+    "hours": 3600,
+}
+
+kBlockRecords = 64  # records per timestamp keyframe, see sample_buffer.h
+kMaxSources = 255  # source index 0xff is reserved for escape records and stream gap markers
+
+
+def validate_buffer_size(value):
+    value = cv.int_range(min=kBlockRecords)(value)
+    if value & (value - 1) != 0:  # so records stay contiguous when the sample index wraps
+        raise cv.Invalid("buffer_size must be a power of two")
+    return value
+
+AUTO_LOAD = ["web_server_base", "socket"]
 
 sample_buffer_ns = cg.esphome_ns.namespace("sample_buffer")
 SampleBuffer = sample_buffer_ns.class_("SampleBuffer", cg.Component)
 
-SOURCE_SCHEMA = cv.Schema(
+
+def validate_source(config):
+    if config[CONF_CONVERSIONS] and CONF_TIMESTAMP in config:
+        raise cv.Invalid("conversions are timestamped at acquisition, timestamp is not used")
+    return config
+
+
+SOURCE_SCHEMA = cv.All(cv.Schema(
     {
         cv.Required(CONF_SOURCE): cv.use_id(sensor.Sensor),
         cv.Required(CONF_NAME): cv.string_strict,
+        # optional lambda returning the sample acquisition time in esp_timer_get_time() micros,
+        # otherwise samples are timestamped when the source publishes
+        cv.Optional(CONF_TIMESTAMP): cv.returning_lambda,
+        # records every conversion of an mcp3561 sensor, timestamped at acquisition, instead of its published
+        # values, which may be decimated (see its publish_interval)
+        cv.Optional(CONF_CONVERSIONS, default=False): cv.boolean,
+    },
+), validate_source)
+
+def validate_pair(config):
+    if config[CONF_VOLTAGE][CONF_CONVERSIONS] != config[CONF_CURRENT][CONF_CONVERSIONS]:
+        raise cv.Invalid("voltage and current must both record conversions, or neither")
+    return config
+
+
+# voltage and current sources recorded together with one timestamp, along with their power, see SamplePair
+PAIR_SCHEMA = cv.All(cv.Schema(
+    {
+        cv.Required(CONF_VOLTAGE): SOURCE_SCHEMA,
+        cv.Required(CONF_CURRENT): SOURCE_SCHEMA,
+        cv.Required(CONF_POWER): cv.Schema(
+            {
+                cv.Required(CONF_NAME): cv.string_strict,
+                cv.Optional(CONF_ACCURACY_DECIMALS, default=6): cv.int_range(min=-128, max=127),
+            },
+        ),
+        # voltage and current samples further apart than this are recorded unpaired
+        cv.Optional(CONF_MAX_SKEW, default="50ms"): cv.positive_time_period_microseconds,
+    },
+), validate_pair)
+
+
+def source_names(config):
+    """Returns the source names in source index order, sources then pairs."""
+    names = [source_conf[CONF_NAME] for source_conf in config[CONF_SOURCES]]
+    for pair_conf in config[CONF_PAIRS]:
+        names += [pair_conf[key][CONF_NAME] for key in [CONF_VOLTAGE, CONF_CURRENT, CONF_POWER]]
+    return names
+
+
+def validate_sources(config):
+    names = source_names(config)
+    if len(names) > kMaxSources:
+        raise cv.Invalid(f"at most {kMaxSources} sources, including 3 per pair")
+    if len(set(names)) != len(names):
+        raise cv.Invalid("source names must be unique")
+    return config
+
+
+CAPTURE_TRIGGER_SCHEMA = cv.Any(
+    # a source (by name) crossing a level
+    cv.Schema(
+        {
+            cv.Required(CONF_SOURCE): cv.string_strict,
+            cv.Exclusive(CONF_ABOVE, "level"): cv.float_,
+            cv.Exclusive(CONF_BELOW, "level"): cv.float_,
+        },
+    ),
+    # a binary sensor changing to state, or any change if state is not set
+    cv.Schema(
+        {
+            cv.Required(CONF_BINARY_SENSOR): cv.use_id(binary_sensor.BinarySensor),
+            cv.Optional(CONF_STATE): cv.boolean,
+        },
+    ),
+    # a text sensor changing to a non-empty state, eg an error
+    cv.Schema(
+        {
+            cv.Required(CONF_TEXT_SENSOR): cv.use_id(text_sensor.TextSensor),
+        },
+    ),
+)
+
+CAPTURE_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_PRE_SAMPLES, default=256): cv.int_range(min=0),
+        cv.Optional(CONF_POST_SAMPLES, default=256): cv.int_range(min=0),
+        cv.Optional(CONF_TRIGGERS, default=[]): cv.ensure_list(CAPTURE_TRIGGER_SCHEMA),
     },
 )
 
-CONFIG_SCHEMA = cv.Schema(
+
+def validate_capture(config):
+    if CONF_CAPTURE not in config:
+        return config
+    names = source_names(config)
+    for trigger_conf in config[CONF_CAPTURE][CONF_TRIGGERS]:
+        if CONF_SOURCE in trigger_conf:
+            if trigger_conf[CONF_SOURCE] not in names:
+                raise cv.Invalid(f"capture trigger source {trigger_conf[CONF_SOURCE]} is not a sample buffer source")
+            if CONF_ABOVE not in trigger_conf and CONF_BELOW not in trigger_conf:
+                raise cv.Invalid("capture trigger on a source requires above or below")
+    if config[CONF_CAPTURE][CONF_PRE_SAMPLES] > config[CONF_BUFFER_SIZE]:
+        raise cv.Invalid("capture pre_samples must not exceed buffer_size")
+    return config
+
+
+# each period takes 16 bytes per source, a tier can be disabled with 0
+AGGREGATE_SCHEMA = cv.Schema(
+    {
+        cv.Optional("seconds", default=300): cv.int_range(min=0),
+        cv.Optional("minutes", default=240): cv.int_range(min=0),
+        cv.Optional("hours", default=48): cv.int_range(min=0),
+    },
+)
+
+# requires a data partition with the label in the partition table
+FLASH_LOG_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_PARTITION, default="samplelog"): cv.string_strict,
+        cv.Optional(CONF_FLUSH_INTERVAL, default="10s"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_WRITE_RATE): sensor.sensor_schema(
+            unit_of_measurement=UNIT_BYTES_PER_SECOND,
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional(CONF_STALL_TIME): sensor.sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            accuracy_decimals=1,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+    },
+)
+
+
+CONFIG_SCHEMA = cv.All(cv.Schema(
     {
         cv.GenerateID(): cv.declare_id(SampleBuffer),
         cv.GenerateID(CONF_WEB_SERVER_BASE_ID): cv.use_id(
             web_server_base.WebServerBase
         ),
         cv.Required(CONF_SOURCES): cv.ensure_list(SOURCE_SCHEMA),
+        cv.Optional(CONF_PAIRS, default=[]): cv.ensure_list(PAIR_SCHEMA),
+        # in 8-byte records, including escape records for gaps over about 8s
+        cv.Optional(CONF_BUFFER_SIZE, default=4096): validate_buffer_size,
+        # allocates the buffer in PSRAM, if available (otherwise falls back to internal RAM)
+        cv.Optional(CONF_PSRAM, default=False): cv.boolean,
+        # TCP port to push new samples to streaming clients on, see sample_buffer.h
+        cv.Optional(CONF_STREAM_PORT): cv.port,
+        # freezes samples around a trigger into a separate buffer, see sample_buffer.h
+        cv.Optional(CONF_CAPTURE): CAPTURE_SCHEMA,
+        # per-period min, max and mean of each source, see sample_buffer.h
+        cv.Optional(CONF_AGGREGATE): AGGREGATE_SCHEMA,
+        # persists samples to flash, see sample_buffer.h
+        cv.Optional(CONF_FLASH_LOG): cv.All(cv.only_on_esp32, FLASH_LOG_SCHEMA),
     },
-).extend(cv.COMPONENT_SCHEMA)
+).extend(cv.COMPONENT_SCHEMA), validate_sources, validate_capture)
 
 
 async def to_code(config):
@@ -39,6 +232,9 @@ async def to_code(config):
 
     var = cg.new_Pvariable(config[CONF_ID], paren)
     await cg.register_component(var, config)
+    cg.add(var.set_buffer_size(config[CONF_BUFFER_SIZE], config[CONF_PSRAM]))
+    if CONF_STREAM_PORT in config:
+        cg.add(var.set_stream_port(config[CONF_STREAM_PORT]))
 
     for source_conf in config[CONF_SOURCES]:
         source = await cg.get_variable(source_conf[CONF_SOURCE])
@@ -47,4 +243,66 @@ async def to_code(config):
             [(str, "x")],
             cg.float_,
         )
-        cg.add(var.add_source(source, name))
+        if source_conf[CONF_CONVERSIONS]:
+            cg.add(var.add_conversion_source(source, name))
+        elif CONF_TIMESTAMP in source_conf:
+            timestamp = await cg.process_lambda(source_conf[CONF_TIMESTAMP], [], return_type=cg.int64)
+            cg.add(var.add_source(source, name, timestamp))
+        else:
+            cg.add(var.add_source(source, name))
+
+    for pair_conf in config[CONF_PAIRS]:
+        if pair_conf[CONF_VOLTAGE][CONF_CONVERSIONS]:
+            voltage = await cg.get_variable(pair_conf[CONF_VOLTAGE][CONF_SOURCE])
+            current = await cg.get_variable(pair_conf[CONF_CURRENT][CONF_SOURCE])
+            cg.add(var.add_conversion_pair(voltage, pair_conf[CONF_VOLTAGE][CONF_NAME], current,
+                                           pair_conf[CONF_CURRENT][CONF_NAME], pair_conf[CONF_POWER][CONF_NAME],
+                                           pair_conf[CONF_POWER][CONF_ACCURACY_DECIMALS], pair_conf[CONF_MAX_SKEW]))
+            continue
+        pair_args = []
+        for source_conf in [pair_conf[CONF_VOLTAGE], pair_conf[CONF_CURRENT]]:
+            pair_args.append(await cg.get_variable(source_conf[CONF_SOURCE]))
+            pair_args.append(source_conf[CONF_NAME])
+            if CONF_TIMESTAMP in source_conf:
+                pair_args.append(await cg.process_lambda(source_conf[CONF_TIMESTAMP], [], return_type=cg.int64))
+            else:
+                pair_args.append(cg.RawExpression("nullptr"))
+        cg.add(var.add_pair(*pair_args, pair_conf[CONF_POWER][CONF_NAME], pair_conf[CONF_POWER][CONF_ACCURACY_DECIMALS],
+                            pair_conf[CONF_MAX_SKEW]))
+
+    if CONF_AGGREGATE in config:
+        for tier_name, period_seconds in AGGREGATE_TIERS.items():
+            if config[CONF_AGGREGATE][tier_name] > 0:
+                cg.add(var.add_aggregate_tier(period_seconds, config[CONF_AGGREGATE][tier_name]))
+
+    if CONF_FLASH_LOG in config:
+        flash_log_conf = config[CONF_FLASH_LOG]
+        cg.add_define("USE_SAMPLE_BUFFER_FLASH_LOG")
+        cg.add(var.set_flash_log(flash_log_conf[CONF_PARTITION], flash_log_conf[CONF_FLUSH_INTERVAL]))
+        if CONF_WRITE_RATE in flash_log_conf:
+            sens = await sensor.new_sensor(flash_log_conf[CONF_WRITE_RATE])
+            cg.add(var.set_flash_write_rate_sensor(sens))
+        if CONF_STALL_TIME in flash_log_conf:
+            sens = await sensor.new_sensor(flash_log_conf[CONF_STALL_TIME])
+            cg.add(var.set_flash_stall_sensor(sens))
+
+    if CONF_CAPTURE in config:
+        capture_conf = config[CONF_CAPTURE]
+        cg.add(var.set_capture(capture_conf[CONF_PRE_SAMPLES], capture_conf[CONF_POST_SAMPLES]))
+        names = source_names(config)
+        for trigger_conf in capture_conf[CONF_TRIGGERS]:
+            if CONF_SOURCE in trigger_conf:
+                source_index = names.index(trigger_conf[CONF_SOURCE])
+                if CONF_ABOVE in trigger_conf:
+                    cg.add(var.add_level_trigger(source_index, trigger_conf[CONF_ABOVE], True))
+                else:
+                    cg.add(var.add_level_trigger(source_index, trigger_conf[CONF_BELOW], False))
+            elif CONF_BINARY_SENSOR in trigger_conf:
+                trigger_sensor = await cg.get_variable(trigger_conf[CONF_BINARY_SENSOR])
+                if CONF_STATE in trigger_conf:
+                    cg.add(var.add_binary_sensor_trigger(trigger_sensor, trigger_conf[CONF_STATE]))
+                else:
+                    cg.add(var.add_binary_sensor_trigger(trigger_sensor))
+            else:
+                trigger_sensor = await cg.get_variable(trigger_conf[CONF_TEXT_SENSOR])
+                cg.add(var.add_text_sensor_trigger(trigger_sensor))
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sample_buffer {
+
+// summary of a source's finite samples over one period, with NaN statistics if there were none
+struct AggregateBin {
+  float min = NAN;
+  float max = NAN;
+  float mean = NAN;
+  uint32_t count = 0;
+};
+
+// Fixed-period summaries (min, max, mean) of each source, over the latest bins periods
+// Updated incrementally as each sample arrives, periods are closed (including empty periods, so there are no
+// gaps) when a sample of a later period arrives
+// Periods are indexed by timestamp micros / period micros, so are aligned across tiers
+// Non-finite samples (eg, NaN while the output is off or changing range) advance time but are not summarized
+class AggregateTier {
+ public:
+  AggregateTier(uint32_t periodSeconds, uint32_t bins) : periodSeconds_(periodSeconds), binCount_(bins) {}
+
+  void init(size_t sources) {
+    this->sources_ = sources;
+    this->bins_.assign(this->binCount_ * sources, AggregateBin());
+    this->open_.assign(sources, Accumulator());
+  }
+
+  void add(uint8_t sourceIndex, int64_t micros, float value) {
+    int64_t period = micros / ((int64_t)this->periodSeconds_ * 1000000);
+    if (this->openPeriod_ < 0) {  // first sample
+      this->firstPeriod_ = period;
+      this->openPeriod_ = period;
+    } else if (period > this->openPeriod_) {
+      close(period);
+    }
+
+    if (!std::isfinite(value)) {
+      return;
+    }
+    if (period == this->openPeriod_) {
+      this->open_[sourceIndex].add(value);
+    } else if (period >= oldest_period()) {  // late sample, eg from a delayed timestamp, merged into its bin
+      AggregateBin &bin = bin_(period, sourceIndex);
+      if (bin.count == 0) {
+        bin.min = bin.max = bin.mean = value;
+      } else {
+        bin.min = std::min(bin.min, value);
+        bin.max = std::max(bin.max, value);
+        bin.mean += (value - bin.mean) / (bin.count + 1);
+      }
+      bin.count++;
+    }
+  }
+
+  uint32_t period_seconds() const { return this->periodSeconds_; }
+  // the oldest closed period still held, or open_period() if none
+  int64_t oldest_period() const {
+    return std::max(this->firstPeriod_, this->openPeriod_ - (int64_t)this->binCount_);
+  }
+  // the period currently accumulating, one past the latest closed period
+  int64_t open_period() const { return this->openPeriod_; }
+  // closed period between oldest_period() and open_period()
+  const AggregateBin &bin(int64_t period, size_t sourceIndex) const {
+    return this->bins_[(period % this->binCount_) * this->sources_ + sourceIndex];
+  }
+
+ protected:
+  struct Accumulator {
+    float min = NAN;
+    float max = NAN;
+    double sum = 0;  // double, since an hour may have hundreds of thousands of samples
+    uint32_t count = 0;
+
+    void add(float value) {
+      if (this->count == 0) {
+        this->min = this->max = value;
+      } else {
+        this->min = std::min(this->min, value);
+        this->max = std::max(this->max, value);
+      }
+      this->sum += value;
+      this->count++;
+    }
+  };
+
+  AggregateBin &bin_(int64_t period, size_t sourceIndex) {
+    return this->bins_[(period % this->binCount_) * this->sources_ + sourceIndex];
+  }
+
+  // stores the open period and any empty periods up to period, which becomes the open period
+  void close(int64_t period) {
+    for (int64_t closing = std::max(this->openPeriod_, period - (int64_t)this->binCount_); closing < period;
+         closing++) {
+      for (size_t sourceIndex = 0; sourceIndex < this->sources_; sourceIndex++) {
+        AggregateBin &bin = bin_(closing, sourceIndex);
+        bin = AggregateBin();
+        if (closing == this->openPeriod_) {
+          const Accumulator &open = this->open_[sourceIndex];
+          if (open.count > 0) {
+            bin.min = open.min;
+            bin.max = open.max;
+            bin.mean = open.sum / open.count;
+            bin.count = open.count;
+          }
+        }
+      }
+    }
+    this->open_.assign(this->sources_, Accumulator());
+    this->openPeriod_ = period;
+  }
+
+  uint32_t periodSeconds_;
+  uint32_t binCount_;
+  size_t sources_ = 0;
+  std::vector<AggregateBin> bins_;  // indexed by period modulo binCount_, then source
+  std::vector<Accumulator> open_;  // by source
+  int64_t firstPeriod_ = 0;
+  int64_t openPeriod_ = -1;  // none until the first sample
+};
+
+}
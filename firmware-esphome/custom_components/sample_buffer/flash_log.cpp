@@ -0,0 +1,136 @@
+#include "flash_log.h"
+
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+
+#include "esp_timer.h"
+
+#include "esphome/core/log.h"
+
+using namespace esphome;
+namespace sample_buffer {
+
+static const char *const TAG = "sample_buffer.flash_log";
+
+struct __attribute__((packed)) FlashSectorHeader {
+  uint32_t magic;
+  uint32_t sequence;
+  uint16_t boot;
+};
+
+bool FlashLog::begin(const std::string &partitionLabel, const std::string &sources) {
+  this->partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                              partitionLabel.c_str());
+  if (this->partition_ == nullptr) {
+    ESP_LOGE(TAG, "partition %s not found", partitionLabel.c_str());
+    return false;
+  }
+  this->sectorCount_ = this->partition_->size / kFlashSectorSize;
+  if (this->sectorCount_ < 2) {
+    ESP_LOGE(TAG, "partition %s too small", partitionLabel.c_str());
+    return false;
+  }
+  this->sources_ = sources;
+
+  // continue after the latest sector (highest sequence number), with the next boot number
+  bool found = false;
+  uint32_t latestSequence = 0;
+  uint16_t latestBoot = 0;
+  for (size_t sector = 0; sector < this->sectorCount_; sector++) {
+    FlashSectorHeader header;
+    if (esp_partition_read(this->partition_, sector * kFlashSectorSize, &header, sizeof(header)) != ESP_OK ||
+        header.magic != kFlashLogMagic) {
+      continue;
+    }
+    if (!found || header.sequence > latestSequence) {
+      latestSequence = header.sequence;
+      this->sector_ = (sector + 1) % this->sectorCount_;
+      this->sequence_ = header.sequence + 1;
+    }
+    if (!found || header.boot > latestBoot) {
+      latestBoot = header.boot;
+      this->boot_ = header.boot + 1;
+    }
+    found = true;
+  }
+  ESP_LOGI(TAG, "%u sectors, continuing at sector %u sequence %u boot %u", this->sectorCount_, this->sector_,
+           this->sequence_, this->boot_);
+
+  this->start_sector();
+  return true;
+}
+
+void FlashLog::start_sector() {
+  FlashSectorHeader header = {kFlashLogMagic, this->sequence_, this->boot_};
+  this->buffer_.reserve(kFlashSectorSize);
+  this->buffer_.assign(reinterpret_cast<const char *>(&header), sizeof(header));
+  this->buffer_.append(this->sources_);
+  this->flushed_ = 0;
+  this->eraseNeeded_ = true;
+  this->sectorFull_ = false;
+}
+
+bool FlashLog::append_block(const std::string &block) {
+  if (this->sectorFull_ || this->buffer_.size() + block.size() > kFlashSectorSize) {
+    this->sectorFull_ = true;
+    return false;
+  }
+  this->buffer_.append(block);
+  return true;
+}
+
+uint32_t FlashLog::loop() {
+  if (this->partition_ == nullptr) {
+    return 0;
+  }
+  int64_t startMicros = esp_timer_get_time();
+  if (this->eraseNeeded_) {
+    esp_err_t err = esp_partition_erase_range(this->partition_, this->sector_ * kFlashSectorSize, kFlashSectorSize);
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "erase of sector %u failed: %s", this->sector_, esp_err_to_name(err));
+    }
+    this->eraseNeeded_ = false;
+    return esp_timer_get_time() - startMicros;
+  }
+
+  // batches writes until they complete the current page, unless flushing
+  // writes whole blocks only, so readers don't see partially written blocks
+  size_t pending = this->buffer_.size() - this->flushed_;
+  size_t toPageEnd = kFlashPageSize - this->flushed_ % kFlashPageSize;
+  if (pending >= toPageEnd || (pending > 0 && (this->flushRequested_ || this->sectorFull_))) {
+    esp_err_t err = esp_partition_write(this->partition_, this->sector_ * kFlashSectorSize + this->flushed_,
+                                        this->buffer_.data() + this->flushed_, pending);
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "write to sector %u failed: %s", this->sector_, esp_err_to_name(err));
+    }
+    this->flushed_ += pending;
+    this->bytesWritten_ += pending;
+    return esp_timer_get_time() - startMicros;
+  }
+
+  if (pending == 0) {
+    this->flushRequested_ = false;
+    if (this->sectorFull_) {
+      this->sector_ = (this->sector_ + 1) % this->sectorCount_;
+      this->sequence_++;
+      this->start_sector();
+    }
+  }
+  return 0;
+}
+
+int64_t FlashLog::read_sequence(size_t sector) const {
+  FlashSectorHeader header;
+  if (esp_partition_read(this->partition_, sector * kFlashSectorSize, &header, sizeof(header)) != ESP_OK ||
+      header.magic != kFlashLogMagic) {
+    return -1;
+  }
+  return header.sequence;
+}
+
+bool FlashLog::read_sector(size_t sector, uint8_t *buf) const {
+  return esp_partition_read(this->partition_, sector * kFlashSectorSize, buf, kFlashSectorSize) == ESP_OK;
+}
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "esp_partition.h"
+
+namespace sample_buffer {
+
+const uint32_t kFlashLogMagic = 0x474f4c53;  // "SLOG"
+const size_t kFlashSectorSize = 4096;  // erase unit
+const size_t kFlashPageSize = 256;  // program unit, writes are batched to at least a page where possible
+const uint8_t kFlashBlockLost = 0x01;  // block flag, samples were lost (not logged) before this block
+
+// Compresses a block of samples for the flash log, as
+//   (uint16 block length in bytes, including this header), (uint8 sample count), (uint8 flags),
+//   (int64 timestamp micros of the first sample)
+// followed by, per sample
+//   (uint8 source index), (zigzag varint delta micros from the previous sample),
+//   (uint8 XOR layout: leading zero bytes in the high nibble, byte count in the low nibble), (XOR bytes)
+// where the XOR is of the float bits with the previous sample of the same source in the block (or zero),
+// with the leading and trailing zero bytes dropped, so slowly changing values take few bytes
+class FlashBlockEncoder {
+ public:
+  void begin(size_t sources, int64_t micros, uint8_t flags) {
+    this->out_.assign(4, '\0');
+    this->out_[3] = flags;
+    this->out_.append(reinterpret_cast<const char *>(&micros), sizeof(micros));
+    this->lastMicros_ = micros;
+    this->lastBits_.assign(sources, 0);
+    this->count_ = 0;
+  }
+
+  void add(uint8_t sourceIndex, int64_t micros, float value) {
+    this->out_.push_back(sourceIndex);
+    int64_t delta = micros - this->lastMicros_;
+    this->lastMicros_ = micros;
+    uint64_t zigzag = ((uint64_t) delta << 1) ^ (uint64_t)(delta >> 63);
+    while (zigzag >= 0x80) {
+      this->out_.push_back((zigzag & 0x7f) | 0x80);
+      zigzag >>= 7;
+    }
+    this->out_.push_back(zigzag);
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t xorBits = bits ^ this->lastBits_[sourceIndex];
+    this->lastBits_[sourceIndex] = bits;
+    uint8_t leading = 0, trailing = 0;
+    while (leading < 4 && (xorBits >> (24 - 8 * leading) & 0xff) == 0) {
+      leading++;
+    }
+    while (leading + trailing < 4 && (xorBits >> (8 * trailing) & 0xff) == 0) {
+      trailing++;
+    }
+    uint8_t count = 4 - leading - trailing;
+    this->out_.push_back(leading << 4 | count);
+    for (uint8_t i = 0; i < count; i++) {  // most significant first
+      this->out_.push_back(xorBits >> (8 * (3 - leading - i)) & 0xff);
+    }
+    this->count_++;
+  }
+
+  size_t count() const { return this->count_; }
+
+  // fills in the header, returning the encoded block
+  const std::string &finish() {
+    uint16_t length = this->out_.size();
+    memcpy(&this->out_[0], &length, sizeof(length));
+    this->out_[2] = this->count_;
+    return this->out_;
+  }
+
+ protected:
+  std::string out_;
+  int64_t lastMicros_;
+  std::vector<uint32_t> lastBits_;  // by source index
+  size_t count_;
+};
+
+// Ring of flash sectors in a data partition, each starting with a header
+//   (uint32 kFlashLogMagic), (uint32 sequence number), (uint16 boot number),
+//   then the sample buffer binary format version and sources
+// followed by encoded blocks, up to an erased (0xffff) block length or the end of the sector
+// Sectors are filled in RAM and written out incrementally from loop(), at most one flash operation (a sector
+// erase, or a write of the blocks completing a page) per loop, to bound loop stalls
+class FlashLog {
+ public:
+  // finds the partition and the sector to continue from, returning false if unavailable
+  bool begin(const std::string &partitionLabel, const std::string &sources);
+
+  // appends a block to the current sector, returning false if it doesn't fit (in which case the sector is
+  // closed, and the block should be retried once the next sector has started)
+  bool append_block(const std::string &block);
+  // writes out all appended blocks, even if short of a page
+  void request_flush() { this->flushRequested_ = true; }
+  // does pending flash operations, returning the time taken in micros, or zero if there were none
+  uint32_t loop();
+
+  // whether the current sector is full and waiting to be written out, so blocks can't be appended
+  bool full() const { return this->sectorFull_; }
+  size_t sector_count() const { return this->sectorCount_; }
+  // returns the sequence number of a sector, or -1 if it doesn't have a valid header
+  int64_t read_sequence(size_t sector) const;
+  // reads a whole sector (kFlashSectorSize bytes), returning false on error
+  bool read_sector(size_t sector, uint8_t *buf) const;
+
+  uint32_t take_bytes_written() {
+    uint32_t bytes = this->bytesWritten_;
+    this->bytesWritten_ = 0;
+    return bytes;
+  }
+
+ protected:
+  void start_sector();
+
+  const esp_partition_t *partition_ = nullptr;
+  size_t sectorCount_ = 0;
+  std::string sources_;
+
+  size_t sector_ = 0;  // sector being filled
+  uint32_t sequence_ = 0;  // of the sector being filled
+  uint16_t boot_ = 0;
+  std::string buffer_;  // contents of the sector being filled
+  size_t flushed_ = 0;  // bytes of buffer_ written to flash
+  bool eraseNeeded_ = false;
+  bool sectorFull_ = false;
+  bool flushRequested_ = false;
+
+  uint32_t bytesWritten_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace sample_buffer {
+
+const size_t kBlockRecords = 64;  // records per timestamp keyframe, buffer sizes must be a multiple of this
+const uint8_t kEscapeSource = 0xff;  // source index of escape records, which extend the delta of the next record
+
+// compact 8-byte record, timestamped by delta from the previous record (by sample index)
+// the absolute timestamp of the first record of each block of kBlockRecords is stored separately as a keyframe
+// deltas beyond the 24-bit signed range (about 8 s) are carried by an escape record preceding the sample
+struct SampleRecord {
+  uint32_t sourceDelta;  // source index in the top 8 bits, signed delta micros in the low 24 bits
+  float value;  // for escape records, the upper bits of the delta, as an int32
+
+  uint8_t source_index() const { return sourceDelta >> 24; }
+  int64_t delta_micros() const {
+    if (source_index() == kEscapeSource) {
+      int32_t upper;
+      memcpy(&upper, &value, sizeof(upper));
+      return (int64_t)upper * (1 << 24) + (sourceDelta & 0xffffff);
+    }
+    return (int32_t)(sourceDelta << 8) >> 8;  // sign extend
+  }
+};
+static_assert(sizeof(SampleRecord) == 8, "records should be compact");
+
+// Ring of delta-encoded SampleRecords with per-block keyframes, addressed by a monotonically increasing sample index
+// Samples are appended by a single writer, and may be read concurrently from other tasks without locking
+// (seqlock-style): readers snapshot next_index(), copy out the samples, and check read_valid
+// Sample indices wrap at 2^32, so they must be compared by difference (eg, (int32_t)(a - b) < 0), and the capacity
+// must be a power of two so slots and keyframes stay contiguous across the wrap
+class RecordRing {
+ public:
+  // uses the given storage, of capacity records (a power of two, at least kBlockRecords) and
+  // capacity / kBlockRecords keyframes
+  void init(SampleRecord *records, int64_t *keyframes, size_t capacity) {
+    assert(capacity >= kBlockRecords && (capacity & (capacity - 1)) == 0);
+    this->records_ = records;
+    this->keyframes_ = keyframes;
+    this->capacity_ = capacity;
+  }
+  bool allocated() const { return this->records_ != nullptr && this->keyframes_ != nullptr; }
+
+  // appends a sample, preceded by an escape record if its delta is out of the record's range, from the writer only
+  void append(uint8_t sourceIndex, int64_t micros, float value) {
+    if (next_index() == 0) {
+      this->lastMicros_ = micros;
+    }
+    int64_t deltaMicros = micros - this->lastMicros_;
+    if (deltaMicros < -(1 << 23) || deltaMicros >= (1 << 23)) {
+      this->push(kEscapeSource, deltaMicros, 0);
+      deltaMicros = 0;
+    }
+    this->push(sourceIndex, deltaMicros, value);
+  }
+
+  // sample index one past the latest record
+  uint32_t next_index() const { return this->writeIndex_.load(std::memory_order_acquire); }
+  // oldest readable sample index, the start of the oldest block with its keyframe still in the buffer
+  uint32_t oldest_index() const { return oldest_index(next_index()); }
+  uint32_t oldest_index(uint32_t writeIndex) const {
+    if (!this->filled_.load(std::memory_order_acquire)) {
+      return 0;
+    }
+    // modulo 2^32, which is a multiple of kBlockRecords, so this also rounds up correctly across the wrap
+    return (writeIndex - this->capacity_ + kBlockRecords - 1) / kBlockRecords * kBlockRecords;
+  }
+  // after copying out samples from start, returns whether none of them (or their keyframe) may have been
+  // overwritten during the copy, including by a write in progress
+  bool read_valid(uint32_t start) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // acquire pairs with the claim's release, so a claim that overwrites also has filled_ visible
+    return (int32_t)(start - oldest_index(this->claimIndex_.load(std::memory_order_acquire))) >= 0;
+  }
+
+  // decodes the samples (skipping escape records) from sample index start (which must be readable) up to end
+  // (not before start), calling fn(sourceIndex, micros, value) for each, which returns false to stop
+  // returns the sample index after the last sample decoded
+  template<typename F> uint32_t read(uint32_t start, uint32_t end, F &&fn) const {
+    int64_t micros = 0;
+    for (uint32_t index = start / kBlockRecords * kBlockRecords; index != end; index++) {
+      const SampleRecord &record = this->records_[index % this->capacity_];
+      if (index % kBlockRecords == 0) {  // the keyframe includes the first record's delta
+        micros = this->keyframes_[(index / kBlockRecords) % (this->capacity_ / kBlockRecords)];
+      } else {
+        micros += record.delta_micros();
+      }
+      if ((int32_t)(index - start) >= 0 && record.source_index() != kEscapeSource) {
+        if (!fn(record.source_index(), micros, record.value)) {
+          return index + 1;
+        }
+      }
+    }
+    return end;
+  }
+
+ protected:
+  void push(uint8_t sourceIndex, int64_t deltaMicros, float value) {
+    // claim the slot (invalidating the sample index it held for concurrent readers) before writing,
+    // and publish the sample index after
+    uint32_t index = this->writeIndex_.load(std::memory_order_relaxed);
+    this->claimIndex_.store(index + 1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    SampleRecord &record = this->records_[index % this->capacity_];
+    record.sourceDelta = (uint32_t)sourceIndex << 24 | ((uint32_t)deltaMicros & 0xffffff);
+    if (sourceIndex == kEscapeSource) {  // carries the upper bits of the delta in place of the value
+      int32_t upper = deltaMicros >> 24;
+      memcpy(&record.value, &upper, sizeof(upper));
+    } else {
+      record.value = value;
+    }
+    this->lastMicros_ += deltaMicros;
+    if (index % kBlockRecords == 0) {
+      this->keyframes_[(index / kBlockRecords) % (this->capacity_ / kBlockRecords)] = this->lastMicros_;
+    }
+    if (index + 1 == this->capacity_) {  // from the next write, records are overwritten
+      this->filled_.store(true, std::memory_order_release);
+    }
+    this->writeIndex_.store(index + 1, std::memory_order_release);
+  }
+
+  SampleRecord *records_ = nullptr;  // indexed by sample index modulo capacity_
+  int64_t *keyframes_ = nullptr;  // absolute micros of the first record of each block, indexed by block modulo count
+  size_t capacity_ = 0;
+  std::atomic<uint32_t> writeIndex_{0};  // sample index of the next record, monotonically increasing
+  std::atomic<uint32_t> claimIndex_{0};  // one past the sample index being written, ahead of writeIndex_ during writes
+  std::atomic<bool> filled_{false};  // capacity records have been written, so oldest_index advances
+  int64_t lastMicros_ = 0;  // timestamp of the latest record, for delta encoding
+};
+
+}
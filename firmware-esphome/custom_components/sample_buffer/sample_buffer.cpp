@@ -1,88 +1,816 @@
 #include "sample_buffer.h"
 #include "esphome/core/application.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
 
 namespace sample_buffer {
 
+static const char *const TAG = "sample_buffer";
+
+void SampleBuffer::setup() {
+  size_t blocks = this->capacity_ / kBlockRecords;
+  if (this->psram_) {
+    ExternalRAMAllocator<SampleRecord> recordsAllocator(ExternalRAMAllocator<SampleRecord>::ALLOW_FAILURE);
+    ExternalRAMAllocator<int64_t> keyframesAllocator(ExternalRAMAllocator<int64_t>::ALLOW_FAILURE);
+    this->ring_.init(recordsAllocator.allocate(this->capacity_), keyframesAllocator.allocate(blocks), this->capacity_);
+  } else {
+    this->ring_.init(new SampleRecord[this->capacity_], new int64_t[blocks], this->capacity_);
+  }
+  if (!this->ring_.allocated()) {
+    ESP_LOGE(TAG, "failed to allocate %u records", this->capacity_);
+    this->mark_failed();
+    return;
+  }
+
+  if (this->capturePre_ + this->capturePost_ > 0) {
+    this->capture_.reserve((this->capturePre_ + this->capturePost_) * sizeof(BinarySampleRecord));
+    this->arm_capture();
+  }
+  for (auto &tier : this->aggregateTiers_) {
+    tier.init(this->names_.size());
+  }
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+  if (!this->flashPartition_.empty()) {
+    std::string sources;
+    append_sources(sources);
+    this->flashLog_ = make_unique<FlashLog>();
+    if (!this->flashLog_->begin(this->flashPartition_, sources)) {
+      this->flashLog_ = nullptr;  // continues without, the sample buffer is still usable
+    }
+    this->flashFlushMillis_ = this->flashStatsMillis_ = millis();
+  }
+#endif
+
+  this->base_->init();
+  this->base_->add_handler(this);
+  if (this->streamPort_ != 0) {
+    this->setup_stream();
+  }
+}
+
 bool SampleBuffer::canHandle(AsyncWebServerRequest *request) const {
+  if (request->method() == HTTP_POST && request->url() == "/capture") {  // arm or trigger
+    return true;
+  }
   if (request->method() == HTTP_GET) {
-    if (request->url() == "/samples")
+    if (request->url() == "/samples" || request->url() == "/capture" ||
+        request->url() == "/aggregate")
+      return true;
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+    if (request->url() == "/flashlog" && this->flashLog_ != nullptr)
       return true;
+#endif
   }
 
   return false;
 }
 
 void SampleBuffer::handleRequest(AsyncWebServerRequest *req) {
-  AsyncResponseStream *stream = req->beginResponseStream("text/plain; version=0.0.4; charset=utf-8");
+  bool binary = req->arg("format") == "binary";
+  auto accept = req->get_header("Accept");
+  if (accept.has_value() && accept->find("application/octet-stream") != std::string::npos) {
+    binary = true;
+  }
+
+  if (req->url() == "/capture") {
+    handle_capture(req, binary);
+    return;
+  } else if (req->url() == "/aggregate") {
+    handle_aggregate(req, binary);
+    return;
+  }
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+  if (req->url() == "/flashlog") {
+    handle_flash_log(req);
+    return;
+  }
+#endif
 
-  if (req->hasArg("start")) {  // only return samples if the start index is provided
+  const char *contentType = binary ? "application/octet-stream" : "text/plain; version=0.0.4; charset=utf-8";
+
+  bool hasStart = req->hasArg("start");  // only return samples if the start index is provided
+  uint32_t start = 0;
+  if (hasStart) {
     char* endptr;
-    long start = std::strtol(req->arg("start").c_str(), &endptr, 10);
-    
-    if (*endptr != '\0' || start < 0) {  // buffer underrun or invalid conversion
-      req->send(stream);
+    start = std::strtoul(req->arg("start").c_str(), &endptr, 10);
+    // invalid conversion or buffer underrun, sample indices wrap so are compared by difference
+    if (*endptr != '\0' || req->arg("start").empty() || (int32_t)(start - this->ring_.oldest_index()) < 0) {
+      req->send(req->beginResponseStream(contentType));
       return;
     }
+  }
 
-    // dump samples after (in memory space) recordsEnd_ / before (by sample index) recordsOffset_, if available
-    if (recordsOffset_ > 0) {
-      int startIndex = (int64_t)start - (int64_t)(recordsOffset_ - kBufferSize);
-      if (startIndex < (int)recordsEnd_) {  // buffer underrun
-        req->send(stream);
-        return;
+  SampleFilter filter;
+  if (!parse_filter(req, &filter)) {
+    req->send(400, "text/plain", "invalid filter");
+    return;
+  }
+
+#ifdef USE_ESP_IDF
+  // sent as chunks as they are generated, so the response isn't buffered in memory
+  httpd_req_t *httpdReq = *req;
+  httpd_resp_set_type(httpdReq, contentType);
+  auto send = [httpdReq](const std::string &data) {
+    if (!data.empty()) {
+      httpd_resp_send_chunk(httpdReq, data.data(), data.size());
+    }
+  };
+#else
+  AsyncResponseStream *stream = req->beginResponseStream(contentType);
+  auto send = [stream](const std::string &data) { stream->write((const uint8_t *) data.data(), data.size()); };
+#endif
+
+  // snapshot, samples recorded during the response are left for the next request
+  uint32_t end = this->ring_.next_index();
+  uint32_t cursor = hasStart && (int32_t)(start - end) < 0 ? start : end;
+
+  std::string out;
+  if (binary) {
+    append_sources(out);
+    out.append(reinterpret_cast<const char *>(&cursor), sizeof(cursor));
+    send(out);
+  }
+
+  // this runs concurrently with new samples being recorded, so each chunk of samples is copied out first and
+  // only sent if none were overwritten during the copy, otherwise the response ends early (and the client gets
+  // a buffer underrun on its next request)
+  std::string records;
+  while (cursor != end && filter.remaining > 0) {
+    records.clear();
+    uint32_t next = append_records(records, cursor, end - cursor > kChunkRecords ? cursor + kChunkRecords : end,
+                                   &filter);
+    if (!this->ring_.read_valid(cursor)) {
+      break;
+    }
+    cursor = next;
+    if (binary) {
+      send(records);
+    } else {
+      out.clear();
+      const BinarySampleRecord *samples = reinterpret_cast<const BinarySampleRecord *>(records.data());
+      for (size_t i=0; i<records.size() / sizeof(BinarySampleRecord); i++) {
+        write_sample(out, samples[i]);
+      }
+      send(out);
+    }
+  }
+
+  // ends with the next sample index
+  if (binary) {
+    out.assign(reinterpret_cast<const char *>(&cursor), sizeof(cursor));
+  } else {
+    out = std::to_string(cursor);
+  }
+  send(out);
+
+#ifdef USE_ESP_IDF
+  httpd_resp_send_chunk(httpdReq, nullptr, 0);
+#else
+  req->send(stream);
+#endif
+}
+
+bool SampleBuffer::parse_filter(AsyncWebServerRequest *req, SampleFilter *filter) const {
+  if (req->hasArg("max")) {
+    char* endptr;
+    std::string arg = req->arg("max");
+    long max = std::strtol(arg.c_str(), &endptr, 10);
+    if (*endptr != '\0' || max < 0) {
+      return false;
+    }
+    filter->remaining = max;
+  }
+  if (req->hasArg("sources")) {  // comma-separated source names
+    filter->sources.assign(this->names_.size(), false);
+    std::string arg = req->arg("sources");
+    size_t pos = 0;
+    while (pos <= arg.size()) {
+      size_t comma = std::min(arg.find(',', pos), arg.size());
+      auto it = std::find(this->names_.begin(), this->names_.end(), arg.substr(pos, comma - pos));
+      if (it == this->names_.end()) {
+        return false;
       }
-      for (size_t i=startIndex; i<kBufferSize; i++) {
-        write_sample(stream, records_[i]);
+      filter->sources[it - this->names_.begin()] = true;
+      pos = comma + 1;
+    }
+  }
+  // time range in millis, with the same base as the sample timestamps
+  const char *timeArgs[2] = {"since", "until"};
+  int64_t *timeMicros[2] = {&filter->sinceMicros, &filter->untilMicros};
+  for (size_t i=0; i<2; i++) {
+    if (req->hasArg(timeArgs[i])) {
+      char* endptr;
+      std::string arg = req->arg(timeArgs[i]);
+      double millis = std::strtod(arg.c_str(), &endptr);
+      if (*endptr != '\0') {
+        return false;
       }
+      *timeMicros[i] = millis * 1000;
     }
+  }
+  return true;
+}
 
-    // dump samples past recordsOffset_
-    int startIndex = start - recordsOffset_;
-    if (startIndex < 0) {
-      startIndex = 0;
+void SampleBuffer::append_sources(std::string &out) const {
+  out.push_back(kBinaryFormatVersion);
+  out.push_back(names_.size());
+  for (const auto &name : names_) {
+    out.push_back(name.size());
+    out.append(name);
+  }
+}
+
+uint32_t SampleBuffer::append_records(std::string &out, uint32_t start, uint32_t end, SampleFilter *filter) const {
+  return this->ring_.read(start, end, [this, &out, filter](uint8_t sourceIndex, int64_t micros, float value) {
+    if (sourceIndex >= this->names_.size()) {  // torn by a concurrent write, discarded on validation
+      return true;
+    }
+    if (filter != nullptr) {
+      if (!filter->matches(sourceIndex, micros)) {
+        return true;
+      }
+      filter->remaining--;
+    }
+    BinarySampleRecord packed = {(uint32_t)(micros / 1000), (uint16_t)(micros % 1000), sourceIndex,
+                                 this->accuracyDecimals_[sourceIndex], value};
+    out.append(reinterpret_cast<const char *>(&packed), sizeof(packed));
+    return filter == nullptr || filter->remaining > 0;
+  });
+}
+
+void SampleBuffer::handle_capture(AsyncWebServerRequest *req, bool binary) {
+  if (req->method() == HTTP_POST) {  // state changes only on POST, so GETs (eg, prefetches or crawlers) are safe
+    if (req->hasArg("arm")) {
+      this->captureArmRequested_ = true;
+    }
+    if (req->hasArg("trigger")) {
+      this->captureTriggerRequested_ = true;
+    }
+  }
+
+  static const char *const kStateNames[] = {"disabled", "armed", "triggered", "complete"};
+  const char *contentType = binary ? "application/octet-stream" : "text/plain; version=0.0.4; charset=utf-8";
+
+  // copied out under the lock, which new_value also takes for each sample while triggered, so the response is
+  // formatted and sent (at the client's pace) without holding up recording
+  uint8_t state;
+  int64_t triggerMicros;
+  uint32_t preCount;
+  std::string reason;
+  std::string records;
+  {
+    LockGuard guard(this->captureLock_);
+    state = this->captureState_;
+    triggerMicros = this->captureTriggerMicros_;
+    preCount = this->capturePreCount_;
+    reason = this->captureReason_;
+    if (state == kCaptureTriggered || state == kCaptureComplete) {
+      records = this->capture_;
+    }
+  }
+
+#ifdef USE_ESP_IDF
+  httpd_req_t *httpdReq = *req;
+  httpd_resp_set_type(httpdReq, contentType);
+  auto send = [httpdReq](const std::string &data) {
+    if (!data.empty()) {
+      httpd_resp_send_chunk(httpdReq, data.data(), data.size());
+    }
+  };
+#else
+  AsyncResponseStream *stream = req->beginResponseStream(contentType);
+  auto send = [stream](const std::string &data) { stream->write((const uint8_t *) data.data(), data.size()); };
+#endif
+
+  std::string out;
+  if (binary) {
+    append_sources(out);
+    out.push_back(state);
+    uint32_t triggerMillisPart = triggerMicros / 1000;
+    uint16_t triggerMicrosPart = triggerMicros % 1000;
+    out.append(reinterpret_cast<const char *>(&triggerMillisPart), sizeof(triggerMillisPart));
+    out.append(reinterpret_cast<const char *>(&triggerMicrosPart), sizeof(triggerMicrosPart));
+    out.append(reinterpret_cast<const char *>(&preCount), sizeof(preCount));
+    out.push_back(std::min(reason.size(), (size_t) 255));
+    out.append(reason, 0, 255);
+  } else {
+    out.append("state,");
+    out.append(kStateNames[state]);
+    out.append("\n");
+    if (state == kCaptureTriggered || state == kCaptureComplete) {
+      char buf[64];
+      snprintf(buf, sizeof(buf), "trigger,%" PRIu32 ".%03u,%" PRIu32 ",", (uint32_t)(triggerMicros / 1000),
+               (unsigned)(triggerMicros % 1000), preCount);
+      out.append(buf);
+      out.append(reason);
+      out.append("\n");
+    }
+  }
+  send(out);
+
+  const size_t chunkBytes = kChunkRecords * sizeof(BinarySampleRecord);
+  for (size_t offset = 0; offset < records.size(); offset += chunkBytes) {
+    size_t bytes = std::min(chunkBytes, records.size() - offset);
+    if (binary) {
+      out.assign(records, offset, bytes);
+    } else {
+      out.clear();
+      const BinarySampleRecord *samples = reinterpret_cast<const BinarySampleRecord *>(records.data() + offset);
+      for (size_t i=0; i<bytes / sizeof(BinarySampleRecord); i++) {
+        write_sample(out, samples[i]);
+      }
     }
-    for (size_t i=startIndex; i<recordsEnd_; i++) {
-      write_sample(stream, records_[i]);
+    send(out);
+  }
+
+#ifdef USE_ESP_IDF
+  httpd_resp_send_chunk(httpdReq, nullptr, 0);
+#else
+  req->send(stream);
+#endif
+}
+
+void SampleBuffer::handle_aggregate(AsyncWebServerRequest *req, bool binary) {
+  AggregateTier *tier = nullptr;
+  if (req->hasArg("period")) {
+    uint32_t periodSeconds = std::strtoul(req->arg("period").c_str(), nullptr, 10);
+    for (auto &candidate : this->aggregateTiers_) {
+      if (candidate.period_seconds() == periodSeconds) {
+        tier = &candidate;
+      }
+    }
+  } else if (!this->aggregateTiers_.empty()) {
+    tier = &this->aggregateTiers_.front();
+  }
+  SampleFilter filter;
+  if (tier == nullptr || !parse_filter(req, &filter)) {
+    req->send(400, "text/plain", "invalid period or filter");
+    return;
+  }
+
+  const char *contentType = binary ? "application/octet-stream" : "text/plain; version=0.0.4; charset=utf-8";
+#ifdef USE_ESP_IDF
+  httpd_req_t *httpdReq = *req;
+  httpd_resp_set_type(httpdReq, contentType);
+  auto send = [httpdReq](const std::string &data) {
+    if (!data.empty()) {
+      httpd_resp_send_chunk(httpdReq, data.data(), data.size());
+    }
+  };
+#else
+  AsyncResponseStream *stream = req->beginResponseStream(contentType);
+  auto send = [stream](const std::string &data) { stream->write((const uint8_t *) data.data(), data.size()); };
+#endif
+
+  int64_t periodMicros = (int64_t)tier->period_seconds() * 1000000;
+  std::string out;
+  if (binary) {
+    append_sources(out);
+    uint32_t periodSeconds = tier->period_seconds();
+    out.append(reinterpret_cast<const char *>(&periodSeconds), sizeof(periodSeconds));
+    send(out);
+  }
+
+  // bins are copied out a chunk of periods at a time under the lock, and sent after releasing it, so the main loop
+  // isn't blocked by the network; periods that age out between chunks are skipped
+  int64_t period = INT64_MIN;
+  int64_t end;
+  while (true) {
+    out.clear();
+    {
+      LockGuard guard(this->aggregateLock_);
+      end = tier->open_period();
+      if (filter.untilMicros != INT64_MAX) {
+        end = std::min(end, (filter.untilMicros + periodMicros - 1) / periodMicros);
+      }
+      period = std::max({period, tier->oldest_period(), filter.sinceMicros / periodMicros});
+      for (size_t chunk = 0; period < end && chunk < kChunkRecords && filter.remaining > 0; chunk++, period++) {
+        int64_t micros = period * periodMicros;
+        filter.remaining--;  // counts periods, so all sources of a period are returned together
+        for (size_t sourceIndex = 0; sourceIndex < this->names_.size(); sourceIndex++) {
+          if (!filter.matches(sourceIndex, micros)) {
+            continue;
+          }
+          const AggregateBin &bin = tier->bin(period, sourceIndex);
+          if (binary) {
+            BinaryAggregateRecord record = {(uint32_t)(micros / 1000), bin.count, (uint8_t)sourceIndex,
+                                            this->accuracyDecimals_[sourceIndex], bin.min, bin.max, bin.mean};
+            out.append(reinterpret_cast<const char *>(&record), sizeof(record));
+          } else {
+            char buf[128];
+            snprintf(buf, sizeof(buf), "%" PRIu32 ",", (uint32_t)(micros / 1000));
+            out.append(buf);
+            out.append(this->names_[sourceIndex]);
+            snprintf(buf, sizeof(buf), ",%" PRIu32 ",%f,%f,%f\n", bin.count, bin.min, bin.max, bin.mean);
+            out.append(buf);
+          }
+        }
+      }
+    }
+    send(out);
+    if (period >= end || filter.remaining == 0) {
+      break;
+    }
+  }
+
+  // ends with the timestamp to continue from
+  uint32_t nextMillis = period * periodMicros / 1000;
+  if (binary) {
+    out.assign(reinterpret_cast<const char *>(&nextMillis), sizeof(nextMillis));
+  } else {
+    out = std::to_string(nextMillis);
+  }
+  send(out);
+
+#ifdef USE_ESP_IDF
+  httpd_resp_send_chunk(httpdReq, nullptr, 0);
+#else
+  req->send(stream);
+#endif
+}
+
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+void SampleBuffer::handle_flash_log(AsyncWebServerRequest *req) {
+  uint32_t start = 0;
+  if (req->hasArg("start")) {
+    start = std::strtoul(req->arg("start").c_str(), nullptr, 10);
+  }
+
+  // sectors by sequence number, since the ring may have wrapped
+  std::vector<std::pair<uint32_t, size_t>> sectors;
+  for (size_t sector = 0; sector < this->flashLog_->sector_count(); sector++) {
+    int64_t sequence = this->flashLog_->read_sequence(sector);
+    if (sequence >= start) {
+      sectors.emplace_back(sequence, sector);
     }
   }
+  std::sort(sectors.begin(), sectors.end());
+
+  const char *contentType = "application/octet-stream";
+#ifdef USE_ESP_IDF
+  httpd_req_t *httpdReq = *req;
+  httpd_resp_set_type(httpdReq, contentType);
+  auto send = [httpdReq](const uint8_t *data, size_t size) {
+    httpd_resp_send_chunk(httpdReq, reinterpret_cast<const char *>(data), size);
+  };
+#else
+  AsyncResponseStream *stream = req->beginResponseStream(contentType);
+  auto send = [stream](const uint8_t *data, size_t size) { stream->write(data, size); };
+#endif
 
-  // dump the next sample index
-  stream->print(recordsOffset_ + recordsEnd_);
+  std::unique_ptr<uint8_t[]> buf(new uint8_t[kFlashSectorSize]);
+  for (const auto &sector : sectors) {
+    if (!this->flashLog_->read_sector(sector.second, buf.get())) {
+      break;
+    }
+    uint32_t sequence;
+    memcpy(&sequence, buf.get() + sizeof(kFlashLogMagic), sizeof(sequence));
+    if (sequence != sector.first) {  // overwritten since the scan, and out of order
+      continue;
+    }
+    send(buf.get(), kFlashSectorSize);
+  }
 
+#ifdef USE_ESP_IDF
+  httpd_resp_send_chunk(httpdReq, nullptr, 0);
+#else
   req->send(stream);
+#endif
 }
 
-void SampleBuffer::write_sample(AsyncResponseStream *stream, SampleRecord& sample) {
-  stream->print(sample.millis);
-  stream->print(",");
-  stream->print(names_[sample.sourceIndex].c_str());
-  stream->print(",");
-  stream->print(sample.value);
-  stream->print("\n");
+void SampleBuffer::service_flash_log() {
+  uint32_t now = millis();
+  uint32_t end = this->ring_.next_index();
+  if ((int32_t)(this->flashCursor_ - this->ring_.oldest_index(end)) < 0) {
+    this->flashCursor_ = this->ring_.oldest_index(end);
+    this->flashLost_ = true;
+  }
+
+  bool flushDue = now - this->flashFlushMillis_ >= this->flashFlushIntervalMillis_;
+  if (!this->flashLog_->full() && this->flashCursor_ != end &&
+      (end - this->flashCursor_ >= kBlockRecords || flushDue)) {
+    bool begun = false;
+    uint32_t blockEnd = end - this->flashCursor_ > kBlockRecords ? this->flashCursor_ + kBlockRecords : end;
+    uint32_t next = this->ring_.read(this->flashCursor_, blockEnd,
+                                     [this, &begun](uint8_t sourceIndex, int64_t micros, float value) {
+      if (!begun) {
+        this->flashEncoder_.begin(this->names_.size(), micros, this->flashLost_ ? kFlashBlockLost : 0);
+        begun = true;
+      }
+      this->flashEncoder_.add(sourceIndex, micros, value);
+      return true;
+    });
+    if (!begun) {  // only escape records
+      this->flashCursor_ = next;
+    } else if (this->flashLog_->append_block(this->flashEncoder_.finish())) {  // otherwise retried next sector
+      this->flashCursor_ = next;
+      this->flashLost_ = false;
+    }
+  }
+  if (flushDue) {
+    this->flashLog_->request_flush();
+    this->flashFlushMillis_ = now;
+  }
+
+  this->flashMaxStallMicros_ = std::max(this->flashMaxStallMicros_, this->flashLog_->loop());
+
+  if (now - this->flashStatsMillis_ >= kFlashStatsIntervalMillis) {
+    float writeRate = this->flashLog_->take_bytes_written() * 1000.0f / (now - this->flashStatsMillis_);
+    float stallMillis = this->flashMaxStallMicros_ / 1000.0f;
+    ESP_LOGD(TAG, "flash log %.0f B/s, max stall %.1f ms", writeRate, stallMillis);
+    if (this->flashWriteRateSensor_ != nullptr) {
+      this->flashWriteRateSensor_->publish_state(writeRate);
+    }
+    if (this->flashStallSensor_ != nullptr) {
+      this->flashStallSensor_->publish_state(stallMillis);
+    }
+    this->flashMaxStallMicros_ = 0;
+    this->flashStatsMillis_ = now;
+  }
 }
+#endif
 
-void SampleBuffer::add_source(sensor::Sensor *source, const std::string &name) {
-  size_t sourceIndex = names_.size();
+void SampleBuffer::arm_capture() {
+  if (this->capturePre_ + this->capturePost_ == 0) {
+    return;
+  }
+  LockGuard guard(this->captureLock_);
+  this->capture_.clear();
+  this->capturePreCount_ = 0;
+  this->captureTriggerMicros_ = 0;
+  this->captureReason_.clear();
+  this->captureState_ = kCaptureArmed;
+}
+
+void SampleBuffer::trigger_capture(const std::string &reason, int64_t micros) {
+  if (this->captureState_ != kCaptureArmed || !this->ring_.allocated()) {
+    return;
+  }
+  LockGuard guard(this->captureLock_);
+  uint32_t end = this->ring_.next_index();
+  uint32_t oldest = this->ring_.oldest_index(end);
+  // same task as the writer, so consistent
+  append_records(this->capture_, end - oldest > this->capturePre_ ? end - this->capturePre_ : oldest, end);
+  this->capturePreCount_ = this->capture_.size() / sizeof(BinarySampleRecord);
+  this->capturePostRemaining_ = this->capturePost_;
+  this->captureTriggerMicros_ = micros;
+  this->captureReason_ = reason;
+  this->captureState_ = this->capturePost_ > 0 ? kCaptureTriggered : kCaptureComplete;
+  ESP_LOGI(TAG, "capture triggered: %s", reason.c_str());
+}
+
+void SampleBuffer::check_level_triggers(uint8_t sourceIndex, int64_t micros, float value) {
+  for (auto &trigger : this->levelTriggers_) {
+    if (trigger.sourceIndex != sourceIndex) {
+      continue;
+    }
+    bool crossed = trigger.rising ? (trigger.last < trigger.level && value >= trigger.level) :
+                                    (trigger.last > trigger.level && value <= trigger.level);  // false if NaN
+    trigger.last = value;
+    if (crossed) {
+      char reason[64];
+      snprintf(reason, sizeof(reason), "%s %s %g", this->names_[sourceIndex].c_str(), trigger.rising ? "above" : "below",
+               trigger.level);
+      this->trigger_capture(reason, micros);
+    }
+  }
+}
+
+#ifdef USE_BINARY_SENSOR
+void SampleBuffer::add_binary_sensor_trigger(binary_sensor::BinarySensor *sensor, optional<bool> state) {
+  sensor->add_on_state_callback([this, sensor, state](bool value) {
+    if (!state.has_value() || *state == value) {
+      this->trigger_capture(sensor->get_name() + (value ? " on" : " off"), esp_timer_get_time());
+    }
+  });
+}
+#endif
+
+#ifdef USE_TEXT_SENSOR
+void SampleBuffer::add_text_sensor_trigger(text_sensor::TextSensor *sensor) {
+  sensor->add_on_state_callback([this, sensor](const std::string &value) {
+    if (!value.empty()) {
+      this->trigger_capture(sensor->get_name() + ": " + value, esp_timer_get_time());
+    }
+  });
+}
+#endif
+
+void SampleBuffer::setup_stream() {
+  this->streamSocket_ = socket::socket_ip(SOCK_STREAM, 0);
+  if (this->streamSocket_ == nullptr) {
+    ESP_LOGE(TAG, "stream: could not create socket");
+    return;
+  }
+  int enable = 1;
+  this->streamSocket_->setsockopt(SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int));
+  this->streamSocket_->setblocking(false);
+
+  struct sockaddr_storage server;
+  socklen_t serverLen = socket::set_sockaddr_any((struct sockaddr *) &server, sizeof(server), this->streamPort_);
+  if (serverLen == 0 || this->streamSocket_->bind((struct sockaddr *) &server, serverLen) != 0 ||
+      this->streamSocket_->listen(kStreamMaxClients) != 0) {
+    ESP_LOGE(TAG, "stream: could not listen on port %u, errno %d", this->streamPort_, errno);
+    this->streamSocket_ = nullptr;
+  }
+}
+
+void SampleBuffer::loop() {
+  if (this->captureArmRequested_.exchange(false)) {
+    this->arm_capture();
+  }
+  if (this->captureTriggerRequested_.exchange(false)) {
+    this->trigger_capture("request", esp_timer_get_time());
+  }
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+  if (this->flashLog_ != nullptr) {
+    this->service_flash_log();
+  }
+#endif
+
+  if (this->streamSocket_ == nullptr) {
+    return;
+  }
+
+  while (true) {
+    struct sockaddr_storage sourceAddr;
+    socklen_t addrLen = sizeof(sourceAddr);
+    std::unique_ptr<socket::Socket> sock = this->streamSocket_->accept((struct sockaddr *) &sourceAddr, &addrLen);
+    if (sock == nullptr) {
+      break;
+    }
+    if (this->streamClients_.size() >= kStreamMaxClients) {
+      ESP_LOGW(TAG, "stream: too many clients, rejecting %s", sock->getpeername().c_str());
+      continue;  // closed when sock goes out of scope
+    }
+    ESP_LOGD(TAG, "stream: client %s connected", sock->getpeername().c_str());
+    sock->setblocking(false);
+    int enable = 1;
+    sock->setsockopt(IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(int));
+
+    StreamClient client;
+    client.socket = std::move(sock);
+    client.cursor = this->ring_.next_index();
+    append_sources(client.pending);
+    client.pending.append(reinterpret_cast<const char *>(&client.cursor), sizeof(client.cursor));
+    this->streamClients_.push_back(std::move(client));
+  }
+
+  for (auto it = this->streamClients_.begin(); it != this->streamClients_.end();) {
+    if (this->service_stream_client(*it)) {
+      it++;
+    } else {
+      ESP_LOGD(TAG, "stream: client %s disconnected", it->socket->getpeername().c_str());
+      it = this->streamClients_.erase(it);
+    }
+  }
+}
+
+bool SampleBuffer::service_stream_client(StreamClient &client) {
+  if (client.pendingOffset >= client.pending.size()) {  // previous batch fully written, encode the next one
+    client.pending.clear();
+    client.pendingOffset = 0;
+
+    uint32_t oldest = this->ring_.oldest_index();
+    if ((int32_t)(client.cursor - oldest) < 0) {  // fell behind and records were overwritten
+      BinarySampleRecord gap = {oldest - client.cursor, 0, kGapSource, 0, NAN};
+      client.pending.append(reinterpret_cast<const char *>(&gap), sizeof(gap));
+      client.cursor = oldest;
+    }
+    uint32_t end = this->ring_.next_index();
+    if (end - client.cursor > kStreamBatchRecords) {
+      end = client.cursor + kStreamBatchRecords;
+    }
+    append_records(client.pending, client.cursor, end);
+    client.cursor = end;
+  }
+
+  if (client.pendingOffset >= client.pending.size()) {  // nothing new
+    return true;
+  }
+  // the client is only ever sent whole batches from its cursor, so a slow client stalls here (backpressure)
+  // until its cursor falls out of the buffer, at which point it gets a gap marker
+  ssize_t written = client.socket->write(client.pending.data() + client.pendingOffset,
+                                         client.pending.size() - client.pendingOffset);
+  if (written < 0) {
+    return errno == EWOULDBLOCK || errno == EAGAIN;
+  }
+  client.pendingOffset += written;
+  return true;
+}
+
+void SampleBuffer::write_sample(std::string &out, const BinarySampleRecord &sample) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%" PRIu32 ".%03u,", sample.millis, (unsigned) sample.micros);
+  out.append(buf);
+  out.append(names_[sample.sourceIndex]);
+  snprintf(buf, sizeof(buf), ",%f\n", sample.value);
+  out.append(buf);
+}
+
+size_t SampleBuffer::add_source_name(const std::string &name, int8_t accuracyDecimals) {
   names_.push_back(name);  // create a local copy
+  accuracyDecimals_.push_back(accuracyDecimals);
+  return names_.size() - 1;
+}
 
+void SampleBuffer::add_source(sensor::Sensor *source, const std::string &name, std::function<int64_t()> timestamp) {
+  size_t sourceIndex = this->add_source_name(name, source->get_accuracy_decimals());
   source->add_on_state_callback(
-    [this, source, sourceIndex](float value) -> void { 
-      uint32_t timestamp = esphome::millis();
+    [this, source, sourceIndex, timestamp](float value) -> void { 
+      int64_t micros = timestamp ? timestamp() : esp_timer_get_time();
       int8_t accuracyDecimals = source->get_accuracy_decimals();
-      this->new_value(sourceIndex, timestamp, value, accuracyDecimals);
+      this->new_value(sourceIndex, micros, value, accuracyDecimals);
+    }
+  );
+}
+
+size_t SampleBuffer::init_pair(const std::string &voltageName, int8_t voltageAccuracyDecimals,
+                               const std::string &currentName, int8_t currentAccuracyDecimals,
+                               const std::string &powerName, int8_t powerAccuracyDecimals, uint32_t maxSkewMicros) {
+  SamplePair pair;
+  pair.voltageIndex = this->add_source_name(voltageName, voltageAccuracyDecimals);
+  pair.currentIndex = this->add_source_name(currentName, currentAccuracyDecimals);
+  pair.powerIndex = this->add_source_name(powerName, powerAccuracyDecimals);
+  pair.maxSkewMicros = maxSkewMicros;
+  pair.powerAccuracyDecimals = powerAccuracyDecimals;
+  pairs_.push_back(pair);
+  return pairs_.size() - 1;
+}
+
+void SampleBuffer::add_pair(sensor::Sensor *voltage, const std::string &voltageName,
+                            std::function<int64_t()> voltageTimestamp, sensor::Sensor *current,
+                            const std::string &currentName, std::function<int64_t()> currentTimestamp,
+                            const std::string &powerName, int8_t powerAccuracyDecimals, uint32_t maxSkewMicros) {
+  size_t pairIndex = this->init_pair(voltageName, voltage->get_accuracy_decimals(), currentName,
+                                     current->get_accuracy_decimals(), powerName, powerAccuracyDecimals,
+                                     maxSkewMicros);
+  voltage->add_on_state_callback(
+    [this, voltage, pairIndex, voltageTimestamp](float value) -> void {
+      int64_t micros = voltageTimestamp ? voltageTimestamp() : esp_timer_get_time();
+      this->new_pair_value(pairIndex, false, micros, value, voltage->get_accuracy_decimals());
+    }
+  );
+  current->add_on_state_callback(
+    [this, current, pairIndex, currentTimestamp](float value) -> void {
+      int64_t micros = currentTimestamp ? currentTimestamp() : esp_timer_get_time();
+      this->new_pair_value(pairIndex, true, micros, value, current->get_accuracy_decimals());
     }
   );
 }
 
-void SampleBuffer::new_value(size_t sourceIndex, uint32_t millis, float value, int8_t accuracyDecimals) {
-  records_[recordsEnd_].millis = millis;
-  records_[recordsEnd_].value = value;
-  records_[recordsEnd_].sourceIndex = sourceIndex;
-  records_[recordsEnd_].accuracyDecimals = accuracyDecimals;
-  recordsEnd_++;
-  if (recordsEnd_ >= kBufferSize) {
-    recordsEnd_ -= kBufferSize;
-    recordsOffset_ += kBufferSize;
+void SampleBuffer::new_pair_value(size_t pairIndex, bool isCurrent, int64_t micros, float value,
+                                  int8_t accuracyDecimals) {
+  SamplePair &pair = this->pairs_[pairIndex];
+  if (pair.pending) {
+    if (pair.pendingCurrent != isCurrent && std::abs(micros - pair.pendingMicros) <= pair.maxSkewMicros) {
+      int64_t pairMicros = (micros + pair.pendingMicros) / 2;
+      float voltage = isCurrent ? pair.pendingValue : value;
+      float current = isCurrent ? value : pair.pendingValue;
+      int8_t voltageAccuracyDecimals = isCurrent ? pair.pendingAccuracyDecimals : accuracyDecimals;
+      int8_t currentAccuracyDecimals = isCurrent ? accuracyDecimals : pair.pendingAccuracyDecimals;
+      this->new_value(pair.voltageIndex, pairMicros, voltage, voltageAccuracyDecimals);
+      this->new_value(pair.currentIndex, pairMicros, current, currentAccuracyDecimals);
+      this->new_value(pair.powerIndex, pairMicros, voltage * current, pair.powerAccuracyDecimals);
+      pair.pending = false;
+      return;
+    }
+    // no counterpart (eg, a missed conversion), so the pending sample is recorded on its own
+    this->new_value(pair.pendingCurrent ? pair.currentIndex : pair.voltageIndex, pair.pendingMicros,
+                    pair.pendingValue, pair.pendingAccuracyDecimals);
+  }
+  pair.pending = true;
+  pair.pendingCurrent = isCurrent;
+  pair.pendingMicros = micros;
+  pair.pendingValue = value;
+  pair.pendingAccuracyDecimals = accuracyDecimals;
+}
+
+void SampleBuffer::new_value(size_t sourceIndex, int64_t micros, float value, int8_t accuracyDecimals) {
+  if (!this->ring_.allocated()) {
+    return;
+  }
+  this->accuracyDecimals_[sourceIndex] = accuracyDecimals;
+  this->ring_.append(sourceIndex, micros, value);
+
+  if (this->captureState_ == kCaptureTriggered) {
+    LockGuard guard(this->captureLock_);
+    BinarySampleRecord packed = {(uint32_t)(micros / 1000), (uint16_t)(micros % 1000), (uint8_t)sourceIndex,
+                                 accuracyDecimals, value};
+    this->capture_.append(reinterpret_cast<const char *>(&packed), sizeof(packed));
+    if (--this->capturePostRemaining_ == 0) {
+      this->captureState_ = kCaptureComplete;
+      ESP_LOGI(TAG, "capture complete");
+    }
+  }
+  if (!this->levelTriggers_.empty()) {
+    this->check_level_triggers(sourceIndex, micros, value);
+  }
+  if (!this->aggregateTiers_.empty()) {
+    LockGuard guard(this->aggregateLock_);
+    for (auto &tier : this->aggregateTiers_) {
+      tier.add(sourceIndex, micros, value);
+    }
   }
 }
 
@@ -1,50 +1,270 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <map>
+#include <memory>
 #include <utility>
 
+#include "esp_timer.h"
+
+#include "esphome/components/socket/socket.h"
 #include "esphome/components/web_server_base/web_server_base.h"
 #include "esphome/core/component.h"
 #include "esphome/components/sensor/sensor.h"
+#ifdef USE_BINARY_SENSOR
+#include "esphome/components/binary_sensor/binary_sensor.h"
+#endif
+#ifdef USE_TEXT_SENSOR
+#include "esphome/components/text_sensor/text_sensor.h"
+#endif
+#include "esphome/core/helpers.h"
 #include "esphome/core/controller.h"
 #include "esphome/core/entity_base.h"
 
+#include "aggregate_tier.h"
+#include "flash_log.h"
+#include "record_ring.h"
+
 using namespace esphome;
 
 namespace sample_buffer {
 
-const size_t kBufferSize = 4096;
+const uint8_t kBinaryFormatVersion = 3;
+const uint32_t kChunkRecords = 64;  // samples copied out (and sent) at a time by the HTTP API
 
-struct SampleRecord {
-  size_t sourceIndex;
+// binary format record, fixed-size and little-endian (native on the ESP32)
+struct __attribute__((packed)) BinarySampleRecord {
   uint32_t millis;
+  uint16_t micros;  // sub-millisecond part of the timestamp, 0-999
+  uint8_t sourceIndex;  // into the header source names
+  int8_t accuracyDecimals;
   float value;
+};
+static_assert(sizeof(BinarySampleRecord) == 12, "binary record layout is part of the HTTP API");
+
+// binary format aggregate record, summarizing a source over the period starting at millis
+struct __attribute__((packed)) BinaryAggregateRecord {
+  uint32_t millis;
+  uint32_t count;  // number of samples, 0 (with NaN statistics) for periods without samples
+  uint8_t sourceIndex;
   int8_t accuracyDecimals;
+  float min;
+  float max;
+  float mean;
+};
+static_assert(sizeof(BinaryAggregateRecord) == 22, "binary record layout is part of the HTTP API");
+
+const uint32_t kFlashStatsIntervalMillis = 10000;
+
+const uint8_t kGapSource = 0xff;  // source index of stream gap markers, where millis is the number of samples lost
+const size_t kStreamMaxClients = 2;
+const uint32_t kStreamBatchRecords = 64;  // samples encoded per client per loop, bounds the loop time and memory
+
+// selects the samples returned by the HTTP API
+struct SampleFilter {
+  std::vector<bool> sources;  // by source index, or empty for all sources
+  int64_t sinceMicros = INT64_MIN;  // inclusive
+  int64_t untilMicros = INT64_MAX;  // exclusive
+  uint32_t remaining = UINT32_MAX;  // maximum number of samples still to be returned
+
+  bool matches(uint8_t sourceIndex, int64_t micros) const {
+    return (sources.empty() || sources[sourceIndex]) && micros >= sinceMicros && micros < untilMicros;
+  }
+};
+
+// pairs voltage and current samples from the same conversion cycle, recorded as consecutive voltage, current and
+// power records with one timestamp
+struct SamplePair {
+  size_t voltageIndex;  // source indices
+  size_t currentIndex;
+  size_t powerIndex;
+  int64_t maxSkewMicros;  // samples further apart are recorded unpaired
+  int8_t powerAccuracyDecimals;
+
+  bool pending = false;  // whether a sample is waiting for its counterpart
+  bool pendingCurrent;  // the pending sample is a current, otherwise voltage
+  int64_t pendingMicros;
+  float pendingValue;
+  int8_t pendingAccuracyDecimals;
+};
+
+enum CaptureState : uint8_t {
+  kCaptureDisabled = 0,  // not configured
+  kCaptureArmed = 1,  // waiting for a trigger
+  kCaptureTriggered = 2,  // collecting post-trigger samples
+  kCaptureComplete = 3,  // frozen until re-armed
+};
+
+// triggers a capture when a source's samples cross a level
+struct LevelTrigger {
+  uint8_t sourceIndex;
+  float level;
+  bool rising;  // crossing upwards, otherwise downwards
+  float last = NAN;  // previous sample of the source
+};
+
+struct StreamClient {
+  std::unique_ptr<socket::Socket> socket;
+  uint32_t cursor;  // next sample index to encode
+  std::string pending;  // encoded batch, written out before the next batch is encoded
+  size_t pendingOffset = 0;
 };
 
 // Records and timestamps samples from sensors as they come in, and stores them into a circular buffer
+// The buffer holds up to buffer_size records (including escape records for long gaps), though the oldest
+// partial block of kBlockRecords records is not readable since its keyframe has been overwritten
 // Exposes a HTTP API to access this buffer, by specifying a start sample index
 // If no start sample index is specified, returns the next sample index
 // If the start sample index is no longer available (buffer underrun), returns empty
-// Otherwise, returns all the samples in the buffer (starting with and including start), as lines of
-//   (timestamp in millis),(sensor name),(value)
+// Otherwise, returns the samples in the buffer (starting with and including start), as lines of
+//   (timestamp in millis, with three decimal places),(sensor name),(value)
 // and ends with the next sample index
+// Paired sources (see add_pair) are recorded as consecutive voltage, current and power samples with the same
+// timestamp, so clients can group them into rows by timestamp
 // If the start sample is beyond the buffer, returns just the next sample index
+// Samples can be limited by the optional parameters
+//   max: maximum number of samples, where the next sample index continues after the last returned sample
+//   sources: comma-separated source names
+//   since, until: timestamp range in millis, including since and excluding until
+// The response is generated and sent in chunks, and if samples are overwritten while being read out, ends early
+// with the next sample index at that point
+//
+// With format=binary (or an Accept: application/octet-stream header), instead returns a little-endian binary
+// response of a header
+//   (uint8 version), (uint8 source count), per source: (uint8 name length) (name bytes),
+//   (uint32 start sample index)
+// followed by BinarySampleRecords, and ending with (uint32 next sample index)
+// On a buffer underrun, returns empty
+//
+// Optionally, a capture engine freezes the records around a trigger (a source crossing a level, a binary sensor
+// edge, a text sensor changing to non-empty, or a request) into a separate capture buffer, served at /capture
+// It returns the capture state and, once triggered, the trigger as lines of
+//   state,(disabled|armed|triggered|complete)
+//   trigger,(timestamp in millis),(number of pre-trigger samples),(reason)
+// followed by the captured samples in the /samples format
+// POST with the arm parameter re-arms (discarding the previous capture), and with the trigger parameter triggers
+// a capture if armed, both taking effect on the next loop and returning the capture like GET
+// With format=binary, instead returns the binary format version and sources, then
+//   (uint8 state), (uint32 trigger millis), (uint16 trigger micros), (uint32 pre-trigger sample count),
+//   (uint8 reason length) (reason)
+// followed by BinarySampleRecords
+//
+// Optionally, aggregate tiers keep the min, max and mean of each source over fixed periods (eg per second, minute
+// and hour), over longer spans than the raw buffer, served at /aggregate with the optional parameters
+//   period: period in seconds, selecting the tier, by default the shortest
+//   sources, since, until: as for /samples, applying to the period start
+//   max: maximum number of periods
+// as lines of
+//   (period start timestamp in millis),(sensor name),(sample count),(min),(max),(mean)
+// and ending with the timestamp of the current (incomplete) period, from which the next request can continue
+// Periods without samples are included with a count of 0, non-finite samples (eg NaN) are not counted
+// With format=binary, instead returns the binary format version and sources, (uint32 period seconds), followed by
+// BinaryAggregateRecords, and ending with (uint32 current period millis)
+//
+// Optionally, a flash log persists samples to a ring of sectors in a flash partition (see flash_log.h), so they
+// survive a buffer overrun while no client is connected, and across reboots
+// Samples are compressed in blocks of up to kBlockRecords, and written out once at least a flash page of blocks
+// is ready, or every flush interval (when partial blocks are also logged)
+// The sectors are served at /flashlog in order of sequence number (oldest first), as raw kFlashSectorSize byte
+// sectors, optionally starting from sequence number start
+//
+// Optionally, also pushes new samples to TCP clients on a stream port, which receive the binary format's
+// version and sources, (uint32 start sample index), then BinarySampleRecords as they are recorded
+// A client that falls behind far enough that its samples are overwritten instead gets a gap marker record
+// (source index kGapSource) and continues from the oldest sample
 class SampleBuffer : public Component, public AsyncWebHandler {
  public:
   SampleBuffer(web_server_base::WebServerBase *base) : base_(base) {}
 
-  // Add a sensor source to this sample buffer
-  void add_source(sensor::Sensor *source, const std::string &name);
+  // Add a sensor source to this sample buffer, optionally with a function returning the acquisition time
+  // (in esp_timer_get_time() micros) of the current sample, otherwise samples are timestamped on publish
+  void add_source(sensor::Sensor *source, const std::string &name, std::function<int64_t()> timestamp = nullptr);
+
+  // Add a voltage and current source pair, with the power as a third source, see SamplePair
+  void add_pair(sensor::Sensor *voltage, const std::string &voltageName, std::function<int64_t()> voltageTimestamp,
+                sensor::Sensor *current, const std::string &currentName, std::function<int64_t()> currentTimestamp,
+                const std::string &powerName, int8_t powerAccuracyDecimals, uint32_t maxSkewMicros);
+
+  // Add a source recording every conversion of a sensor that publishes only some of them (eg, an MCP3561Sensor
+  // with a publish interval), through its add_on_conversion_callback(std::function<void(float, int64_t)>),
+  // timestamped at acquisition
+  template<typename S> void add_conversion_source(S *source, const std::string &name) {
+    size_t sourceIndex = this->add_source_name(name, source->get_accuracy_decimals());
+    source->add_on_conversion_callback([this, source, sourceIndex](float value, int64_t micros) {
+      this->new_value(sourceIndex, micros, value, source->get_accuracy_decimals());
+    });
+  }
+  // Add a voltage and current source pair like add_pair, recording every conversion like add_conversion_source
+  template<typename S> void add_conversion_pair(S *voltage, const std::string &voltageName, S *current,
+                                                const std::string &currentName, const std::string &powerName,
+                                                int8_t powerAccuracyDecimals, uint32_t maxSkewMicros) {
+    size_t pairIndex = this->init_pair(voltageName, voltage->get_accuracy_decimals(), currentName,
+                                       current->get_accuracy_decimals(), powerName, powerAccuracyDecimals,
+                                       maxSkewMicros);
+    voltage->add_on_conversion_callback([this, voltage, pairIndex](float value, int64_t micros) {
+      this->new_pair_value(pairIndex, false, micros, value, voltage->get_accuracy_decimals());
+    });
+    current->add_on_conversion_callback([this, current, pairIndex](float value, int64_t micros) {
+      this->new_pair_value(pairIndex, true, micros, value, current->get_accuracy_decimals());
+    });
+  }
 
   bool canHandle(AsyncWebServerRequest *request) const override;
 
   void handleRequest(AsyncWebServerRequest *req) override;
 
-  void setup() override {
-    this->base_->init();
-    this->base_->add_handler(this);
+  // capacity in records, must be a power of two of at least kBlockRecords, optionally allocated in PSRAM
+  void set_buffer_size(size_t size, bool psram) {
+    this->capacity_ = size;
+    this->psram_ = psram;
   }
+
+  // optional, TCP port to push samples to streaming clients on
+  void set_stream_port(uint16_t port) { this->streamPort_ = port; }
+
+  // enables the capture engine, which is armed on setup, with the number of pre- and post-trigger records
+  void set_capture(uint32_t preSamples, uint32_t postSamples) {
+    this->capturePre_ = preSamples;
+    this->capturePost_ = postSamples;
+  }
+  void add_level_trigger(uint8_t sourceIndex, float level, bool rising) {
+    this->levelTriggers_.push_back({sourceIndex, level, rising});
+  }
+#ifdef USE_BINARY_SENSOR
+  // triggers on the binary sensor changing to state, or on any change if state is not set
+  void add_binary_sensor_trigger(binary_sensor::BinarySensor *sensor, optional<bool> state = {});
+#endif
+#ifdef USE_TEXT_SENSOR
+  // triggers on the text sensor changing to a non-empty state
+  void add_text_sensor_trigger(text_sensor::TextSensor *sensor);
+#endif
+  // freezes the pre-trigger records and starts collecting post-trigger records, if armed, from the main loop only
+  void trigger_capture(const std::string &reason, int64_t micros);
+  void arm_capture();
+
+  // adds an aggregate tier, of bins periods of periodSeconds each
+  void add_aggregate_tier(uint32_t periodSeconds, uint32_t bins) {
+    this->aggregateTiers_.emplace_back(periodSeconds, bins);
+  }
+
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+  void set_flash_log(const std::string &partitionLabel, uint32_t flushIntervalMillis) {
+    this->flashPartition_ = partitionLabel;
+    this->flashFlushIntervalMillis_ = flushIntervalMillis;
+  }
+  // bytes written to flash per second, and the longest loop stall from a flash operation in ms,
+  // over each kFlashStatsIntervalMillis
+  void set_flash_write_rate_sensor(sensor::Sensor *sensor) { this->flashWriteRateSensor_ = sensor; }
+  void set_flash_stall_sensor(sensor::Sensor *sensor) { this->flashStallSensor_ = sensor; }
+#endif
+
+  void setup() override;
+  void loop() override;
   float get_setup_priority() const override {
     // After WiFi
     return setup_priority::WIFI - 1.0f;
@@ -53,19 +273,83 @@ class SampleBuffer : public Component, public AsyncWebHandler {
  protected:
   web_server_base::WebServerBase *base_;
 
-  void new_value(size_t sourceIndex, uint32_t millis, float value, int8_t accuracyDecimals);
+  // adds a source name, returning its source index
+  size_t add_source_name(const std::string &name, int8_t accuracyDecimals);
+  // adds a pair's voltage, current and power sources, returning its pair index
+  size_t init_pair(const std::string &voltageName, int8_t voltageAccuracyDecimals, const std::string &currentName,
+                   int8_t currentAccuracyDecimals, const std::string &powerName, int8_t powerAccuracyDecimals,
+                   uint32_t maxSkewMicros);
+  void new_value(size_t sourceIndex, int64_t micros, float value, int8_t accuracyDecimals);
+  void new_pair_value(size_t pairIndex, bool isCurrent, int64_t micros, float value, int8_t accuracyDecimals);
+
+  // appends the binary format version and sources
+  void append_sources(std::string &out) const;
+  // appends binary format records of the samples from sample index start (which must be readable) up to end,
+  // optionally filtered, returning the next sample index (end, unless the filter's maximum count was reached)
+  uint32_t append_records(std::string &out, uint32_t start, uint32_t end, SampleFilter *filter = nullptr) const;
+  // parses the HTTP API filter parameters, returning false if invalid
+  bool parse_filter(AsyncWebServerRequest *req, SampleFilter *filter) const;
+
+  void handle_capture(AsyncWebServerRequest *req, bool binary);
+  void check_level_triggers(uint8_t sourceIndex, int64_t micros, float value);
+
+  void handle_aggregate(AsyncWebServerRequest *req, bool binary);
 
-  inline void write_sample(AsyncResponseStream *stream, SampleRecord& sample);
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+  void handle_flash_log(AsyncWebServerRequest *req);
+  // encodes new samples into the flash log and does pending flash operations
+  void service_flash_log();
+#endif
+
+  void setup_stream();
+  // encodes and writes new samples to a stream client, returning false if it should be disconnected
+  bool service_stream_client(StreamClient &client);
+  inline void write_sample(std::string &out, const BinarySampleRecord &sample);
 
   std::vector<std::string> names_;  // stores a local copy of names
+  std::vector<int8_t> accuracyDecimals_;  // by source, from the latest sample
+  std::vector<SamplePair> pairs_;
+
+  size_t capacity_ = 4096;
+  bool psram_ = false;
+  // samples are written by new_value from the main loop, and may be read concurrently from other tasks
+  // (the web server) without locking
+  RecordRing ring_;
+
+  uint32_t capturePre_ = 0;
+  uint32_t capturePost_ = 0;
+  std::atomic<uint8_t> captureState_{kCaptureDisabled};
+  std::vector<LevelTrigger> levelTriggers_;
+  // requests from the web server, handled in loop()
+  std::atomic<bool> captureArmRequested_{false};
+  std::atomic<bool> captureTriggerRequested_{false};
+  Mutex captureLock_;  // guards the capture below between the main loop and web server
+  std::string capture_;  // binary format records, pre-trigger then post-trigger
+  uint32_t capturePreCount_ = 0;
+  uint32_t capturePostRemaining_ = 0;
+  int64_t captureTriggerMicros_ = 0;
+  std::string captureReason_;
+
+  std::vector<AggregateTier> aggregateTiers_;  // in order of increasing period
+  Mutex aggregateLock_;  // guards the aggregate tiers between the main loop and web server
+
+#ifdef USE_SAMPLE_BUFFER_FLASH_LOG
+  std::string flashPartition_;
+  uint32_t flashFlushIntervalMillis_ = 10000;
+  std::unique_ptr<FlashLog> flashLog_;
+  FlashBlockEncoder flashEncoder_;
+  uint32_t flashCursor_ = 0;  // next sample index to log
+  bool flashLost_ = false;  // whether samples were overwritten before they could be logged
+  uint32_t flashFlushMillis_ = 0;
+  uint32_t flashStatsMillis_ = 0;
+  uint32_t flashMaxStallMicros_ = 0;
+  sensor::Sensor *flashWriteRateSensor_ = nullptr;
+  sensor::Sensor *flashStallSensor_ = nullptr;
+#endif
 
-  SampleRecord records_[kBufferSize];
-  size_t recordsEnd_ = 0;  // one past the end of records (if recordsOffset_ == 0), or the pointer to the first sample before recordsOffset_
-  size_t recordsOffset_ = 0;  // records_[0] is this sample index
-  // note: if recordsEnd_ == 0 and recordsOffset_ == 0, this means the buffer is empty
-  // if recordsEnd_ != 0 and recordsOffset_ == 0, this means the buffer has recordsEnd_ elements
-  // if recordsOffset_ != 0, this means the buffer wraps around at one before recordsEnd_ and the buffer is full
-  //   at recordsEnd_ (including 0), the sample index is from the last batch (subtract kBufferSize from the expected sample index)
+  uint16_t streamPort_ = 0;
+  std::unique_ptr<socket::Socket> streamSocket_;
+  std::vector<StreamClient> streamClients_;
 };
 
 }
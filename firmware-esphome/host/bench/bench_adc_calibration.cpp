@@ -0,0 +1,60 @@
+// Benchmark of the fused fixed-point ADC calibration against the float and double paths
+//   bench_adc_calibration [--quick]
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "adc_calibration_rig.h"
+
+static double wall_seconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<typename F> static double ns_per_call(const std::vector<int32_t> &counts, F function, double *sink) {
+  double start = wall_seconds();
+  double sum = 0;
+  for (int32_t adcCounts : counts) {
+    sum += function(adcCounts);
+  }
+  *sink += sum;
+  return (wall_seconds() - start) * 1e9 / counts.size();
+}
+
+int main(int argc, char **argv) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  size_t samples = quick ? 100000 : 10000000;
+
+  AdcCalibrationRig rig;
+  std::mt19937 random(1);
+  rig.randomize(random);
+  adc_calibration::PwlTable::Points points;
+  for (size_t i = 0; i < points.size(); i++) {
+    points[i] = (int32_t) (i * 7919 % 2000) - 1000;
+  }
+  rig.calibration.set_table(adc_calibration::kMeasTable, 0, points);
+
+  std::uniform_int_distribution<int32_t> distribution(-(1 << 23), (1 << 23) - 1);
+  std::vector<int32_t> counts(samples);
+  for (auto &adcCounts : counts) {
+    adcCounts = distribution(random);
+  }
+
+  double sink = 0;
+  double fixedNs = ns_per_call(counts, [&](int32_t c) { return rig.calibration.calibrate(rig.sample(c)); }, &sink);
+  double floatNs = ns_per_call(counts, [&](int32_t c) { return rig.float_path(c); }, &sink);
+  double doubleNs = ns_per_call(counts, [&](int32_t c) { return rig.reference(c); }, &sink);
+
+  double fixedError = 0, floatError = 0;
+  for (int32_t adcCounts : counts) {
+    double expected = rig.reference(adcCounts);
+    fixedError = std::max(fixedError, std::fabs(rig.calibration.calibrate(rig.sample(adcCounts)) - expected));
+    floatError = std::max(floatError, std::fabs(rig.float_path(adcCounts) - expected));
+  }
+  printf("calibrate, range 0 with set, common-mode and table corrections, %zu samples (checksum %g)\n", samples,
+         sink);
+  printf("  fixed-point: %.1f ns/sample, max error %.3g uA\n", fixedNs, fixedError * 1e6);
+  printf("  float path: %.1f ns/sample, max error %.3g uA\n", floatNs, floatError * 1e6);
+  printf("  double reference: %.1f ns/sample\n", doubleNs);
+  return 0;
+}
@@ -0,0 +1,247 @@
+// Benchmarks of the MCP3561 conversion scheduler, results ring and driver on the simulated device
+//   bench_mcp3561 [--quick]
+// --quick runs shortened passes (for ctest), without the real-time IRQ mode pass
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+
+#include "mcp3561_rig.h"
+
+using mcp3561::MCP3561;
+
+static double wall_seconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Entry {
+  bool pending_ = true;
+  int8_t priority_ = 0;
+  uint8_t weight_ = 1;
+  uint32_t pass_ = 0;
+  uint32_t selected = 0;
+};
+
+// selection cost, and selection shares against weights with all entries always pending
+static void bench_scheduler(size_t entryCount, uint32_t selections) {
+  std::vector<Entry> entries(entryCount);
+  std::vector<Entry *> pointers;
+  uint32_t totalWeight = 0;
+  for (size_t i = 0; i < entryCount; i++) {
+    entries[i].weight_ = i % 4 + 1;
+    totalWeight += entries[i].weight_;
+    pointers.push_back(&entries[i]);
+  }
+  mcp3561::StrideScheduler<Entry> scheduler;
+  double start = wall_seconds();
+  for (uint32_t i = 0; i < selections; i++) {
+    scheduler.next(pointers)->selected++;
+  }
+  double elapsed = wall_seconds() - start;
+
+  double maxShareError = 0;
+  for (auto &entry : entries) {
+    double expected = (double) selections * entry.weight_ / totalWeight;
+    maxShareError = std::max(maxShareError, std::abs(entry.selected - expected) / expected);
+  }
+  printf("scheduler, %zu entries: %.1f ns/selection, max share error %.3f%%\n", entryCount,
+         elapsed * 1e9 / selections, maxShareError * 100);
+}
+
+// push and pop cost through the results ring, single-threaded and between a producer and consumer thread
+static void bench_ring(uint32_t samples, uint32_t threadedSamples) {
+  mcp3561::SampleRing<mcp3561::Sample> ring;
+  ring.init(mcp3561::kResultsDepth);
+  mcp3561::Sample block[mcp3561::kResultsBlockSize];
+
+  double start = wall_seconds();
+  for (uint32_t i = 0; i < samples; i += mcp3561::kResultsBlockSize) {
+    for (size_t j = 0; j < mcp3561::kResultsBlockSize; j++) {
+      ring.push({nullptr, (int32_t) (i + j), 0, 0, 0});
+    }
+    ring.pop(block, mcp3561::kResultsBlockSize);
+  }
+  double elapsed = wall_seconds() - start;
+  printf("ring, single thread: %.1f ns/sample push and pop\n", elapsed * 1e9 / samples);
+
+  mcp3561::SampleRing<mcp3561::Sample> spsc;
+  spsc.init(mcp3561::kResultsDepth);
+  std::atomic<bool> done{false};
+  uint64_t received = 0;
+  bool ordered = true;
+  start = wall_seconds();
+  std::thread consumer([&]() {
+    int32_t expected = 0;
+    while (true) {
+      bool finished = done;
+      size_t count = spsc.pop(block, mcp3561::kResultsBlockSize);
+      for (size_t i = 0; i < count; i++) {
+        ordered &= block[i].value >= expected;
+        expected = block[i].value + 1;
+      }
+      received += count;
+      if (finished && count == 0) {
+        break;
+      }
+    }
+  });
+  for (uint32_t i = 0; i < threadedSamples; i++) {
+    while (spsc.available() >= spsc.capacity()) {  // wait for the consumer rather than overrun
+      std::this_thread::yield();
+    }
+    spsc.push({nullptr, (int32_t) i, 0, 0, 0});
+  }
+  done = true;
+  consumer.join();
+  elapsed = wall_seconds() - start;
+  printf("ring, producer and consumer threads: %.1f ns/sample, %llu received, %u overruns, %s\n",
+         elapsed * 1e9 / threadedSamples, (unsigned long long) received, spsc.overruns(), ordered ? "in order" : "REORDERED");
+}
+
+// the driver in polling mode on the manual clock, with a 50 us main loop and each sensor requesting conversions at
+// 1 kHz, which saturates the ADC at longer OSRs
+static void bench_polling(const char *name, MCP3561::Osr osr, bool scan, const std::vector<uint8_t> &weights,
+                          int64_t runMicros) {
+  Mcp3561Rig rig(osr);
+  if (scan) {
+    rig.adc.set_scan(0);
+  }
+  const MCP3561::Mux channels[] = {MCP3561::kCh0, MCP3561::kCh2, MCP3561::kCh4, MCP3561::kCh6};
+  for (size_t i = 0; i < weights.size(); i++) {
+    auto *sensor = rig.add_sensor(channels[i], (MCP3561::Mux) (channels[i] + 1), 1);
+    sensor->set_weight(weights[i]);
+  }
+  rig.setup();
+
+  double start = wall_seconds();
+  rig.run(runMicros, 50);
+  double elapsed = wall_seconds() - start;
+
+  uint32_t conversions = rig.device.reads();
+  uint64_t loops = runMicros / 50;
+  printf("%s: %.0f conversions/s (ideal %.0f), %.1f SPI transactions and %.1f bytes/conversion, "
+         "%.2f us host CPU/loop\n",
+         name, conversions * 1e6 / runMicros, 1e6 / rig.device.conversion_micros(),
+         (double) rig.device.transactions() / conversions, (double) rig.device.bytes() / conversions,
+         elapsed * 1e6 / loops);
+  printf("  publishes by weight:");
+  uint32_t coalesced = 0;
+  for (size_t i = 0; i < weights.size(); i++) {
+    printf(" %u: %u", weights[i], rig.sensors[i]->host_publishes());
+    coalesced += rig.sensors[i]->get_coalesced_requests();
+  }
+  printf(", %u coalesced requests\n", coalesced);
+}
+
+// the driver in IRQ mode on the real clock, with the conversion task reading out on the device's data ready
+static void bench_irq(int64_t runMicros) {
+  Mcp3561Rig rig(MCP3561::k256);
+  host::set_manual_clock(false);
+  InternalGPIOPin irqPin;
+  rig.adc.set_irq_pin(&irqPin);
+  rig.device.set_irq_callback([&irqPin]() { irqPin.host_pulse_low(); });
+  auto *sensor0 = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 1);
+  auto *sensor1 = rig.add_sensor(MCP3561::kCh2, MCP3561::kCh3, 1);
+  rig.setup();
+  rig.device.start_irq_thread();
+
+  int64_t end = host::now_micros() + runMicros;
+  int64_t nextUpdate = host::now_micros();
+  while (host::now_micros() < end) {  // a 1 ms main loop, as with a busy ESPHome loop
+    if (host::now_micros() >= nextUpdate) {
+      sensor0->update();
+      sensor1->update();
+      nextUpdate += 1000;
+    }
+    rig.adc.loop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  rig.device.stop_irq_thread();
+  host::stop_tasks();
+
+  auto telemetry = rig.adc.get_telemetry();
+  printf("IRQ mode: %.0f conversions/s (ideal %.0f), data ready to read latency avg %u us, max %u us\n",
+         telemetry.conversionRate, 1e6 / rig.device.conversion_micros(), telemetry.latencyAvgMicros,
+         telemetry.latencyMaxMicros);
+  printf("  histogram:");
+  for (uint8_t i = 0; i < mcp3561::kLatencyBuckets; i++) {
+    printf(" %u", telemetry.latencyHistogram[i]);
+  }
+  printf("\n");
+  host::set_manual_clock(true);
+}
+
+// conversion readout latency (data ready to result hook) on the real clock without the IRQ pin, polled from
+// loop() or from the task, with a main loop that stalls periodically (eg, a blocking display update)
+// the per-channel readout interval plus this latency bounds the delay from a fault to its detection by a hook
+static void bench_readout(const char *name, MCP3561::Osr osr, uint32_t pollIntervalMillis, int64_t runMicros) {
+  Mcp3561Rig rig(osr);
+  host::set_manual_clock(false);
+  rig.adc.set_poll_interval(pollIntervalMillis);
+  auto *voltage = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh2, 10);
+  auto *current = rig.add_sensor(MCP3561::kCh1, MCP3561::kCh2, 10);
+
+  int64_t latencyTotal = 0, latencyMax = 0, intervalMax = 0;
+  uint32_t readouts = 0;
+  std::map<mcp3561::MCP3561Sensor *, int64_t> lastReady;
+  rig.adc.add_result_hook([&](const mcp3561::Sample &sample) {
+    int64_t ready = rig.device.data_ready_micros();
+    int64_t latency = esp_timer_get_time() - ready;
+    latencyTotal += latency;
+    latencyMax = std::max(latencyMax, latency);
+    if (lastReady.count(sample.sensor) > 0) {
+      intervalMax = std::max(intervalMax, ready - lastReady[sample.sensor]);
+    }
+    lastReady[sample.sensor] = ready;
+    readouts++;
+  });
+  rig.setup();
+
+  int64_t start = host::now_micros();
+  int64_t nextUpdate = start, nextStall = start;
+  while (host::now_micros() < start + runMicros) {
+    if (host::now_micros() >= nextUpdate) {
+      voltage->update();
+      current->update();
+      nextUpdate += 10 * 1000;
+    }
+    rig.adc.loop();
+    if (host::now_micros() >= nextStall) {  // 30 ms stall every 100 ms
+      std::this_thread::sleep_for(std::chrono::milliseconds(30));
+      nextStall += 100 * 1000;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  host::stop_tasks();
+  host::set_manual_clock(true);
+
+  printf("%s: readout latency avg %lld us, max %lld us, per-channel readout interval max %lld us "
+         "(conversion %lld us)\n",
+         name, (long long) (readouts > 0 ? latencyTotal / readouts : 0), (long long) latencyMax,
+         (long long) intervalMax, (long long) rig.device.conversion_micros());
+}
+
+int main(int argc, char **argv) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  uint32_t iterations = quick ? 100000 : 10000000;
+  int64_t runMicros = quick ? 1000 * 1000 : 20 * 1000 * 1000;
+
+  bench_scheduler(2, iterations);
+  bench_scheduler(16, iterations);
+  bench_ring(iterations, iterations / 10);  // threads may share a core, with a context switch per block
+  bench_polling("polling, OSR 256, weights 1:1", MCP3561::k256, false, {1, 1}, runMicros);
+  bench_polling("polling, OSR 32, weights 1:1:1:1", MCP3561::k32, false, {1, 1, 1, 1}, runMicros);
+  bench_polling("polling saturated, OSR 2048, weights 1:1", MCP3561::k2048, false, {1, 1}, runMicros);
+  bench_polling("polling saturated, OSR 2048, weights 2:1", MCP3561::k2048, false, {2, 1}, runMicros);
+  bench_polling("polling saturated, OSR 2048, weights 4:2:1", MCP3561::k2048, false, {4, 2, 1}, runMicros);
+  bench_polling("SCAN, OSR 256, 2 channels", MCP3561::k256, true, {1, 1}, runMicros);
+  int64_t readoutMicros = quick ? 1000 * 1000 : 10 * 1000 * 1000;
+  bench_readout("loop polling, OSR 40960, stalling loop", MCP3561::k40960, 0, readoutMicros);
+  bench_readout("task polling 1 ms, OSR 40960, stalling loop", MCP3561::k40960, 1, readoutMicros);
+  if (!quick) {  // telemetry covers a full statistics interval
+    bench_irq((mcp3561::kStatsIntervalMillis + 500) * 1000);
+  }
+  return 0;
+}
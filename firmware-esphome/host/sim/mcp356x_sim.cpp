@@ -0,0 +1,344 @@
+#include "mcp356x_sim.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "esp_timer.h"
+
+namespace sim {
+
+static const uint32_t kOsrValues[16] = {32,   64,   128,   256,   512,   1024,  2048,  4096,
+                                        8192, 16384, 20480, 24576, 40960, 49152, 81920, 98304};
+static const uint8_t kScanChannels = 16;
+
+Mcp356xSim::Mcp356xSim(uint8_t deviceAddress, uint16_t deviceId, double mclkHz) :
+    deviceAddress_(deviceAddress & 0x3), deviceId_(deviceId), mclkHz_(mclkHz) {
+  this->input_ = [](uint8_t mux, int64_t micros) { return 0; };
+  this->reset();
+}
+
+Mcp356xSim::~Mcp356xSim() { this->stop_irq_thread(); }
+
+void Mcp356xSim::set_input(Input input) {
+  std::lock_guard<std::mutex> guard(this->lock_);
+  this->input_ = std::move(input);
+}
+
+void Mcp356xSim::set_irq_callback(std::function<void()> callback) {
+  std::lock_guard<std::mutex> guard(this->lock_);
+  this->irqCallback_ = std::move(callback);
+}
+
+void Mcp356xSim::reset() {  // Table 8-1 register defaults
+  std::fill(std::begin(this->regs_), std::end(this->regs_), 0);
+  this->regs_[CONFIG0] = 0xc0;
+  this->regs_[CONFIG1] = 0x0c;
+  this->regs_[CONFIG2] = 0x8b;
+  this->regs_[IRQ] = 0x73;
+  this->regs_[MUX] = 0x01;
+  this->regs_[GAINCAL] = 0x800000;
+  this->regs_[LOCK] = 0xa5;
+  this->regs_[RESERVED] = this->deviceId_;
+  this->converting_ = false;
+  this->dataReady_ = false;
+}
+
+uint8_t Mcp356xSim::register_bytes(uint8_t address, uint8_t config3) {
+  switch (address) {
+    case ADCDATA:
+      return ((config3 >> 4) & 0x3) == 0 ? 3 : 4;
+    case SCAN:
+    case TIMER:
+    case OFFSETCAL:
+    case GAINCAL:
+    case 0xB:
+    case 0xC:
+      return 3;
+    case RESERVED:
+    case CRCCFG:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
+int64_t Mcp356xSim::dmclk_period_nanos() const {
+  uint8_t prescale = 1 << ((this->regs_[CONFIG1] >> 6) & 0x3);
+  return (int64_t) (4 * prescale * 1e9 / this->mclkHz_);
+}
+
+int64_t Mcp356xSim::conversion_micros() const {
+  uint32_t osr = kOsrValues[(this->regs_[CONFIG1] >> 2) & 0xf];
+  return std::max<int64_t>(osr * this->dmclk_period_nanos() / 1000, 1);
+}
+
+uint32_t Mcp356xSim::reg(uint8_t address) const {
+  std::lock_guard<std::mutex> guard(this->lock_);
+  return this->regs_[address & 0xf];
+}
+
+uint8_t Mcp356xSim::status_byte() const {  // section 6.2.1
+  uint8_t address = this->deviceAddress_;
+  return ((address >> 1) & 1) << 5 | (((address >> 1) & 1) ^ 1) << 4 | (address & 1) << 3 |
+         (this->dataReady_ ? 0 : 1) << 2 | 1 << 1 | 1;
+}
+
+uint8_t Mcp356xSim::scan_first() const { return this->scan_next(kScanChannels); }
+
+uint8_t Mcp356xSim::scan_next(uint8_t channel) const {
+  uint16_t selected = this->regs_[SCAN] & 0xffff;
+  for (uint8_t next = channel == kScanChannels ? 0 : channel + 1; next < kScanChannels; next++) {
+    if (selected & (1 << next)) {
+      return next;
+    }
+  }
+  return kScanChannels;
+}
+
+uint8_t Mcp356xSim::scan_mux(uint8_t channel) {  // Table 5-14
+  if (channel < 8) {  // single-ended
+    return channel << 4 | 0x8;
+  } else if (channel < 12) {  // differential pairs
+    uint8_t positive = (channel - 8) * 2;
+    return positive << 4 | (positive + 1);
+  }
+  static const uint8_t kInternal[4] = {0xde, 0x98, 0xf8, 0x88};  // TEMP, AVDD, VCM, offset
+  return kInternal[channel - 12];
+}
+
+void Mcp356xSim::start_conversion(int64_t now) {
+  this->converting_ = true;
+  this->scanChannel_ = this->scan_first();
+  this->readyMicros_ = now + this->conversion_micros();
+  if (this->regs_[IRQ] & 0x1) {  // EN_STP, conversion start interrupt
+    this->pendingIrqs_++;
+  }
+}
+
+void Mcp356xSim::complete_conversion(int64_t readyMicros) {
+  bool scan = this->scanChannel_ < kScanChannels;
+  uint8_t mux = scan ? scan_mux(this->scanChannel_) : this->regs_[MUX];
+  uint8_t gainCode = (this->regs_[CONFIG2] >> 3) & 0x7;
+  int64_t value = this->input_(mux, readyMicros);
+  value = gainCode == 0 ? value / 3 : value << (gainCode - 1);
+  value = std::min<int64_t>(std::max<int64_t>(value, -(1 << 23)), (1 << 23) - 1);
+
+  if (this->dataReady_) {
+    this->overwritten_++;
+  }
+  this->data_ = value;
+  this->dataReadyMicros_ = readyMicros;
+  this->dataChannel_ = scan ? this->scanChannel_ : 0;
+  this->dataReady_ = true;
+  this->conversions_++;
+  this->pendingIrqs_++;
+}
+
+void Mcp356xSim::advance(int64_t now) {
+  while (this->converting_ && now >= this->readyMicros_) {
+    int64_t readyMicros = this->readyMicros_;
+    this->complete_conversion(readyMicros);
+
+    bool continuous = ((this->regs_[CONFIG3] >> 6) & 0x3) == 0x3;
+    uint8_t nextChannel = kScanChannels;
+    if (this->scanChannel_ < kScanChannels) {
+      nextChannel = this->scan_next(this->scanChannel_);
+    }
+    if (nextChannel < kScanChannels) {  // next channel of the SCAN cycle
+      this->scanChannel_ = nextChannel;
+      this->readyMicros_ = readyMicros + this->conversion_micros();
+    } else if (continuous) {  // next cycle, after the TIMER delay in SCAN mode
+      int64_t delayMicros = 0;
+      if (this->scanChannel_ < kScanChannels) {
+        delayMicros = (int64_t) (this->regs_[TIMER] & 0xffffff) * this->dmclk_period_nanos() / 1000;
+      }
+      this->scanChannel_ = this->scan_first();
+      this->readyMicros_ = readyMicros + delayMicros + this->conversion_micros();
+    } else {  // one-shot, into standby or shutdown by CONV_MODE
+      this->converting_ = false;
+      bool standby = ((this->regs_[CONFIG3] >> 6) & 0x3) == 0x2;
+      this->regs_[CONFIG0] = (this->regs_[CONFIG0] & ~0x3) | (standby ? 0x2 : 0x0);
+    }
+  }
+}
+
+uint32_t Mcp356xSim::adcdata_word() const {  // Figure 5-10 output data formats
+  uint32_t data = (uint32_t) this->data_;
+  switch ((this->regs_[CONFIG3] >> 4) & 0x3) {
+    case 0:  // 24-bit
+      return data & 0xffffff;
+    case 1:  // 24-bit left justified
+      return data << 8;
+    case 2:  // sign extended
+      return data;
+    default:  // channel ID, sign extended to 28 bits
+      return (uint32_t) this->dataChannel_ << 28 | (data & 0x0fffffff);
+  }
+}
+
+void Mcp356xSim::fast_command(uint8_t command) {
+  if (!(this->regs_[IRQ] & 0x2)) {  // EN_FASTCMD
+    return;
+  }
+  int64_t now = esp_timer_get_time();
+  switch (command) {
+    case 0xa:  // start conversion, restarting any in progress
+      this->regs_[CONFIG0] |= 0x3;
+      this->start_conversion(now);
+      break;
+    case 0xb:  // standby
+      this->regs_[CONFIG0] = (this->regs_[CONFIG0] & ~0x3) | 0x2;
+      this->converting_ = false;
+      break;
+    case 0xc:  // shutdown
+      this->regs_[CONFIG0] &= ~0x3;
+      this->converting_ = false;
+      break;
+    case 0xd:  // full shutdown
+      this->regs_[CONFIG0] = 0;
+      this->converting_ = false;
+      break;
+    case 0xe:  // device full reset
+      this->reset();
+      break;
+  }
+}
+
+void Mcp356xSim::select() {
+  std::lock_guard<std::mutex> guard(this->lock_);
+  this->advance(esp_timer_get_time());
+  this->phase_ = kCommand;
+  this->transactions_++;
+}
+
+void Mcp356xSim::deselect() {
+  uint32_t irqs;
+  std::function<void()> callback;
+  {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    this->phase_ = kIdle;
+    irqs = this->pendingIrqs_;
+    this->pendingIrqs_ = 0;
+    callback = this->irqCallback_;
+  }
+  for (uint32_t i = 0; i < irqs && callback; i++) {
+    callback();
+  }
+}
+
+uint8_t Mcp356xSim::transfer(uint8_t data) {
+  std::lock_guard<std::mutex> guard(this->lock_);
+  this->bytes_++;
+  int64_t now = esp_timer_get_time();
+  this->advance(now);
+
+  switch (this->phase_) {
+    case kCommand: {
+      if (((data >> 6) & 0x3) != this->deviceAddress_) {  // not addressed, MISO stays high-Z
+        this->phase_ = kIgnore;
+        return 0xff;
+      }
+      uint8_t status = this->status_byte();
+      uint8_t address = (data >> 2) & 0xf;
+      switch (data & 0x3) {
+        case 0:  // fast command
+          this->fast_command(address);
+          this->phase_ = kIgnore;
+          break;
+        case 1:  // static read
+        case 3:  // incremental read
+          this->address_ = address;
+          this->incremental_ = (data & 0x3) == 3;
+          this->shiftBytes_ = 0;
+          this->phase_ = kRead;
+          break;
+        case 2:  // incremental write
+          this->address_ = address;
+          this->shift_ = 0;
+          this->shiftBytes_ = register_bytes(address, this->regs_[CONFIG3]);
+          this->phase_ = kWrite;
+          break;
+      }
+      return status;
+    }
+    case kRead: {
+      if (this->shiftBytes_ == 0) {  // load the next register, or the same register again for a static read
+        this->shift_ = this->address_ == ADCDATA ? this->adcdata_word() : this->regs_[this->address_];
+        this->shiftBytes_ = register_bytes(this->address_, this->regs_[CONFIG3]);
+      }
+      this->shiftBytes_--;
+      uint8_t out = (this->shift_ >> (8 * this->shiftBytes_)) & 0xff;
+      if (this->shiftBytes_ == 0) {
+        if (this->address_ == ADCDATA && this->dataReady_) {  // data ready clears once the data has been read
+          this->dataReady_ = false;
+          this->reads_++;
+        }
+        if (this->incremental_) {
+          this->address_ = (this->address_ + 1) & 0xf;
+        }
+      }
+      return out;
+    }
+    case kWrite: {
+      this->shift_ = this->shift_ << 8 | data;
+      this->shiftBytes_--;
+      this->registerWrites_++;
+      if (this->shiftBytes_ == 0) {
+        uint8_t address = this->address_;
+        uint32_t value = this->shift_;
+        if (address == CONFIG0) {
+          this->regs_[CONFIG0] = value;
+          if ((value & 0x3) == 0x3) {  // ADC_MODE conversion
+            this->start_conversion(now);
+          } else {
+            this->converting_ = false;
+          }
+        } else if (address != ADCDATA && address != RESERVED && address != 0xb && address != 0xc) {
+          this->regs_[address] = value;
+        }
+        this->address_ = (address + 1) & 0xf;
+        this->shift_ = 0;
+        this->shiftBytes_ = register_bytes(this->address_, this->regs_[CONFIG3]);
+      }
+      return 0;
+    }
+    default:
+      return 0xff;
+  }
+}
+
+void Mcp356xSim::update() {
+  uint32_t irqs;
+  std::function<void()> callback;
+  {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    this->advance(esp_timer_get_time());
+    if (this->phase_ != kIdle) {  // signalled on deselect instead
+      return;
+    }
+    irqs = this->pendingIrqs_;
+    this->pendingIrqs_ = 0;
+    callback = this->irqCallback_;
+  }
+  for (uint32_t i = 0; i < irqs && callback; i++) {
+    callback();
+  }
+}
+
+void Mcp356xSim::start_irq_thread(int64_t periodMicros) {
+  this->irqThreadRunning_ = true;
+  this->irqThread_ = std::thread([this, periodMicros]() {
+    while (this->irqThreadRunning_) {
+      this->update();
+      std::this_thread::sleep_for(std::chrono::microseconds(periodMicros));
+    }
+  });
+}
+
+void Mcp356xSim::stop_irq_thread() {
+  if (this->irqThreadRunning_.exchange(false)) {
+    this->irqThread_.join();
+  }
+}
+
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "esphome/components/spi/spi.h"
+
+namespace sim {
+
+const double kInternalMclkHz = 4915200;  // nominal internal oscillator, the low end of the Table 5-6 data rates
+
+// Simulated MCP356x on the host SPI bus (datasheet DS20006181)
+// Models the register map, the SPI command set (fast commands, static and incremental read, incremental write),
+// the status byte with data ready, OSR- and prescaler-dependent conversion time (the continuous data period,
+// OSR / DMCLK), one-shot and continuous conversion, the output data formats, SCAN mode with the channel ID
+// format and inter-cycle TIMER delay, and the IRQ output (data ready, and optionally conversion start)
+// Conversions complete lazily as the host clock passes their data ready time, on each SPI access or update()
+class Mcp356xSim : public esphome::spi::HostSpiDevice {
+ public:
+  enum Register : uint8_t {
+    ADCDATA = 0x0,
+    CONFIG0 = 0x1,
+    CONFIG1 = 0x2,
+    CONFIG2 = 0x3,
+    CONFIG3 = 0x4,
+    IRQ = 0x5,
+    MUX = 0x6,
+    SCAN = 0x7,
+    TIMER = 0x8,
+    OFFSETCAL = 0x9,
+    GAINCAL = 0xA,
+    LOCK = 0xD,
+    RESERVED = 0xE,
+    CRCCFG = 0xF,
+  };
+
+  // input is the conversion result in signed 24-bit counts at gain 1 (before gain and clamping), of a MUX
+  // selection (VIN+ << 4 | VIN-) at a data ready time
+  using Input = std::function<int32_t(uint8_t mux, int64_t micros)>;
+
+  explicit Mcp356xSim(uint8_t deviceAddress = 1, uint16_t deviceId = 0x000c, double mclkHz = kInternalMclkHz);
+  ~Mcp356xSim() override;
+
+  void set_input(Input input);
+  // called on each IRQ falling edge, outside the device lock
+  void set_irq_callback(std::function<void()> callback);
+
+  // completes conversions up to the current time, firing the IRQ callback as needed
+  void update();
+  // calls update() from a thread every period, so the IRQ fires without SPI accesses (eg, for IRQ mode)
+  void start_irq_thread(int64_t periodMicros = 10);
+  void stop_irq_thread();
+
+  // duration of one conversion in the current configuration
+  int64_t conversion_micros() const;
+  // data ready time of the latest completed conversion
+  int64_t data_ready_micros() const {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->dataReadyMicros_;
+  }
+  uint32_t reg(uint8_t address) const;
+
+  // statistics since construction
+  uint32_t conversions() const { return this->conversions_; }
+  uint32_t overwritten() const { return this->overwritten_; }  // results replaced before being read
+  uint32_t reads() const { return this->reads_; }  // ADCDATA results read
+  uint32_t transactions() const { return this->transactions_; }
+  uint32_t bytes() const { return this->bytes_; }
+  uint32_t register_writes() const { return this->registerWrites_; }  // bytes written to registers
+
+ protected:
+  enum Phase { kIdle, kCommand, kRead, kWrite, kIgnore };
+
+  void select() override;
+  void deselect() override;
+  uint8_t transfer(uint8_t data) override;
+
+  void reset();
+  static uint8_t register_bytes(uint8_t address, uint8_t config3);
+  uint8_t status_byte() const;
+  void fast_command(uint8_t command);
+  void start_conversion(int64_t now);
+  void advance(int64_t now);  // caller must hold lock_
+  void complete_conversion(int64_t readyMicros);  // caller must hold lock_
+  uint8_t scan_first() const;
+  uint8_t scan_next(uint8_t channel) const;  // the next selected SCAN channel after channel, or 16 if none
+  static uint8_t scan_mux(uint8_t channel);
+  uint32_t adcdata_word() const;  // the output data in the configured format, as register_bytes(ADCDATA) bytes
+  int64_t dmclk_period_nanos() const;
+
+  const uint8_t deviceAddress_;
+  const uint16_t deviceId_;
+  const double mclkHz_;
+
+  mutable std::mutex lock_;
+  Input input_;
+  std::function<void()> irqCallback_;
+  uint32_t pendingIrqs_ = 0;  // IRQ edges to signal once the lock is released
+
+  uint32_t regs_[16];
+
+  // conversion state
+  bool converting_ = false;
+  int64_t readyMicros_ = 0;  // of the conversion in progress
+  uint8_t scanChannel_ = 0;  // of the conversion in progress, in SCAN mode
+  int32_t data_ = 0;
+  int64_t dataReadyMicros_ = 0;
+  uint8_t dataChannel_ = 0;
+  bool dataReady_ = false;
+
+  // transaction state
+  Phase phase_ = kIdle;
+  uint8_t address_ = 0;
+  bool incremental_ = false;
+  uint32_t shift_ = 0;  // register value being shifted in or out
+  uint8_t shiftBytes_ = 0;  // bytes of the current register remaining
+
+  std::atomic<uint32_t> conversions_{0};
+  std::atomic<uint32_t> overwritten_{0};
+  std::atomic<uint32_t> reads_{0};
+  std::atomic<uint32_t> transactions_{0};
+  std::atomic<uint32_t> bytes_{0};
+  std::atomic<uint32_t> registerWrites_{0};
+
+  std::thread irqThread_;
+  std::atomic<bool> irqThreadRunning_{false};
+};
+
+}
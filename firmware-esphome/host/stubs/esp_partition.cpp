@@ -0,0 +1,98 @@
+#include "esp_partition.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+static const size_t kEraseSize = 4096;
+
+struct HostPartition {
+  esp_partition_t partition = {};
+  std::vector<uint8_t> data;
+  uint32_t erases = 0;
+};
+
+static std::map<std::string, std::unique_ptr<HostPartition>> partitions;
+
+static HostPartition *host_partition(const esp_partition_t *partition) {
+  auto it = partitions.find(partition->label);
+  return it != partitions.end() && &it->second->partition == partition ? it->second.get() : nullptr;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK:
+      return "ESP_OK";
+    case ESP_ERR_INVALID_ARG:
+      return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_SIZE:
+      return "ESP_ERR_INVALID_SIZE";
+    default:
+      return "ESP_FAIL";
+  }
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+  auto it = partitions.find(label);
+  if (it == partitions.end() || it->second->partition.type != type) {
+    return nullptr;
+  }
+  return &it->second->partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size) {
+  HostPartition *host = host_partition(partition);
+  if (host == nullptr || offset + size > host->data.size()) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(dst, host->data.data() + offset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size) {
+  HostPartition *host = host_partition(partition);
+  if (host == nullptr || offset + size > host->data.size()) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(src);
+  for (size_t i = 0; i < size; i++) {
+    host->data[offset + i] &= bytes[i];
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+  HostPartition *host = host_partition(partition);
+  if (host == nullptr || offset + size > host->data.size()) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (offset % kEraseSize != 0 || size % kEraseSize != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(host->data.data() + offset, 0xff, size);
+  host->erases += size / kEraseSize;
+  return ESP_OK;
+}
+
+namespace host {
+
+const esp_partition_t *add_partition(const char *label, size_t size) {
+  auto host = std::make_unique<HostPartition>();
+  host->partition.type = ESP_PARTITION_TYPE_DATA;
+  host->partition.address = 0;
+  host->partition.size = size;
+  host->partition.erase_size = kEraseSize;
+  strncpy(host->partition.label, label, sizeof(host->partition.label) - 1);
+  host->data.assign(size, 0xff);
+  auto &slot = partitions[label];
+  slot = std::move(host);
+  return &slot->partition;
+}
+
+std::vector<uint8_t> &partition_data(const esp_partition_t *partition) { return host_partition(partition)->data; }
+
+uint32_t partition_erases(const esp_partition_t *partition) { return host_partition(partition)->erases; }
+
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+#include "host.h"
+
+inline int64_t esp_timer_get_time() { return host::now_micros(); }
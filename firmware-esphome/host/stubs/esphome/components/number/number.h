@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace esphome {
+namespace number {
+
+class Number {
+ public:
+  void publish_state(float state) {
+    this->state = state;
+    this->has_state_ = true;
+    for (auto &callback : this->callbacks_) {
+      callback(state);
+    }
+  }
+  void add_on_state_callback(std::function<void(float)> &&callback) { this->callbacks_.push_back(std::move(callback)); }
+  bool has_state() const { return this->has_state_; }
+  const std::string &get_name() const { return this->name_; }
+  void set_name(const std::string &name) { this->name_ = name; }
+
+  float state = NAN;
+
+ protected:
+  std::string name_;
+  bool has_state_ = false;
+  std::vector<std::function<void(float)>> callbacks_;
+};
+
+}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+namespace sensor {
+
+class Filter {
+ public:
+  virtual ~Filter() = default;
+  virtual optional<float> new_value(float value) = 0;
+};
+
+}
+}
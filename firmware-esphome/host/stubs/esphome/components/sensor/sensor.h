@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+namespace sensor {
+
+class Sensor {
+ public:
+  Sensor() = default;
+  explicit Sensor(const std::string &name) : name_(name) {}
+
+  void publish_state(float state) {
+    this->raw_state = state;
+    this->state = state;
+    this->has_state_ = true;
+    this->publishes_++;
+    for (auto &callback : this->callbacks_) {
+      callback(state);
+    }
+  }
+  void add_on_state_callback(std::function<void(float)> &&callback) { this->callbacks_.push_back(std::move(callback)); }
+
+  float get_state() const { return this->state; }
+  float get_raw_state() const { return this->raw_state; }
+  bool has_state() const { return this->has_state_; }
+  const std::string &get_name() const { return this->name_; }
+  void set_name(const std::string &name) { this->name_ = name; }
+  int8_t get_accuracy_decimals() const { return this->accuracy_decimals_; }
+  void set_accuracy_decimals(int8_t accuracyDecimals) { this->accuracy_decimals_ = accuracyDecimals; }
+
+  // host only, number of publish_state calls
+  uint32_t host_publishes() const { return this->publishes_; }
+
+  float state = NAN;
+  float raw_state = NAN;
+
+ protected:
+  std::string name_;
+  int8_t accuracy_decimals_ = 2;
+  bool has_state_ = false;
+  uint32_t publishes_ = 0;
+  std::vector<std::function<void(float)>> callbacks_;
+};
+
+}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esphome/core/hal.h"
+
+namespace esphome {
+namespace spi {
+
+enum BitOrder {
+  BIT_ORDER_LSB_FIRST,
+  BIT_ORDER_MSB_FIRST,
+};
+enum ClockPolarity {
+  CLOCK_POLARITY_LOW = false,
+  CLOCK_POLARITY_HIGH = true,
+};
+enum ClockPhase {
+  CLOCK_PHASE_LEADING,
+  CLOCK_PHASE_TRAILING,
+};
+enum DataRate : uint32_t {
+  DATA_RATE_1MHZ = 1000000,
+  DATA_RATE_8MHZ = 8000000,
+  DATA_RATE_10MHZ = 10000000,
+  DATA_RATE_20MHZ = 20000000,
+  DATA_RATE_40MHZ = 40000000,
+};
+
+// a simulated device on the bus, selected (CS low) for the duration of each transaction
+class HostSpiDevice {
+ public:
+  virtual ~HostSpiDevice() = default;
+  virtual void select() {}
+  virtual void deselect() {}
+  virtual uint8_t transfer(uint8_t data) = 0;
+};
+
+// transfers go to the attached host device, which must be set before use
+template<BitOrder BIT_ORDER, ClockPolarity CLOCK_POLARITY, ClockPhase CLOCK_PHASE, DataRate DATA_RATE>
+class SPIDevice {
+ public:
+  void set_host_device(HostSpiDevice *device) { this->host_device_ = device; }
+
+  void spi_setup() {}
+  void enable() { this->host_device_->select(); }
+  void disable() { this->host_device_->deselect(); }
+  uint8_t transfer_byte(uint8_t data) { return this->host_device_->transfer(data); }
+  void transfer_array(uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      data[i] = this->host_device_->transfer(data[i]);
+    }
+  }
+  void write_byte(uint8_t data) { this->host_device_->transfer(data); }
+  uint8_t read_byte() { return this->host_device_->transfer(0); }
+
+ protected:
+  GPIOPin *cs_ = nullptr;
+  HostSpiDevice *host_device_ = nullptr;
+};
+
+}
+}
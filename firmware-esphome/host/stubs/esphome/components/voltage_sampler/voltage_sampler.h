@@ -0,0 +1,13 @@
+#pragma once
+
+namespace esphome {
+namespace voltage_sampler {
+
+class VoltageSampler {
+ public:
+  virtual ~VoltageSampler() = default;
+  virtual float sample() = 0;
+};
+
+}
+}
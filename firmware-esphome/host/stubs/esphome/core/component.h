@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+
+namespace setup_priority {
+const float BUS = 1000.0f;
+const float IO = 900.0f;
+const float HARDWARE = 800.0f;
+const float DATA = 600.0f;
+const float PROCESSOR = 400.0f;
+const float WIFI = 250.0f;
+const float AFTER_WIFI = 200.0f;
+const float LATE = -100.0f;
+}
+
+class Component {
+ public:
+  virtual ~Component() = default;
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual float get_setup_priority() const { return setup_priority::DATA; }
+
+  void mark_failed() { this->failed_ = true; }
+  bool is_failed() const { return this->failed_; }
+  void status_set_error() { this->error_ = true; }
+  void status_clear_error() { this->error_ = false; }
+  bool status_has_error() const { return this->error_; }
+
+ protected:
+  bool failed_ = false;
+  bool error_ = false;
+};
+
+// the update is called by the host test or benchmark, rather than a scheduler
+class PollingComponent : public Component {
+ public:
+  PollingComponent() = default;
+  explicit PollingComponent(uint32_t updateInterval) : update_interval_(updateInterval) {}
+  virtual void update() = 0;
+  virtual void set_update_interval(uint32_t updateInterval) { this->update_interval_ = updateInterval; }
+  virtual uint32_t get_update_interval() const { return this->update_interval_; }
+
+ protected:
+  uint32_t update_interval_ = 0;
+};
+
+}
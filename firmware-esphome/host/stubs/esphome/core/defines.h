@@ -0,0 +1,3 @@
+#pragma once
+
+// host build, no optional ESPHome features are enabled
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "host.h"
+
+#define IRAM_ATTR
+
+namespace esphome {
+
+inline uint32_t millis() { return host::now_micros() / 1000; }
+inline uint32_t micros() { return host::now_micros(); }
+void delay(uint32_t ms);  // real time, or advances the manual clock
+
+namespace gpio {
+enum InterruptType {
+  INTERRUPT_RISING_EDGE = 1,
+  INTERRUPT_FALLING_EDGE = 2,
+  INTERRUPT_ANY_EDGE = 3,
+};
+}
+
+class GPIOPin {
+ public:
+  virtual ~GPIOPin() = default;
+  virtual void setup() {}
+  virtual bool digital_read() { return this->level_; }
+  virtual void digital_write(bool value) { this->level_ = value; }
+  virtual std::string dump_summary() const { return "host pin"; }
+
+ protected:
+  bool level_ = true;
+};
+
+class InternalGPIOPin : public GPIOPin {
+ public:
+  template<typename T> void attach_interrupt(void (*func)(T *), T *arg, gpio::InterruptType type) {
+    this->isr_ = [func, arg]() { func(arg); };
+  }
+  void detach_interrupt() { this->isr_ = nullptr; }
+
+  // drives the pin low then high, calling the interrupt on the falling edge, eg from a simulated device
+  void host_pulse_low() {
+    this->level_ = false;
+    if (this->isr_) {
+      this->isr_();
+    }
+    this->level_ = true;
+  }
+
+ protected:
+  std::function<void()> isr_;
+};
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "host.h"
+
+namespace esphome {}
+
+#define ESP_LOGE(tag, ...) ::host::log(1, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ::host::log(2, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ::host::log(3, tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ::host::log(3, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ::host::log(4, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ::host::log(5, tag, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...) ::host::log(6, tag, __VA_ARGS__)
+
+#define LOG_PIN(prefix, pin) \
+  if ((pin) != nullptr) { \
+    ESP_LOGCONFIG(TAG, prefix " %s", (pin)->dump_summary().c_str()); \
+  }
+#define LOG_SENSOR(prefix, type, obj) ESP_LOGCONFIG(TAG, "%s%s '%s'", prefix, type, (obj)->get_name().c_str())
+#define LOG_UPDATE_INTERVAL(this) \
+  ESP_LOGCONFIG(TAG, "  Update Interval: %.3fs", this->get_update_interval() / 1000.0f)
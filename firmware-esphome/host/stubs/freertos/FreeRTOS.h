@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// host stand-in for the FreeRTOS types and macros used by the firmware, with a 1 ms tick
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define pdFAIL 0
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY ((TickType_t) 0xffffffff)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+#define portYIELD_FROM_ISR(woken) ((void) (woken))
@@ -0,0 +1,177 @@
+#include "host.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "esphome/core/hal.h"
+#include "esphome/core/preferences.h"
+#include "freertos/task.h"
+
+namespace host {
+
+static const auto kStart = std::chrono::steady_clock::now();
+static std::atomic<bool> manualClock{false};
+static std::atomic<int64_t> manualMicros{0};
+static int logLevel = 2;
+
+int64_t now_micros() {
+  if (manualClock) {
+    return manualMicros;
+  }
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - kStart).count();
+}
+
+void set_manual_clock(bool manual) {
+  if (manual && !manualClock) {
+    manualMicros = now_micros();
+  }
+  manualClock = manual;
+}
+
+void set_micros(int64_t micros) { manualMicros = micros; }
+void advance_micros(int64_t micros) { manualMicros += micros; }
+
+void set_log_level(int level) { logLevel = level; }
+
+void log(int level, const char *tag, const char *format, ...) {
+  if (level > logLevel) {
+    return;
+  }
+  static const char *const kLevels = "?EWIDVV";
+  fprintf(stderr, "[%c][%s] ", kLevels[level], tag);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+// thrown from blocking calls to unwind a task on stop_tasks()
+struct TaskExit {};
+
+}
+
+struct HostTask {
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable notified;
+  uint32_t notifications = 0;
+};
+
+static std::mutex tasksMutex;
+static std::vector<std::unique_ptr<HostTask>> tasks;
+static std::atomic<bool> stopping{false};
+static thread_local HostTask *currentTask = nullptr;
+
+namespace host {
+
+void stop_tasks() {
+  stopping = true;
+  {
+    std::lock_guard<std::mutex> guard(tasksMutex);
+    for (auto &task : tasks) {
+      std::lock_guard<std::mutex> taskGuard(task->mutex);
+      task->notified.notify_all();
+    }
+  }
+  for (auto &task : tasks) {
+    task->thread.join();
+  }
+  std::lock_guard<std::mutex> guard(tasksMutex);
+  tasks.clear();
+  stopping = false;
+}
+
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+  std::lock_guard<std::mutex> guard(tasksMutex);
+  tasks.emplace_back(new HostTask());
+  HostTask *task = tasks.back().get();
+  if (handle != nullptr) {
+    *handle = task;
+  }
+  task->thread = std::thread([task, function, arg]() {
+    currentTask = task;
+    try {
+      function(arg);
+    } catch (const host::TaskExit &) {
+    }
+  });
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+  HostTask *task = currentTask;
+  std::unique_lock<std::mutex> lock(task->mutex);
+  task->notified.wait_for(lock, std::chrono::milliseconds(ticksToWait),
+                          [task]() { return task->notifications > 0 || stopping; });
+  if (stopping) {
+    throw host::TaskExit();
+  }
+  uint32_t notifications = task->notifications;
+  if (clearOnExit) {
+    task->notifications = 0;
+  } else if (notifications > 0) {
+    task->notifications--;
+  }
+  return notifications;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken) {
+  xTaskNotifyGive(task);
+  if (higherPriorityTaskWoken != nullptr) {
+    *higherPriorityTaskWoken = pdTRUE;
+  }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> guard(task->mutex);
+  task->notifications++;
+  task->notified.notify_one();
+  return pdPASS;
+}
+
+TickType_t xTaskGetTickCount() { return host::now_micros() / 1000 / portTICK_PERIOD_MS; }
+
+void vTaskDelay(TickType_t ticks) {
+  TickType_t lastWake = xTaskGetTickCount();
+  vTaskDelayUntil(&lastWake, ticks);
+}
+
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t period) {
+  *previousWakeTime += period;
+  int64_t wakeMicros = (int64_t) *previousWakeTime * portTICK_PERIOD_MS * 1000;
+  while (host::now_micros() < wakeMicros) {
+    if (stopping) {
+      throw host::TaskExit();
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(std::min<int64_t>(wakeMicros - host::now_micros(), 1000)));
+  }
+  if (stopping) {
+    throw host::TaskExit();
+  }
+}
+
+namespace esphome {
+
+static ESPPreferences preferences;
+ESPPreferences *global_preferences = &preferences;
+
+void delay(uint32_t ms) {
+  if (host::manualClock) {
+    host::advance_micros((int64_t) ms * 1000);
+  } else {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// Host platform controls, for tests and benchmarks
+namespace host {
+
+// the clock behind esp_timer_get_time() and millis(), either real (monotonic, from process start, the default)
+// or manual (only advanced explicitly, for deterministic single-threaded runs)
+int64_t now_micros();
+void set_manual_clock(bool manual);
+void set_micros(int64_t micros);  // manual clock only
+void advance_micros(int64_t micros);  // manual clock only
+
+// ends all tasks created with xTaskCreatePinnedToCore (at their next blocking call) and joins them
+void stop_tasks();
+
+// messages at or below the level are printed to stderr: 1 error, 2 warning, 3 info / config, 4 debug, 5 verbose
+void set_log_level(int level);
+void log(int level, const char *tag, const char *format, ...);
+
+}
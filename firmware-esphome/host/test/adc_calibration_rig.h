@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cmath>
+#include <random>
+
+#include "adc_calibration/adc_calibration.h"
+
+// An AdcCalibration of the SMU current measurement shape (three ranges, two set-point compensations and a
+// common-mode compensation), with reference implementations of the calibration in double and in float
+class AdcCalibrationRig {
+ public:
+  static constexpr float kVref = 3.3;
+  static constexpr float kUnitsPerVolt[3] = {1.95, 0.195, 0.0195};
+
+  AdcCalibrationRig() :
+      sensor(mcp3561::MCP3561::kCh0, mcp3561::MCP3561::kCh2),
+      commonModeSensor(mcp3561::MCP3561::kCh1, mcp3561::MCP3561::kCh2),
+      calibration("rig", &sensor, kVref) {
+    for (int i = 0; i < 3; i++) {
+      this->calibration.add_range(kUnitsPerVolt[i], &this->factor[i], &this->offset[i]);
+      this->factor[i].publish_state(1);
+      this->offset[i].publish_state(0);
+    }
+    for (int i = 0; i < 2; i++) {
+      this->calibration.add_set_compensation(&this->setFactor[i], &this->setpoint[i]);
+      this->setFactor[i].publish_state(0);
+      this->setpoint[i].publish_state(0);
+    }
+    this->calibration.set_common_mode(&this->commonModeFactor, &this->commonModeSensor);
+    this->commonModeFactor.publish_state(0);
+    esphome::global_preferences->host_clear();
+    this->calibration.setup();
+  }
+
+  // sets random calibration numbers, of the magnitudes seen in calibration
+  void randomize(std::mt19937 &random) {
+    std::uniform_real_distribution<float> unit(-1, 1);
+    for (int i = 0; i < 3; i++) {
+      this->factor[i].publish_state(1 + 0.05f * unit(random));
+      this->offset[i].publish_state(0.01f * kUnitsPerVolt[i] * unit(random));
+    }
+    for (int i = 0; i < 2; i++) {
+      this->setFactor[i].publish_state(0.01f * unit(random));
+      this->setpoint[i].publish_state(0.5f * unit(random));
+    }
+    this->commonModeFactor.publish_state(0.001f * unit(random));
+    this->commonModeCounts = (1 << 23) * unit(random);
+  }
+
+  // a conversion of the sensor in the rig's range and common-mode counts, as recorded at readout
+  mcp3561::Sample sample(int32_t counts) {
+    return {&this->sensor, counts, 0, 0, NAN, this->commonModeCounts, this->range};
+  }
+
+  // the calibration in double, the reference
+  double reference(int32_t counts) const {
+    double ratio = counts / (double) (1 << 23);
+    double adjusted = ratio;
+    for (int i = 0; i < 2; i++) {
+      adjusted += this->setFactor[i].state * (ratio - (double) this->setpoint[i].state);
+    }
+    adjusted += this->commonModeFactor.state * (this->commonModeCounts / (double) (1 << 23));
+    double value = adjusted * kVref * kUnitsPerVolt[this->range] * this->factor[this->range].state +
+                   this->offset[this->range].state;
+    const adc_calibration::PwlTable &table = this->calibration.get_table(adc_calibration::kMeasTable, this->range);
+    return value + table.correction(counts) / adc_calibration::kNanoPerUnit;
+  }
+
+  // the calibration in float, as applied to the published ratio before fused integer coefficients
+  float float_path(int32_t counts) const {
+    float ratio = counts / (float) (1 << 23);
+    float adjusted = ratio;
+    for (int i = 0; i < 2; i++) {
+      adjusted += this->setFactor[i].state * (ratio - this->setpoint[i].state);
+    }
+    adjusted += this->commonModeFactor.state * (this->commonModeCounts / (float) (1 << 23));
+    float value = adjusted * kVref * kUnitsPerVolt[this->range] * this->factor[this->range].state +
+                  this->offset[this->range].state;
+    const adc_calibration::PwlTable &table = this->calibration.get_table(adc_calibration::kMeasTable, this->range);
+    return value + table.correction(counts) / (float) adc_calibration::kNanoPerUnit;
+  }
+
+  mcp3561::MCP3561Sensor sensor;
+  mcp3561::MCP3561Sensor commonModeSensor;
+  esphome::number::Number factor[3], offset[3], setFactor[2], commonModeFactor;
+  esphome::sensor::Sensor setpoint[2];
+  adc_calibration::AdcCalibration calibration;
+  int8_t range = 0;
+  int32_t commonModeCounts = 0;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// Minimal test runner, each test is a function registered with TEST and run by run_tests()
+namespace check {
+
+struct Test {
+  const char *name;
+  std::function<void()> function;
+};
+
+inline std::vector<Test> &tests() {
+  static std::vector<Test> tests;
+  return tests;
+}
+
+inline int &failures() {
+  static int failures = 0;
+  return failures;
+}
+
+struct Register {
+  Register(const char *name, std::function<void()> function) { tests().push_back({name, std::move(function)}); }
+};
+
+inline int run_tests() {
+  for (auto &test : tests()) {
+    int before = failures();
+    test.function();
+    printf("%s %s\n", failures() == before ? "PASS" : "FAIL", test.name);
+  }
+  printf("%d failures\n", failures());
+  return failures() == 0 ? 0 : 1;
+}
+
+}
+
+#define TEST(name) \
+  static void name(); \
+  static check::Register name##_register(#name, name); \
+  static void name()
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      check::failures()++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(actual, expected) \
+  do { \
+    long long actualValue = (actual); \
+    long long expectedValue = (expected); \
+    if (!(actualValue == expectedValue)) { \
+      printf("  %s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #actual, #expected, \
+             actualValue, expectedValue); \
+      check::failures()++; \
+    } \
+  } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+  do { \
+    double actualValue = (actual); \
+    double expectedValue = (expected); \
+    if (!(std::fabs(actualValue - expectedValue) <= (tolerance))) { \
+      printf("  %s:%d: CHECK_NEAR(%s, %s) failed: %g != %g\n", __FILE__, __LINE__, #actual, #expected, \
+             actualValue, expectedValue); \
+      check::failures()++; \
+    } \
+  } while (0)
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "host.h"
+#include "mcp356x_sim.h"
+#include "mcp3561/mcp3561.h"
+#include "mcp3561/sensor/mcp3561_sensor.h"
+
+// An MCP3561 driver on a simulated device, with sensors updated at their intervals like the ESPHome scheduler,
+// stepped on the manual clock (polling mode) so runs are deterministic
+class Mcp3561Rig {
+ public:
+  // a device address other than the driver's (1) leaves the device unresponsive
+  explicit Mcp3561Rig(mcp3561::MCP3561::Osr osr = mcp3561::MCP3561::k256, uint8_t deviceAddress = 1) :
+      device(deviceAddress), adc(osr) {
+    host::set_manual_clock(true);
+    this->adc.set_host_device(&this->device);
+  }
+
+  mcp3561::MCP3561Sensor *add_sensor(mcp3561::MCP3561::Mux channel, mcp3561::MCP3561::Mux channelNeg,
+                                     uint32_t updateIntervalMillis,
+                                     mcp3561::MCP3561::Gain gain = mcp3561::MCP3561::kX1) {
+    this->sensors.emplace_back(new mcp3561::MCP3561Sensor(channel, channelNeg, gain));
+    auto *sensor = this->sensors.back().get();
+    sensor->set_parent(&this->adc);
+    sensor->set_update_interval(updateIntervalMillis);
+    this->adc.register_sensor(sensor);
+    this->nextUpdateMicros_.push_back(host::now_micros());
+    return sensor;
+  }
+
+  void setup() {
+    this->adc.setup();
+    for (auto &sensor : this->sensors) {
+      sensor->setup();
+    }
+  }
+
+  // runs the main loop for a duration, in steps of the loop period
+  void run(int64_t micros, int64_t loopMicros = 100) {
+    int64_t end = host::now_micros() + micros;
+    while (host::now_micros() < end) {
+      for (size_t i = 0; i < this->sensors.size(); i++) {
+        if (host::now_micros() >= this->nextUpdateMicros_[i]) {
+          this->sensors[i]->update();
+          this->nextUpdateMicros_[i] += (int64_t) this->sensors[i]->get_update_interval() * 1000;
+        }
+      }
+      this->adc.loop();
+      host::advance_micros(loopMicros);
+    }
+  }
+
+  sim::Mcp356xSim device;
+  mcp3561::MCP3561 adc;
+  std::vector<std::unique_ptr<mcp3561::MCP3561Sensor>> sensors;
+
+ protected:
+  std::vector<int64_t> nextUpdateMicros_;
+};
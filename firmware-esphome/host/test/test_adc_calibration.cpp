@@ -0,0 +1,122 @@
+#include "adc_calibration_rig.h"
+#include "check.h"
+
+using adc_calibration::PwlTable;
+
+static const int kCases = 200;
+static const int kCountsPerCase = 200;
+
+// nano-unit values are within coefficient and output rounding of the double reference, in all ranges
+TEST(fixed_point_matches_reference) {
+  AdcCalibrationRig rig;
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int32_t> counts(-(1 << 23), (1 << 23) - 1);
+  double maxError = 0;
+  for (int i = 0; i < kCases; i++) {
+    rig.randomize(random);
+    rig.range = i % 3;
+    for (int j = 0; j < kCountsPerCase; j++) {
+      int32_t adcCounts = j == 0 ? -(1 << 23) : j == 1 ? (1 << 23) - 1 : counts(random);
+      double expected = rig.reference(adcCounts) * adc_calibration::kNanoPerUnit;
+      maxError = std::max(maxError, std::fabs(rig.calibration.calibrate_nano(rig.sample(adcCounts)) - expected));
+    }
+  }
+  CHECK(maxError <= 1.0);
+}
+
+// float values are the nano-unit values rounded to float, more accurate than the float path
+TEST(float_output_more_accurate_than_float_path) {
+  AdcCalibrationRig rig;
+  std::mt19937 random(2);
+  std::uniform_int_distribution<int32_t> counts(-(1 << 23), (1 << 23) - 1);
+  double maxError = 0, maxFloatPathError = 0;
+  for (int i = 0; i < kCases; i++) {
+    rig.randomize(random);
+    rig.range = i % 3;
+    for (int j = 0; j < kCountsPerCase; j++) {
+      int32_t adcCounts = counts(random);
+      double expected = rig.reference(adcCounts);
+      double error = std::fabs(rig.calibration.calibrate(rig.sample(adcCounts)) - expected);
+      double halfUlp = std::ldexp(1.0, std::ilogb(expected) - 24);
+      CHECK(error <= halfUlp + 1e-9);
+      maxError = std::max(maxError, error);
+      maxFloatPathError = std::max(maxFloatPathError, std::fabs(rig.float_path(adcCounts) - expected));
+    }
+  }
+  CHECK(maxError < maxFloatPathError);
+}
+
+TEST(meas_table_applied) {
+  AdcCalibrationRig rig;
+  std::mt19937 random(3);
+  rig.randomize(random);
+  PwlTable::Points points;
+  for (size_t i = 0; i < points.size(); i++) {
+    points[i] = (int32_t) (i * 7919 % 2000) - 1000;  // +/-1 uA
+  }
+  rig.calibration.set_table(adc_calibration::kMeasTable, 0, points);
+  rig.range = 0;
+  std::uniform_int_distribution<int32_t> counts(-(1 << 23), (1 << 23) - 1);
+  for (int j = 0; j < kCountsPerCase; j++) {
+    int32_t adcCounts = counts(random);
+    CHECK_NEAR(rig.calibration.calibrate_nano(rig.sample(adcCounts)), rig.reference(adcCounts) * 1e9, 1.0);
+  }
+  rig.range = 1;  // other ranges unaffected
+  CHECK(rig.calibration.get_table(adc_calibration::kMeasTable, 1).zero);
+}
+
+TEST(no_range_is_nan) {
+  AdcCalibrationRig rig;
+  rig.range = -1;
+  CHECK(std::isnan(rig.calibration.calibrate(rig.sample(1000))));
+  rig.range = 3;
+  CHECK(std::isnan(rig.calibration.calibrate(rig.sample(1000))));
+}
+
+// calibration numbers that aren't (yet) numbers give NaN values rather than undefined integer conversions
+TEST(nan_calibration_is_nan) {
+  AdcCalibrationRig rig;
+  rig.range = 1;
+  rig.factor[1].publish_state(NAN);
+  CHECK(std::isnan(rig.calibration.calibrate(rig.sample(1000))));
+  CHECK_EQ(rig.calibration.calibrate_nano(rig.sample(1000)), INT64_MIN);
+  rig.range = 0;  // other ranges unaffected
+  CHECK(!std::isnan(rig.calibration.calibrate(rig.sample(1000))));
+  rig.factor[1].publish_state(1);
+  rig.range = 1;
+  CHECK_NEAR(rig.calibration.calibrate(rig.sample(1 << 22)), 0.5 * 3.3 * 0.195, 1e-6);
+
+  rig.offset[2].publish_state(NAN);
+  rig.range = 2;
+  CHECK(std::isnan(rig.calibration.calibrate(rig.sample(1000))));
+  rig.offset[2].publish_state(0);
+
+  rig.setpoint[0].publish_state(NAN);  // affects all ranges
+  CHECK(std::isnan(rig.calibration.calibrate(rig.sample(1000))));
+  rig.setpoint[0].publish_state(0);
+  rig.commonModeFactor.publish_state(INFINITY);
+  CHECK(std::isnan(rig.calibration.calibrate(rig.sample(1000))));
+  rig.commonModeFactor.publish_state(0);
+
+  rig.factor[2].publish_state(1e30);  // finite, but not representable in fixed-point
+  CHECK(std::isnan(rig.calibration.calibrate(rig.sample(1000))));
+  rig.factor[2].publish_state(1);
+  CHECK(!std::isnan(rig.calibration.calibrate(rig.sample(1000))));
+}
+
+TEST(meas_inverse_round_trips) {
+  AdcCalibrationRig rig;
+  std::mt19937 random(4);
+  rig.randomize(random);
+  rig.setFactor[0].publish_state(0);  // the inverse is of the uncompensated calibration
+  rig.setFactor[1].publish_state(0);
+  rig.commonModeFactor.publish_state(0);
+  for (int8_t range = 0; range < 3; range++) {
+    rig.range = range;
+    float value = 0.4f * 3.3f * AdcCalibrationRig::kUnitsPerVolt[range];
+    int32_t counts = std::lround(rig.calibration.meas_value_to_ratio(value, range) * (1 << 23));
+    CHECK_NEAR(rig.calibration.calibrate(rig.sample(counts)), value, value * 1e-6);
+  }
+}
+
+int main() { return check::run_tests(); }
@@ -0,0 +1,66 @@
+#include <cmath>
+
+#include "check.h"
+#include "sample_buffer/aggregate_tier.h"
+
+using sample_buffer::AggregateTier;
+
+static const int64_t kSecond = 1000000;
+
+TEST(summarizes_closed_periods) {
+  AggregateTier tier(1, 4);
+  tier.init(2);
+  tier.add(0, 10 * kSecond, 1.0f);
+  tier.add(0, 10 * kSecond + 500000, 3.0f);
+  tier.add(1, 10 * kSecond + 600000, -2.0f);
+  tier.add(0, 12 * kSecond, 5.0f);  // closes 10, and 11 as empty
+
+  CHECK_EQ(tier.open_period(), 12);
+  CHECK_EQ(tier.oldest_period(), 10);
+  CHECK_EQ(tier.bin(10, 0).count, 2);
+  CHECK_NEAR(tier.bin(10, 0).min, 1.0, 0);
+  CHECK_NEAR(tier.bin(10, 0).max, 3.0, 0);
+  CHECK_NEAR(tier.bin(10, 0).mean, 2.0, 0);
+  CHECK_EQ(tier.bin(10, 1).count, 1);
+  CHECK_NEAR(tier.bin(10, 1).mean, -2.0, 0);
+  CHECK_EQ(tier.bin(11, 0).count, 0);
+  CHECK(std::isnan(tier.bin(11, 0).mean));
+}
+
+TEST(non_finite_samples_skipped) {
+  AggregateTier tier(1, 4);
+  tier.init(1);
+  tier.add(0, 10 * kSecond, NAN);  // NaN first, which must not seed min and max
+  tier.add(0, 10 * kSecond + 100000, 4.0f);
+  tier.add(0, 10 * kSecond + 200000, NAN);
+  tier.add(0, 10 * kSecond + 300000, 2.0f);
+  tier.add(0, 10 * kSecond + 400000, INFINITY);
+  tier.add(0, 11 * kSecond, NAN);  // closes 10, though not summarized itself
+  tier.add(0, 11 * kSecond + 500000, NAN);
+  tier.add(0, 12 * kSecond, 1.0f);  // closes 11, with only NaNs
+
+  CHECK_EQ(tier.open_period(), 12);
+  CHECK_EQ(tier.bin(10, 0).count, 2);
+  CHECK_NEAR(tier.bin(10, 0).min, 2.0, 0);
+  CHECK_NEAR(tier.bin(10, 0).max, 4.0, 0);
+  CHECK_NEAR(tier.bin(10, 0).mean, 3.0, 0);
+  CHECK_EQ(tier.bin(11, 0).count, 0);
+  CHECK(std::isnan(tier.bin(11, 0).min));
+  CHECK(std::isnan(tier.bin(11, 0).mean));
+}
+
+TEST(late_non_finite_samples_skipped) {
+  AggregateTier tier(1, 4);
+  tier.init(1);
+  tier.add(0, 10 * kSecond, 1.0f);
+  tier.add(0, 11 * kSecond, 2.0f);  // closes 10
+  tier.add(0, 10 * kSecond + 500000, NAN);  // late, merged into the closed bin
+  tier.add(0, 10 * kSecond + 600000, 3.0f);
+
+  CHECK_EQ(tier.bin(10, 0).count, 2);
+  CHECK_NEAR(tier.bin(10, 0).min, 1.0, 0);
+  CHECK_NEAR(tier.bin(10, 0).max, 3.0, 0);
+  CHECK_NEAR(tier.bin(10, 0).mean, 2.0, 0);
+}
+
+int main() { return check::run_tests(); }
@@ -0,0 +1,103 @@
+#include <cstring>
+
+#include "check.h"
+#include "esp_partition.h"
+#include "sample_buffer/flash_log.h"
+
+using sample_buffer::FlashLog;
+using sample_buffer::kFlashSectorSize;
+
+static const size_t kSectors = 4;
+
+struct __attribute__((packed)) SectorHeader {  // as written by FlashLog
+  uint32_t magic;
+  uint32_t sequence;
+  uint16_t boot;
+};
+
+// a partition with sectors holding the sequence and boot numbers, or negative to leave a sector erased
+static const esp_partition_t *make_log(const std::vector<int> &sequences, const std::vector<int> &boots) {
+  const esp_partition_t *partition = host::add_partition("log", kSectors * kFlashSectorSize);
+  for (size_t sector = 0; sector < sequences.size(); sector++) {
+    if (sequences[sector] < 0) {
+      continue;
+    }
+    SectorHeader header = {sample_buffer::kFlashLogMagic, (uint32_t) sequences[sector], (uint16_t) boots[sector]};
+    esp_partition_write(partition, sector * kFlashSectorSize, &header, sizeof(header));
+  }
+  return partition;
+}
+
+static SectorHeader read_header(const esp_partition_t *partition, size_t sector) {
+  SectorHeader header;
+  esp_partition_read(partition, sector * kFlashSectorSize, &header, sizeof(header));
+  return header;
+}
+
+// begins the log and writes out the header of the sector it continues at
+static FlashLog begin_and_flush() {
+  FlashLog log;
+  CHECK(log.begin("log", "sources"));
+  log.request_flush();
+  for (int i = 0; i < 4; i++) {  // erase, then write
+    log.loop();
+  }
+  return log;
+}
+
+// checks the log continued at sector with sequence and boot, leaving the other sectors' headers as they were
+static void check_resume(const std::vector<int> &sequences, const std::vector<int> &boots, size_t sector,
+                         uint32_t sequence, uint16_t boot) {
+  const esp_partition_t *partition = make_log(sequences, boots);
+  begin_and_flush();
+  SectorHeader header = read_header(partition, sector);
+  CHECK_EQ(header.magic, sample_buffer::kFlashLogMagic);
+  CHECK_EQ(header.sequence, sequence);
+  CHECK_EQ(header.boot, boot);
+  CHECK_EQ(host::partition_erases(partition), 1);
+  for (size_t other = 0; other < sequences.size(); other++) {
+    if (other != sector && sequences[other] >= 0) {
+      CHECK_EQ(read_header(partition, other).sequence, (uint32_t) sequences[other]);
+    }
+  }
+}
+
+TEST(begin_empty) { check_resume({}, {}, 0, 0, 0); }
+
+TEST(begin_unwrapped) {
+  check_resume({0}, {0}, 1, 1, 1);
+  check_resume({0, 1}, {0, 0}, 2, 2, 1);
+  check_resume({0, 1, 2}, {0, 1, 1}, 3, 3, 2);
+}
+
+TEST(begin_full_unwrapped) { check_resume({0, 1, 2, 3}, {0, 0, 0, 0}, 0, 4, 1); }
+
+TEST(begin_wrapped) {
+  check_resume({4, 5, 2, 3}, {1, 2, 0, 1}, 2, 6, 3);
+  check_resume({4, 1, 2, 3}, {2, 0, 1, 1}, 1, 5, 3);
+  check_resume({8, 9, 10, 7}, {3, 3, 3, 2}, 3, 11, 4);
+}
+
+TEST(begin_skips_invalid_sectors) { check_resume({2, -1, 0, 1}, {0, 0, 0, 0}, 1, 3, 1); }
+
+TEST(sectors_advance_when_full) {
+  const esp_partition_t *partition = make_log({0, 1}, {0, 0});
+  FlashLog log = begin_and_flush();
+  std::string block(1000, 'x');
+  uint32_t appended = 0;
+  for (int i = 0; i < 100 && appended < 12; i++) {  // three sectors' worth
+    if (log.append_block(block)) {
+      appended++;
+    }
+    log.loop();
+  }
+  for (int i = 0; i < 8; i++) {
+    log.loop();
+  }
+  CHECK_EQ(read_header(partition, 2).sequence, 2);
+  CHECK_EQ(read_header(partition, 3).sequence, 3);
+  CHECK_EQ(read_header(partition, 0).sequence, 4);
+  CHECK_EQ(log.read_sequence(1), 1);
+}
+
+int main() { return check::run_tests(); }
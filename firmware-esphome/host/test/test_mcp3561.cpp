@@ -0,0 +1,332 @@
+#include "check.h"
+#include "mcp3561_rig.h"
+
+using mcp3561::MCP3561;
+
+// distinct result per input pair, so conversions can be matched to their channel
+static int32_t input_for_mux(uint8_t mux, int64_t micros) { return (mux + 1) * 1000; }
+
+static int32_t expected_counts(MCP3561::Mux channel, MCP3561::Mux channelNeg) {
+  return input_for_mux(channel << 4 | channelNeg, 0);
+}
+
+TEST(setup_configures_device) {
+  Mcp3561Rig rig;
+  rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10);
+  rig.setup();
+  CHECK(!rig.adc.is_failed());
+  CHECK_EQ(rig.device.reg(sim::Mcp356xSim::CONFIG0), 0x22);
+  CHECK_EQ(rig.device.reg(sim::Mcp356xSim::CONFIG1), MCP3561::k256 << 2);
+  CHECK_EQ(rig.device.reg(sim::Mcp356xSim::IRQ), 0x07);
+  CHECK_EQ(rig.device.reg(sim::Mcp356xSim::CONFIG3), 0x80);
+}
+
+TEST(single_sensor_conversions) {
+  Mcp3561Rig rig;
+  rig.device.set_input(input_for_mux);
+  auto *sensor = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10);
+  rig.setup();
+  rig.run(1000 * 1000);
+
+  CHECK_NEAR(sensor->host_publishes(), 100, 1);
+  CHECK_EQ(sensor->rawValue, expected_counts(MCP3561::kCh0, MCP3561::kCh1));
+  CHECK_NEAR(sensor->state, expected_counts(MCP3561::kCh0, MCP3561::kCh1) / (float) (1 << 23), 1e-9);
+  // read out on the first loop after data ready
+  int64_t conversionMicros = sensor->conversionReadyMicros - sensor->conversionStartMicros;
+  CHECK(conversionMicros >= rig.device.conversion_micros());
+  CHECK(conversionMicros <= rig.device.conversion_micros() + 100);
+  CHECK_EQ(rig.device.overwritten(), 0);
+}
+
+TEST(sensors_convert_their_channels) {
+  Mcp3561Rig rig;
+  rig.device.set_input(input_for_mux);
+  auto *sensor0 = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10);
+  auto *sensor1 = rig.add_sensor(MCP3561::kCh4, MCP3561::kAGnd, 10);
+  rig.setup();
+  rig.run(1000 * 1000);
+
+  CHECK_NEAR(sensor0->host_publishes(), 100, 1);
+  CHECK_NEAR(sensor1->host_publishes(), 100, 1);
+  CHECK_EQ(sensor0->rawValue, expected_counts(MCP3561::kCh0, MCP3561::kCh1));
+  CHECK_EQ(sensor1->rawValue, expected_counts(MCP3561::kCh4, MCP3561::kAGnd));
+}
+
+TEST(gain_is_applied) {
+  Mcp3561Rig rig;
+  rig.device.set_input(input_for_mux);
+  auto *sensor = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10, MCP3561::kX4);
+  rig.setup();
+  rig.run(10 * 1000);
+  CHECK_EQ(sensor->rawValue, 4 * expected_counts(MCP3561::kCh0, MCP3561::kCh1));
+}
+
+TEST(weights_share_saturated_adc) {
+  Mcp3561Rig rig(MCP3561::k2048);  // about 600 conversions/s, below the 2 kHz requested
+  auto *sensor0 = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 1);
+  auto *sensor1 = rig.add_sensor(MCP3561::kCh2, MCP3561::kCh3, 1);
+  sensor0->set_weight(2);
+  rig.setup();
+  rig.run(2000 * 1000);
+
+  CHECK_NEAR((double) sensor0->host_publishes() / sensor1->host_publishes(), 2, 0.05);
+  CHECK_NEAR((sensor0->host_publishes() + sensor1->host_publishes()) * 1e6 / 2000000,
+             1e6 / rig.device.conversion_micros(), 30);
+}
+
+TEST(priority_preempts_lower) {
+  Mcp3561Rig rig(MCP3561::k2048);
+  auto *sensor0 = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 1);
+  auto *background = rig.add_sensor(MCP3561::kCh2, MCP3561::kCh3, 1);
+  background->set_priority(-1);
+  rig.setup();
+  rig.run(1000 * 1000);
+
+  CHECK(sensor0->host_publishes() > 500);
+  CHECK(background->host_publishes() <= 1);
+}
+
+TEST(target_rate_without_updates) {
+  Mcp3561Rig rig;
+  auto *sensor0 = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 60000);
+  auto *sensor1 = rig.add_sensor(MCP3561::kCh2, MCP3561::kCh3, 60000);
+  sensor0->set_rate(200);
+  sensor1->set_rate(50);
+  rig.setup();
+  rig.run(1000 * 1000);
+
+  CHECK_NEAR(sensor0->host_publishes(), 200, 2);
+  CHECK_NEAR(sensor1->host_publishes(), 50, 2);
+  CHECK_EQ(sensor0->get_coalesced_requests(), 0);
+}
+
+TEST(target_rate_saturated_by_weight) {
+  Mcp3561Rig rig(MCP3561::k2048);
+  auto *sensor0 = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 60000);
+  auto *sensor1 = rig.add_sensor(MCP3561::kCh2, MCP3561::kCh3, 60000);
+  sensor0->set_rate(5000);
+  sensor1->set_rate(5000);
+  sensor1->set_weight(3);
+  rig.setup();
+  rig.run(2000 * 1000);
+
+  CHECK_NEAR((double) sensor1->host_publishes() / sensor0->host_publishes(), 3, 0.1);
+  CHECK(sensor0->get_coalesced_requests() > 0);
+}
+
+TEST(unchanged_registers_not_rewritten) {
+  Mcp3561Rig rig;
+  auto *sensor = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10);
+  rig.setup();
+  rig.run(100 * 1000);
+  uint32_t writes = rig.device.register_writes();
+  uint32_t publishes = sensor->host_publishes();
+  rig.run(1000 * 1000);
+  CHECK(sensor->host_publishes() > publishes);
+  CHECK_EQ(rig.device.register_writes(), writes);
+}
+
+TEST(scan_mode_maps_channels) {
+  Mcp3561Rig rig;
+  rig.device.set_input(input_for_mux);
+  rig.adc.set_scan(0);
+  auto *sensor0 = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10);
+  auto *sensor1 = rig.add_sensor(MCP3561::kCh2, MCP3561::kAGnd, 10);
+  rig.setup();
+  CHECK(!rig.adc.is_failed());
+  CHECK_EQ(rig.device.reg(sim::Mcp356xSim::SCAN), 1 << 8 | 1 << 2);
+  rig.run(1000 * 1000);
+
+  CHECK_NEAR(sensor0->host_publishes(), 100, 1);
+  CHECK_NEAR(sensor1->host_publishes(), 100, 1);
+  CHECK_EQ(sensor0->rawValue, expected_counts(MCP3561::kCh0, MCP3561::kCh1));
+  CHECK_EQ(sensor1->rawValue, expected_counts(MCP3561::kCh2, MCP3561::kAGnd));
+}
+
+TEST(scan_mode_rejects_unavailable_channel) {
+  Mcp3561Rig rig;
+  rig.adc.set_scan(0);
+  rig.add_sensor(MCP3561::kCh1, MCP3561::kCh2, 10);
+  rig.setup();
+  CHECK(rig.adc.is_failed());
+}
+
+TEST(stream_reads_at_loop_rate) {
+  Mcp3561Rig rig;
+  rig.device.set_input(input_for_mux);
+  rig.adc.set_stream_buffer_size(256);
+  auto *sensor = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10);
+  rig.setup();
+  rig.run(50 * 1000);
+
+  CHECK(rig.adc.start_stream(sensor, MCP3561::k32));
+  uint32_t publishes = sensor->host_publishes();
+  rig.run(10 * 1000);  // conversions are faster than the loop, so only one per loop is read
+  mcp3561::StreamSample samples[256];
+  size_t count = rig.adc.read_stream(samples, 256);
+  CHECK_NEAR(count, 100, 2);
+  CHECK_EQ(samples[0].value, expected_counts(MCP3561::kCh0, MCP3561::kCh1));
+  CHECK(rig.device.overwritten() > 100);
+  CHECK_NEAR(rig.adc.get_stream_overwritten(), rig.device.overwritten(), rig.device.overwritten() * 0.05);
+  CHECK_EQ(sensor->host_publishes(), publishes);
+
+  rig.adc.stop_stream();
+  rig.run(100 * 1000);
+  CHECK(sensor->host_publishes() > publishes);
+  CHECK_EQ(rig.device.reg(sim::Mcp356xSim::CONFIG3), 0x80);
+}
+
+TEST(unresponsive_device_times_out) {
+  Mcp3561Rig rig(MCP3561::k256, 2);
+  auto *sensor = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10);
+  rig.setup();
+  rig.run(mcp3561::kStatsIntervalMillis * 1000 + 1000, 1000);
+
+  CHECK_EQ(sensor->host_publishes(), 0);
+  auto telemetry = rig.adc.get_telemetry();
+  CHECK_NEAR(telemetry.timeouts, mcp3561::kStatsIntervalMillis / mcp3561::kConversionTimeoutMillis, 1);
+  CHECK(telemetry.coalesced > 0);
+}
+
+TEST(telemetry_counts_conversions) {
+  Mcp3561Rig rig;
+  rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10);
+  rig.setup();
+  rig.run(mcp3561::kStatsIntervalMillis * 1000 + 1000);
+
+  auto telemetry = rig.adc.get_telemetry();
+  CHECK_NEAR(telemetry.conversionRate, 100, 1);
+  CHECK_EQ(telemetry.timeouts, 0);
+  CHECK_EQ(telemetry.dropped, 0);
+  // the data read and start command, plus a status-only read on each 100 us loop during the ~210 us conversion
+  CHECK(telemetry.spiTransactionsPerConversion >= 3);
+  CHECK(telemetry.spiTransactionsPerConversion <= 6);
+}
+
+// each conversion is calibrated with the range and common-mode counts recorded at its readout
+TEST(conversion_context_recorded_at_readout) {
+  Mcp3561Rig rig;
+  rig.device.set_input(input_for_mux);
+  auto *voltage = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh2, 10);
+  auto *current = rig.add_sensor(MCP3561::kCh1, MCP3561::kCh2, 10);
+  int8_t range = 0;
+  current->set_range_function([&range]() { return range; });
+  current->set_common_mode_sensor(voltage);
+  std::vector<mcp3561::Sample> calibrated;
+  current->set_calibration([&calibrated](const mcp3561::Sample &sample) {
+    calibrated.push_back(sample);
+    return (float) sample.range;
+  });
+  rig.setup();
+  rig.run(100 * 1000);
+  range = 2;
+  rig.run(100 * 1000);
+
+  CHECK_NEAR(calibrated.size(), 20, 1);
+  size_t rangeChanges = 0;
+  for (size_t i = 1; i < calibrated.size(); i++) {
+    CHECK_EQ(calibrated[i].commonModeValue, expected_counts(MCP3561::kCh0, MCP3561::kCh2));
+    rangeChanges += calibrated[i].range != calibrated[i - 1].range;
+  }
+  CHECK_EQ(rangeChanges, 1);
+  CHECK_EQ(calibrated.back().range, 2);
+  CHECK_EQ(current->conversionRange, 2);
+  CHECK_EQ(current->state, 2);
+}
+
+// integrates every conversion over acquisition time, holding NaNs as zero
+TEST(integral_over_acquisition_time) {
+  Mcp3561Rig rig;
+  int64_t startMicros = host::now_micros();
+  rig.device.set_input([startMicros](uint8_t mux, int64_t micros) {
+    int64_t millis = (micros - startMicros) / 1000;
+    return millis < 500 ? (1 << 20) : millis < 600 ? -1 : (1 << 21);
+  });
+  auto *sensor = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh1, 10);
+  sensor->set_calibration([](const mcp3561::Sample &sample) {
+    return sample.value < 0 ? NAN : sample.value / (float) (1 << 23);
+  });
+  esphome::sensor::Sensor integral;
+  sensor->set_integral_sensor(&integral, 1);
+  rig.setup();
+  rig.run(1000 * 1000);
+
+  CHECK_EQ(integral.host_publishes(), sensor->host_publishes());
+  CHECK_NEAR(integral.state, 0.125 * 0.5 + 0.25 * 0.4, 0.005);
+  sensor->reset_integrals();
+  rig.run(100 * 1000);
+  CHECK_NEAR(integral.state, 0.25 * 0.1, 0.005);
+}
+
+// power pairs each conversion with the latest voltage conversion, energy integrates it over acquisition time
+TEST(power_and_energy_over_acquisition_time) {
+  Mcp3561Rig rig;
+  int64_t startMicros = host::now_micros();
+  rig.device.set_input([startMicros](uint8_t mux, int64_t micros) {
+    if (mux >> 4 == MCP3561::kCh0) {  // voltage, steps up halfway
+      return micros - startMicros < 500 * 1000 ? (1 << 21) : (1 << 22);
+    } else {  // current
+      return 1 << 20;
+    }
+  });
+  auto *voltage = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh2, 10);
+  auto *current = rig.add_sensor(MCP3561::kCh1, MCP3561::kCh2, 10);
+  esphome::sensor::Sensor power, energy;
+  current->set_power_sensor(voltage, &power);
+  current->set_energy_sensor(&energy, 1);
+  rig.setup();
+  rig.run(1000 * 1000);
+
+  CHECK_EQ(power.host_publishes(), current->host_publishes());
+  CHECK_NEAR(power.state, 0.5 * 0.125, 1e-6);
+  CHECK_NEAR(energy.state, 0.25 * 0.125 * 0.5 + 0.5 * 0.125 * 0.5, 0.002);
+  current->reset_integrals();
+  CHECK_EQ(energy.host_publishes(), current->host_publishes());
+  rig.run(100 * 1000);
+  CHECK_NEAR(energy.state, 0.5 * 0.125 * 0.1, 0.002);
+}
+
+// with a publish interval, publishes the mean of the conversions over each interval, with the integral and power,
+// while the integrals and conversion callbacks see every conversion
+TEST(publish_interval_decimates_publishes) {
+  Mcp3561Rig rig;
+  int64_t startMicros = host::now_micros();
+  rig.device.set_input([startMicros](uint8_t mux, int64_t micros) {
+    if (mux >> 4 == MCP3561::kCh0) {  // voltage
+      return 1 << 22;
+    } else {  // current, alternating between conversions
+      return (micros - startMicros) / 10000 % 2 == 0 ? (1 << 20) : (1 << 21);
+    }
+  });
+  auto *voltage = rig.add_sensor(MCP3561::kCh0, MCP3561::kCh2, 10);
+  auto *current = rig.add_sensor(MCP3561::kCh1, MCP3561::kCh2, 10);
+  esphome::sensor::Sensor integral, power, energy;
+  current->set_integral_sensor(&integral, 1);
+  current->set_power_sensor(voltage, &power);
+  current->set_energy_sensor(&energy, 1);
+  current->set_publish_interval(100);
+  uint32_t conversions = 0;
+  int64_t lastMicros = 0;
+  current->add_on_conversion_callback([&](float value, int64_t micros) {
+    CHECK(micros > lastMicros);
+    lastMicros = micros;
+    conversions++;
+  });
+  rig.setup();
+  rig.run(1000 * 1000);
+
+  CHECK_NEAR(conversions, 100, 1);
+  CHECK_NEAR(voltage->host_publishes(), 100, 1);
+  CHECK_NEAR(current->host_publishes(), 10, 1);
+  CHECK_EQ(integral.host_publishes(), current->host_publishes());
+  CHECK_EQ(power.host_publishes(), current->host_publishes());
+  CHECK_EQ(energy.host_publishes(), current->host_publishes());
+  CHECK_NEAR(current->state, 0.1875, 0.02);  // mean of the alternating conversions
+  CHECK_NEAR(current->rawValue, 3 << 19, (1 << 19) / 5);
+  CHECK_NEAR(power.state, 0.5 * 0.1875, 0.01);
+  CHECK_NEAR(integral.state, 0.1875 * 1.0, 0.01);
+  CHECK(current->conversion_micros() < lastMicros);  // center of the last published interval
+  CHECK(current->conversion_micros() > lastMicros - 100 * 1000);
+}
+
+int main() { return check::run_tests(); }
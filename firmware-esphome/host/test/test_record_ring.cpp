@@ -0,0 +1,164 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "sample_buffer/record_ring.h"
+
+using sample_buffer::kBlockRecords;
+using sample_buffer::RecordRing;
+using sample_buffer::SampleRecord;
+
+static const size_t kCapacity = 4 * kBlockRecords;
+static const uint8_t kSources = 5;
+
+// sample n is of source n % kSources with value n, timestamped with a long (escaped) gap every 1000 samples
+static int64_t sample_micros(uint32_t n) { return 1000000 + (int64_t) n * 3 + (int64_t)(n / 1000) * 10000000; }
+
+// starts the sample index at an arbitrary value, as if that many records had been written
+class IndexedRecordRing : public RecordRing {
+ public:
+  void set_next_index(uint32_t index) {
+    this->writeIndex_ = index;
+    this->claimIndex_ = index;
+    this->filled_ = true;
+  }
+};
+
+struct Ring {
+  std::vector<SampleRecord> records = std::vector<SampleRecord>(kCapacity);
+  std::vector<int64_t> keyframes = std::vector<int64_t>(kCapacity / kBlockRecords);
+  IndexedRecordRing ring;
+
+  Ring() { ring.init(records.data(), keyframes.data(), kCapacity); }
+  void append(uint32_t n) { ring.append(n % kSources, sample_micros(n), (float) n); }
+};
+
+struct Sample {
+  uint8_t source;
+  int64_t micros;
+  float value;
+};
+
+// returns whether the samples are consecutive and match their source and timestamp
+static bool consistent(const std::vector<Sample> &samples) {
+  for (size_t i = 0; i < samples.size(); i++) {
+    uint32_t n = (uint32_t) samples[i].value;
+    if ((i > 0 && n != (uint32_t) samples[i - 1].value + 1) || samples[i].source != n % kSources ||
+        samples[i].micros != sample_micros(n)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(read_decodes_across_wrap_and_escapes) {
+  Ring ring;
+  for (uint32_t n = 0; n < 5000; n++) {
+    ring.append(n);
+  }
+  uint32_t end = ring.ring.next_index();
+  CHECK(end > 5000);  // including escape records
+  uint32_t oldest = ring.ring.oldest_index();
+  CHECK_EQ(oldest % kBlockRecords, 0);
+  CHECK(end - oldest <= kCapacity);
+
+  std::vector<Sample> samples;
+  ring.ring.read(oldest, end, [&samples](uint8_t source, int64_t micros, float value) {
+    samples.push_back({source, micros, value});
+    return true;
+  });
+  CHECK(ring.ring.read_valid(oldest));
+  CHECK(!samples.empty());
+  CHECK(consistent(samples));
+  CHECK_EQ((uint32_t) samples.back().value, 4999);
+  CHECK(!ring.ring.read_valid(oldest - kBlockRecords));
+}
+
+TEST(read_across_index_wrap) {
+  Ring ring;
+  const uint32_t kStart = 0xffffffff - 2 * kBlockRecords - 5;  // unaligned, wraps within a block
+  ring.ring.set_next_index(kStart);
+  for (uint32_t n = 0; n < 1000; n++) {  // including an escape record, at sample 0
+    ring.append(n);
+  }
+  uint32_t end = ring.ring.next_index();
+  CHECK(end < kStart);  // wrapped
+  uint32_t oldest = ring.ring.oldest_index();
+  CHECK_EQ(oldest % kBlockRecords, 0);
+  CHECK(end - oldest <= kCapacity && end - oldest > kCapacity - kBlockRecords);
+
+  std::vector<Sample> samples;
+  uint32_t next = ring.ring.read(oldest, end, [&samples](uint8_t source, int64_t micros, float value) {
+    samples.push_back({source, micros, value});
+    return true;
+  });
+  CHECK_EQ(next, end);
+  CHECK(ring.ring.read_valid(oldest));
+  CHECK(!ring.ring.read_valid(oldest - kBlockRecords));  // across the wrap, before the oldest
+  CHECK(samples.size() > kCapacity - kBlockRecords);
+  CHECK(consistent(samples));
+  CHECK_EQ((uint32_t) samples.back().value, 999);
+
+  // and reading from before the wrap, while the oldest is still before it
+  Ring before;
+  before.ring.set_next_index(-(int32_t)(kCapacity + 4));
+  for (uint32_t n = 0; n < 100 + kCapacity; n++) {
+    before.append(n);
+  }
+  oldest = before.ring.oldest_index();
+  CHECK(oldest > before.ring.next_index());  // oldest before the wrap, next after
+  samples.clear();
+  before.ring.read(oldest, before.ring.next_index(), [&samples](uint8_t source, int64_t micros, float value) {
+    samples.push_back({source, micros, value});
+    return true;
+  });
+  CHECK(before.ring.read_valid(oldest));
+  CHECK(consistent(samples));
+  CHECK_EQ((uint32_t) samples.back().value, 99 + kCapacity);
+}
+
+// a writer appending continuously against readers copying out the whole buffer without locking, as the web server
+// does: reads may be rejected by read_valid, but every accepted read must be untorn
+TEST(concurrent_reads_untorn_or_rejected) {
+  const uint32_t kWrites = 4000000;  // values exact in a float
+  Ring ring;
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> accepted{0}, rejected{0}, torn{0};
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 2; i++) {
+    readers.emplace_back([&]() {
+      std::vector<Sample> samples;
+      while (!done.load()) {
+        uint32_t end = ring.ring.next_index();
+        uint32_t start = ring.ring.oldest_index(end);
+        samples.clear();
+        ring.ring.read(start, end, [&samples](uint8_t source, int64_t micros, float value) {
+          samples.push_back({source, micros, value});
+          return true;
+        });
+        if (!ring.ring.read_valid(start)) {
+          rejected++;
+        } else if (!consistent(samples)) {
+          torn++;
+        } else {
+          accepted++;
+        }
+      }
+    });
+  }
+  for (uint32_t n = 0; n < kWrites; n++) {
+    ring.append(n);
+  }
+  done = true;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+
+  printf("  %u accepted, %u rejected reads\n", accepted.load(), rejected.load());
+  CHECK_EQ(torn.load(), 0);
+  CHECK(accepted.load() > 0);
+}
+
+int main() { return check::run_tests(); }
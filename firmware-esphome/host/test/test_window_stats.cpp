@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <deque>
+#include <random>
+
+#include "check.h"
+#include "mcp3561/sensor/window_stats.h"
+
+using window_stats::WindowStatsFilter;
+using window_stats::WindowStatsType;
+
+// starts at an arbitrary value index, eg just before the index wraps
+class IndexedWindowStatsFilter : public WindowStatsFilter {
+ public:
+  IndexedWindowStatsFilter(WindowStatsType type, size_t windowSize, uint32_t startIndex) :
+      WindowStatsFilter(type, windowSize, 1) {
+    this->next_index_ = startIndex;
+  }
+};
+
+// the statistic over the window by brute force, ignoring NaNs
+static float reference(WindowStatsType type, const std::deque<float> &window) {
+  std::vector<float> values;
+  for (float value : window) {
+    if (!std::isnan(value)) {
+      values.push_back(value);
+    }
+  }
+  if (values.empty()) {
+    return NAN;
+  }
+  float min = *std::min_element(values.begin(), values.end());
+  float max = *std::max_element(values.begin(), values.end());
+  double sum = 0, sumSquares = 0;
+  for (float value : values) {
+    sum += value;
+    sumSquares += (double) value * value;
+  }
+  double mean = sum / values.size();
+  switch (type) {
+    case window_stats::kRange:
+      return max - min;
+    case window_stats::kMin:
+      return min;
+    case window_stats::kMax:
+      return max;
+    case window_stats::kMean:
+      return mean;
+    case window_stats::kStdDev:
+      return std::sqrt(std::max(0.0, sumSquares / values.size() - mean * mean));
+    case window_stats::kRms:
+    default:
+      return std::sqrt(sumSquares / values.size());
+  }
+}
+
+static void check_matches_reference(size_t windowSize, uint32_t startIndex) {
+  for (WindowStatsType type : {window_stats::kRange, window_stats::kMin, window_stats::kMax, window_stats::kMean,
+                               window_stats::kStdDev, window_stats::kRms}) {
+    IndexedWindowStatsFilter filter(type, windowSize, startIndex);
+    std::mt19937 random(type);
+    std::uniform_real_distribution<float> distribution(9, 11);  // offset from zero, to exercise the sum offset
+    std::deque<float> window;
+    int mismatches = 0;
+    for (int i = 0; i < 1000; i++) {
+      float value = random() % 10 == 0 ? NAN : distribution(random);
+      window.push_back(value);
+      if (window.size() > windowSize) {
+        window.pop_front();
+      }
+      float expected = reference(type, window);
+      optional<float> result = filter.new_value(value);
+      if (!result.has_value() || std::isnan(*result) != std::isnan(expected) ||
+          (!std::isnan(expected) && std::fabs(*result - expected) > 1e-4)) {
+        mismatches++;
+      }
+    }
+    CHECK_EQ(mismatches, 0);
+  }
+}
+
+TEST(matches_reference) {
+  check_matches_reference(1, 0);
+  check_matches_reference(5, 0);
+  check_matches_reference(8, 0);
+  check_matches_reference(25, 0);
+}
+
+// the slot of a value must keep advancing by one when the value index wraps, for any window size
+TEST(matches_reference_across_index_wrap) {
+  check_matches_reference(5, UINT32_MAX - 100);
+  check_matches_reference(7, UINT32_MAX - 3);
+  check_matches_reference(25, UINT32_MAX - 500);
+}
+
+int main() { return check::run_tests(); }
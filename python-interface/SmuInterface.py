@@ -1,7 +1,10 @@
-from typing import Tuple, Dict, Union, Optional, List, NamedTuple
+from typing import Tuple, Dict, Union, Optional, List, NamedTuple, Iterator
 
+import socket
+import struct
 import requests
 import decimal
+import numpy as np
 
 class SmuInterface:
   device_prefix = 'UsbSMU '
@@ -52,6 +55,15 @@ class SmuInterface:
     kNameCalCurrentSetSourceFactor, kNameCalCurrentSetSinkFactor, kNameCalCurrentCommonFactor
   ]
 
+  # piecewise-linear residual calibration tables, by calibration name, see adc_calibration/table_handler.h
+  kCalTablePaths = {
+    'voltage': '/calibration/voltage',
+    'current': '/calibration/current',
+  }
+  kCalTableTypes = ['meas', 'set']
+  kCalTablePoints = 17
+  kCalTableScale = 1e9  # device table units per unit
+
   def _webapi_name(self, name: str) -> str:
     # TODO should actually replace all non-alphanumeric but this is close enough
     return (self.device_prefix + name).replace(' ', '_').lower()
@@ -154,22 +166,354 @@ class SmuInterface:
     for name, value in cal_dict.items():
       self._set('number', name, value)
 
+  def cal_get_tables(self, name: str) -> Dict[Tuple[str, int], 'SmuCalTable']:
+    """Returns the residual calibration tables of a calibration (by kCalTablePaths key), by table type and range"""
+    resp = requests.get(f'http://{self.addr}{self.kCalTablePaths[name]}')
+    if resp.status_code != 200:
+      raise Exception(f'Request failed: {resp.status_code}')
+    tables = {}
+    for line in resp.text.splitlines():
+      table_type, irange, first, last, points = line.split(' ')
+      tables[(table_type, int(irange))] = SmuCalTable(
+        first=float(first),
+        last=float(last),
+        points=np.array([int(point) for point in points.split(',')]) / self.kCalTableScale
+      )
+    return tables
+
+  def cal_set_tables(self, name: str, tables: Dict[Tuple[str, int], np.ndarray]) -> None:
+    """Sets residual calibration tables of a calibration (by kCalTablePaths key), by table type and range,
+    with kCalTablePoints values each in units (eg volts). All tables are validated before any is set."""
+    params_list = []
+    for (table_type, irange), points in tables.items():
+      assert table_type in self.kCalTableTypes, f'invalid table type {table_type}'
+      assert len(points) == self.kCalTablePoints, f'table requires {self.kCalTablePoints} points'
+      params_list.append({
+        'table': table_type,
+        'range': irange,
+        'points': ','.join(str(int(round(point * self.kCalTableScale))) for point in points)
+      })
+    for params in params_list:
+      resp = requests.post(f'http://{self.addr}{self.kCalTablePaths[name]}', params=params)
+      if resp.status_code != 200:
+        raise Exception(f'Request failed: {resp.status_code}')
+
+  def cal_clear_tables(self, name: str, irange: int) -> None:
+    """Zeroes the residual calibration tables of a calibration range, eg before recalibrating"""
+    zeros = np.zeros(self.kCalTablePoints)
+    self.cal_set_tables(name, {(table_type, irange): zeros for table_type in self.kCalTableTypes})
+
   def sample_buffer(self) -> 'SmuSampleBuffer':
     return SmuSampleBuffer(self)
 
 
+class SmuCalTable(NamedTuple):
+  """A residual calibration table, with uniformly spaced breakpoints from first to last (in calibrated units,
+  without set-point compensation), and the correction at each breakpoint in units.
+  Measurement (meas) tables are added to measurements, set-point (set) tables are output errors subtracted
+  from targets."""
+  first: float
+  last: float
+  points: np.ndarray
+
+
 class SmuSampleRecord(NamedTuple):
   millis: float
   source: str
   value: decimal.Decimal
 
 
+class SmuSampleGap(NamedTuple):
+  """Marks samples lost from a sample stream, because the client fell behind"""
+  lost: int
+
+
+class SmuCapture(NamedTuple):
+  """A triggered capture from the sample buffer, with the pre-trigger samples first."""
+  state: str  # disabled, armed, triggered (collecting post-trigger samples) or complete
+  trigger_millis: Optional[float]
+  reason: str
+  pre_count: int  # number of samples before the trigger
+  sources: List[str]
+  records: np.ndarray  # of SmuSampleBuffer.kBinaryRecordDtype
+
+
+class SmuFlashLogSector(NamedTuple):
+  """A sector of the flash log, in the order written."""
+  sequence: int
+  boot: int  # increments every device boot, timestamps are only comparable within a boot
+  sources: List[str]
+  records: np.ndarray  # of SmuSampleBuffer.kFlashRecordDtype, with gap markers where samples were lost
+
+
 class SmuSampleBuffer:
-  def __init__(self, smu: SmuInterface):
+  # binary /samples format, see sample_buffer.h
+  kBinaryFormatVersion = 3
+  kBinaryRecordDtype = np.dtype([
+    ('millis', '<u4'),
+    ('micros', '<u2'),
+    ('source', 'u1'),
+    ('accuracy_decimals', 'i1'),
+    ('value', '<f4'),
+  ])
+
+  kBinaryAggregateDtype = np.dtype([
+    ('millis', '<u4'),  # period start
+    ('count', '<u4'),
+    ('source', 'u1'),
+    ('accuracy_decimals', 'i1'),
+    ('min', '<f4'),
+    ('max', '<f4'),
+    ('mean', '<f4'),
+  ])
+
+  # flash log format, see flash_log.h
+  kFlashLogMagic = 0x474f4c53
+  kFlashSectorSize = 4096
+  kFlashBlockLost = 0x01
+  kFlashRecordDtype = np.dtype([
+    ('micros', '<i8'),
+    ('source', 'u1'),  # kGapSource marks lost samples
+    ('value', '<f4'),
+  ])
+
+  kCaptureStates = ['disabled', 'armed', 'triggered', 'complete']
+  kGapSource = 0xff  # source index of stream gap markers
+  kStreamPort = 8081
+
+  def __init__(self, smu: SmuInterface, binary: bool = True):
     self._smu = smu
+    self._binary = binary
     self._last_sample: Optional[int] = None
 
   def get(self) -> List[SmuSampleRecord]:
+    if not self._binary:
+      return self._get_text()
+    sources, records = self.get_array()
+    return self._to_records(sources, records)
+
+  @classmethod
+  def _parse_sources(cls, data: bytes) -> Tuple[List[str], int]:
+    """Parses the binary format version and sources, returning the source names and the offset past them."""
+    if data[0] != cls.kBinaryFormatVersion:
+      raise Exception(f'Unknown sample buffer format {data[0]}')
+    offset = 2
+    sources = []
+    for _ in range(data[1]):
+      name_len = data[offset]
+      sources.append(data[offset + 1:offset + 1 + name_len].decode('utf-8'))
+      offset += 1 + name_len
+    return sources, offset
+
+  @staticmethod
+  def _to_records(sources: List[str], records: np.ndarray) -> List[SmuSampleRecord]:
+    millis = records['millis'] + records['micros'] / 1000
+    return [SmuSampleRecord(
+      millis=float(record_millis),
+      source=sources[record['source']],
+      value=decimal.Decimal(f"{record['value']:.{max(record['accuracy_decimals'], 0)}f}")
+    ) for record, record_millis in zip(records, millis)]
+
+  def stream(self, port: int = kStreamPort) -> Iterator[List[Union[SmuSampleRecord, SmuSampleGap]]]:
+    """Connects to the sample stream, yielding the new samples as they are received, in order,
+    with a gap marker where samples were lost."""
+    for sources, records in self.stream_array(port):
+      samples: List[Union[SmuSampleRecord, SmuSampleGap]] = []
+      gaps = np.flatnonzero(records['source'] == self.kGapSource)
+      prev = 0
+      for gap in gaps:
+        samples.extend(self._to_records(sources, records[prev:gap]))
+        samples.append(SmuSampleGap(int(records[gap]['millis'])))
+        prev = gap + 1
+      samples.extend(self._to_records(sources, records[prev:]))
+      yield samples
+
+  def stream_array(self, port: int = kStreamPort) -> Iterator[Tuple[List[str], np.ndarray]]:
+    """Connects to the sample stream, yielding the source names and the new samples as a structured array
+    of kBinaryRecordDtype as they are received, including gap markers (source == kGapSource, with millis
+    the number of samples lost)."""
+    with socket.create_connection((self._smu.addr, port)) as sock:
+      data = b''
+      sources: Optional[List[str]] = None
+      while True:
+        received = sock.recv(65536)
+        if not received:
+          return
+        data += received
+        if sources is None:
+          try:
+            sources, offset = self._parse_sources(data)
+          except IndexError:  # incomplete header
+            continue
+          if len(data) < offset + 4:
+            sources = None
+            continue
+          self._last_sample = int(np.frombuffer(data, dtype='<u4', count=1, offset=offset)[0])
+          data = data[offset + 4:]
+        count = len(data) // self.kBinaryRecordDtype.itemsize
+        records = np.frombuffer(data, dtype=self.kBinaryRecordDtype, count=count)
+        data = data[count * self.kBinaryRecordDtype.itemsize:]
+        if count:
+          yield sources, records
+
+  def get_array(self, max_samples: Optional[int] = None, sources: Optional[List[str]] = None,
+                since_millis: Optional[float] = None, until_millis: Optional[float] = None) \
+      -> Tuple[List[str], np.ndarray]:
+    """Returns the source names and the new samples as a structured array of kBinaryRecordDtype,
+    where the source field indexes into the source names.
+    Optionally limits the number of samples (with the following samples returned on the next call),
+    and filters by source name and timestamp range."""
+    params: Dict[str, Union[str, int, float]] = {'format': 'binary'}
+    if self._last_sample is not None:
+      params['start'] = self._last_sample
+    if max_samples is not None:
+      params['max'] = max_samples
+    if sources is not None:
+      params['sources'] = ','.join(sources)
+    if since_millis is not None:
+      params['since'] = since_millis
+    if until_millis is not None:
+      params['until'] = until_millis
+    resp = requests.get(f'http://{self._smu.addr}/samples', params=params)
+    if resp.status_code != 200:
+      raise Exception(f'Request failed: {resp.status_code}')
+    data = resp.content
+    if not data:
+      raise Exception('Sample buffer underrun')
+    source_names, offset = self._parse_sources(data)
+    offset += 4  # start sample index
+    count = (len(data) - offset - 4) // self.kBinaryRecordDtype.itemsize
+    records = np.frombuffer(data, dtype=self.kBinaryRecordDtype, count=count, offset=offset)
+    next_sample = int(np.frombuffer(data, dtype='<u4', count=1, offset=len(data) - 4)[0])
+
+    started = self._last_sample is not None
+    self._last_sample = next_sample
+    if not started:  # initial get only sets the sample index
+      return source_names, records[:0]
+    return source_names, records
+
+  def get_aggregate(self, period_seconds: Optional[int] = None, sources: Optional[List[str]] = None,
+                    since_millis: Optional[float] = None, until_millis: Optional[float] = None) \
+      -> Tuple[List[str], np.ndarray, int]:
+    """Returns the source names, the per-period min, max and mean of each source as a structured array of
+    kBinaryAggregateDtype (with a count of 0 and NaN statistics for periods without samples), and the start
+    millis of the current incomplete period, which can be passed as since_millis to continue.
+    period_seconds selects the aggregate tier (as configured on the device), by default the shortest."""
+    params: Dict[str, Union[str, int, float]] = {'format': 'binary'}
+    if period_seconds is not None:
+      params['period'] = period_seconds
+    if sources is not None:
+      params['sources'] = ','.join(sources)
+    if since_millis is not None:
+      params['since'] = since_millis
+    if until_millis is not None:
+      params['until'] = until_millis
+    resp = requests.get(f'http://{self._smu.addr}/aggregate', params=params)
+    if resp.status_code != 200:
+      raise Exception(f'Request failed: {resp.status_code}')
+    data = resp.content
+    source_names, offset = self._parse_sources(data)
+    offset += 4  # period seconds
+    count = (len(data) - offset - 4) // self.kBinaryAggregateDtype.itemsize
+    records = np.frombuffer(data, dtype=self.kBinaryAggregateDtype, count=count, offset=offset)
+    next_millis = int(np.frombuffer(data, dtype='<u4', count=1, offset=len(data) - 4)[0])
+    return source_names, records, next_millis
+
+  def get_flash_log(self, start_sequence: int = 0) -> List[SmuFlashLogSector]:
+    """Downloads and decodes the flash log sectors, oldest first, optionally from a sequence number,
+    eg one past the last sector downloaded (though the latest sector may have been partially written)."""
+    resp = requests.get(f'http://{self._smu.addr}/flashlog', params={'start': start_sequence})
+    if resp.status_code != 200:
+      raise Exception(f'Request failed: {resp.status_code}')
+    data = resp.content
+    return [self._decode_flash_sector(data[offset:offset + self.kFlashSectorSize])
+            for offset in range(0, len(data) - self.kFlashSectorSize + 1, self.kFlashSectorSize)]
+
+  @classmethod
+  def _decode_flash_sector(cls, sector: bytes) -> SmuFlashLogSector:
+    magic, sequence, boot = struct.unpack_from('<IIH', sector)
+    if magic != cls.kFlashLogMagic:
+      raise Exception('Invalid flash log sector')
+    sources, offset = cls._parse_sources(sector[10:])
+    offset += 10
+
+    records: List[Tuple[int, int, float]] = []
+    while offset + 12 <= len(sector):
+      length, count, flags, micros = struct.unpack_from('<HBBq', sector, offset)
+      if length == 0xffff:  # erased, end of sector
+        break
+      if flags & cls.kFlashBlockLost:
+        records.append((micros, cls.kGapSource, float('nan')))
+      pos = offset + 12
+      last_bits = [0] * len(sources)
+      for _ in range(count):
+        source = sector[pos]
+        pos += 1
+        zigzag = 0
+        shift = 0
+        while True:
+          byte = sector[pos]
+          pos += 1
+          zigzag |= (byte & 0x7f) << shift
+          shift += 7
+          if not byte & 0x80:
+            break
+        micros += (zigzag >> 1) ^ -(zigzag & 1)
+        layout = sector[pos]
+        pos += 1
+        leading, byte_count = layout >> 4, layout & 0x0f
+        xor_bits = int.from_bytes(sector[pos:pos + byte_count], 'big') << (8 * (4 - leading - byte_count))
+        pos += byte_count
+        last_bits[source] ^= xor_bits
+        records.append((micros, source, struct.unpack('<f', last_bits[source].to_bytes(4, 'little'))[0]))
+      offset += length
+    return SmuFlashLogSector(
+      sequence=sequence,
+      boot=boot,
+      sources=sources,
+      records=np.array(records, dtype=cls.kFlashRecordDtype)
+    )
+
+  def get_capture(self) -> SmuCapture:
+    """Returns the triggered capture, if any, which stays frozen until re-armed."""
+    return self._capture({'format': 'binary'})
+
+  def arm_capture(self) -> None:
+    """Discards the previous capture and waits for a new trigger."""
+    self._capture({'format': 'binary', 'arm': ''}, post=True)
+
+  def trigger_capture(self) -> None:
+    """Triggers a capture, if armed."""
+    self._capture({'format': 'binary', 'trigger': ''}, post=True)
+
+  def _capture(self, params: Dict[str, str], post: bool = False) -> SmuCapture:
+    """Returns the capture, after arming or triggering it with POST requests."""
+    method = requests.post if post else requests.get
+    resp = method(f'http://{self._smu.addr}/capture', params=params)
+    if resp.status_code != 200:
+      raise Exception(f'Request failed: {resp.status_code}')
+    data = resp.content
+    source_names, offset = self._parse_sources(data)
+    state = self.kCaptureStates[data[offset]]
+    trigger_millis = int(np.frombuffer(data, dtype='<u4', count=1, offset=offset + 1)[0])
+    trigger_micros = int(np.frombuffer(data, dtype='<u2', count=1, offset=offset + 5)[0])
+    pre_count = int(np.frombuffer(data, dtype='<u4', count=1, offset=offset + 7)[0])
+    reason_len = data[offset + 11]
+    reason = data[offset + 12:offset + 12 + reason_len].decode('utf-8')
+    offset += 12 + reason_len
+    count = (len(data) - offset) // self.kBinaryRecordDtype.itemsize
+    records = np.frombuffer(data, dtype=self.kBinaryRecordDtype, count=count, offset=offset)
+    triggered = state in ('triggered', 'complete')
+    return SmuCapture(
+      state=state,
+      trigger_millis=trigger_millis + trigger_micros / 1000 if triggered else None,
+      reason=reason,
+      pre_count=pre_count,
+      sources=source_names,
+      records=records
+    )
+
+  def _get_text(self) -> List[SmuSampleRecord]:
     if self._last_sample is None:
       resp = requests.get(f'http://{self._smu.addr}/samples')
       if resp.status_code != 200:
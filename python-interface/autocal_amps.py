@@ -7,7 +7,7 @@ from typing import Tuple, List
 
 
 from SmuInterface import SmuInterface
-from cal_util import regress
+from cal_util import regress, fit_table
 
 
 kOutputFile = 'calibration.csv'
@@ -49,6 +49,8 @@ if __name__ == "__main__":
   parser = argparse.ArgumentParser(prog='SmuCal')
   parser.add_argument('addr', type=str)
   parser.add_argument('irange', type=int, nargs='?', default=0)
+  parser.add_argument('--table', action='store_true',
+                      help='also fit piecewise-linear residual tables, for nonlinearity beyond the linear fit')
   args = parser.parse_args()
 
   smu = SmuInterface(args.addr)
@@ -65,7 +67,9 @@ if __name__ == "__main__":
       sys.exit()
 
   smu.cal_set_current_meas(args.irange, 1, 0)
+  smu.cal_clear_tables('current', args.irange)
   time.sleep(kSetReadDelay)
+  table = smu.cal_get_tables('current')[('meas', args.irange)]  # breakpoints with the cleared calibration
 
   cal_table = kCalPoints[args.irange]
   with open(kOutputFile, 'w', newline='') as csvfile:
@@ -112,6 +116,7 @@ if __name__ == "__main__":
         csvfile.flush()
 
         meas_current_cal_data.append((meas_current, Decimal(user_data)))
+        set_current_cal_data.append((Decimal(set_current_max), Decimal(user_data)))  # points are current-limited
 
     smu.enable(False)
 
@@ -120,6 +125,18 @@ if __name__ == "__main__":
     meas_cal_factor, meas_cal_offset = regress(
       [float(pt[0]) for pt in meas_current_cal_data], [float(pt[1]) for pt in meas_current_cal_data])
 
+    tables = {}
+    if args.table:  # residuals after the linear calibration, at the breakpoints with the new calibration
+      first, last = (table.first * meas_cal_factor + meas_cal_offset, table.last * meas_cal_factor + meas_cal_offset)
+      print("Current meas table")
+      meas_xs = [float(pt[0]) * meas_cal_factor + meas_cal_offset for pt in meas_current_cal_data]
+      tables[('meas', args.irange)] = fit_table(
+        meas_xs, [float(pt[1]) - x for pt, x in zip(meas_current_cal_data, meas_xs)], first, last, len(table.points))
+      print("Current set table")
+      set_xs = [float(pt[0]) * meas_cal_factor + meas_cal_offset for pt in set_current_cal_data]
+      tables[('set', args.irange)] = fit_table(
+        set_xs, [float(pt[1]) - x for pt, x in zip(set_current_cal_data, set_xs)], first, last, len(table.points))
+
   while True:
     print('Commit to device? [y/n]: ', end='')
     user_data = input()
@@ -129,4 +146,6 @@ if __name__ == "__main__":
       sys.exit()
 
   smu.cal_set_current_meas(args.irange, meas_cal_factor, meas_cal_offset)
+  if tables:
+    smu.cal_set_tables('current', tables)
   print("Wrote device calibration. Allow 5 seconds to commit to flash before power cycling.")
@@ -6,7 +6,7 @@ from decimal import Decimal
 from typing import Tuple, List
 
 from SmuInterface import SmuInterface
-from cal_util import regress
+from cal_util import regress, fit_table
 
 
 kOutputFile = 'calibration.csv'
@@ -46,6 +46,8 @@ kVoltageCalPoints = [  # as voltage, current min, current max
 if __name__ == "__main__":
   parser = argparse.ArgumentParser(prog='SmuCal')
   parser.add_argument('addr', type=str)
+  parser.add_argument('--table', action='store_true',
+                      help='also fit piecewise-linear residual tables, for nonlinearity beyond the linear fit')
   args = parser.parse_args()
 
   smu = SmuInterface(args.addr)
@@ -62,7 +64,9 @@ if __name__ == "__main__":
       sys.exit()
 
   smu.cal_set_voltage_meas(1, 0)
+  smu.cal_clear_tables('voltage', 0)
   time.sleep(kSetReadDelay)
+  table = smu.cal_get_tables('voltage')[('meas', 0)]  # breakpoints with the cleared calibration
 
   with open(kOutputFile, 'w', newline='') as csvfile:
     csvwriter = csv.writer(csvfile, delimiter=',', quoting=csv.QUOTE_MINIMAL)
@@ -73,6 +77,7 @@ if __name__ == "__main__":
 
     cal_rows = []
     meas_voltage_cal_data: List[Tuple[Decimal, Decimal]] = []  # device-measured, external-measured (reference)
+    set_voltage_cal_data: List[Tuple[float, Decimal]] = []  # setpoint, external-measured (reference)
 
     enabled = False
     for calibration_point in kVoltageCalPoints:
@@ -102,6 +107,7 @@ if __name__ == "__main__":
         csvfile.flush()
 
         meas_voltage_cal_data.append((meas_voltage, Decimal(user_input)))
+        set_voltage_cal_data.append((set_voltage, Decimal(user_input)))
 
     smu.enable(False)
 
@@ -110,6 +116,18 @@ if __name__ == "__main__":
     meas_cal_factor, meas_cal_offset = regress(
       [float(pt[0]) for pt in meas_voltage_cal_data], [float(pt[1]) for pt in meas_voltage_cal_data])
 
+    tables = {}
+    if args.table:  # residuals after the linear calibration, at the breakpoints with the new calibration
+      first, last = (table.first * meas_cal_factor + meas_cal_offset, table.last * meas_cal_factor + meas_cal_offset)
+      print("Voltage meas table")
+      meas_xs = [float(pt[0]) * meas_cal_factor + meas_cal_offset for pt in meas_voltage_cal_data]
+      tables[('meas', 0)] = fit_table(
+        meas_xs, [float(pt[1]) - x for pt, x in zip(meas_voltage_cal_data, meas_xs)], first, last, len(table.points))
+      print("Voltage set table")
+      set_xs = [float(pt[0]) * meas_cal_factor + meas_cal_offset for pt in set_voltage_cal_data]
+      tables[('set', 0)] = fit_table(
+        set_xs, [float(pt[1]) - x for pt, x in zip(set_voltage_cal_data, set_xs)], first, last, len(table.points))
+
   while True:
     print('Commit to device? [y/n]: ', end='')
     user_input = input()
@@ -119,4 +137,6 @@ if __name__ == "__main__":
       sys.exit()
 
   smu.cal_set_voltage_meas(meas_cal_factor, meas_cal_offset)
+  if tables:
+    smu.cal_set_tables('voltage', tables)
   print("Wrote device calibration. Allow 5 seconds to commit to flash before power cycling.")
@@ -10,3 +10,30 @@ def regress(xs: List[float], ys: List[float]) -> (float, float):
     predict = slope * float(x) + intercept
     print(f"  {y} => {predict:.4f} ({predict - y:.4f}, {(predict - y) / predict * 100:.2f}%)")
   return slope, intercept
+
+
+def fit_table(xs: List[float], ys: List[float], first: float, last: float, points: int,
+              smoothing: float = 1e-3) -> np.ndarray:
+  """fits a piecewise-linear table of ys over xs, with uniformly spaced breakpoints from first to last,
+  returning the value at each breakpoint and printing stats.
+  Breakpoints without nearby data hold the value of their neighbors, by a small penalty on the table slope, so
+  residuals aren't extrapolated past the calibration points."""
+  xs_array = np.array(xs, dtype=float)
+  ys_array = np.array(ys, dtype=float)
+  position = np.clip((xs_array - first) / (last - first) * (points - 1), 0, points - 1)
+  segment = np.minimum(position.astype(int), points - 2)
+  fraction = position - segment
+  basis = np.zeros((len(xs_array), points))  # linear interpolation weights of each breakpoint per data point
+  basis[np.arange(len(xs_array)), segment] = 1 - fraction
+  basis[np.arange(len(xs_array)), segment + 1] = fraction
+  slope = np.zeros((points - 1, points))
+  for i in range(points - 1):
+    slope[i, i:i + 2] = [-1, 1]
+  scale = max(float(np.max(np.abs(ys_array))), 1e-12) if len(ys_array) else 1
+  table, *_ = np.linalg.lstsq(np.vstack([basis, slope * np.sqrt(smoothing)]),
+                              np.concatenate([ys_array, np.zeros(points - 1)]), rcond=None)
+  predict = basis @ table
+  print(f"  table {np.array2string(table, precision=6)}, sse={np.sum((predict - ys_array) ** 2)}")
+  for (x, y, p) in zip(xs_array, ys_array, predict):
+    print(f"  {x}: {y:.6f} => {p:.6f} ({p - y:.6f}, {(p - y) / scale * 100:.2f}% of max)")
+  return table
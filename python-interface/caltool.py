@@ -2,9 +2,14 @@ import argparse
 import json
 from decimal import Decimal
 
+import numpy as np
+
 from SmuInterface import SmuInterface
 
 
+kTablePrefix = 'table '
+
+
 if __name__ == "__main__":
   parser = argparse.ArgumentParser(prog='SmuCal')
   parser.add_argument('addr', type=str)
@@ -23,6 +28,11 @@ if __name__ == "__main__":
   print("Current calibration:")
   for key, value in cal_dict.items():
     print(f"  {key}: {value}")
+  cal_tables = {name: smu.cal_get_tables(name) for name in smu.kCalTablePaths}
+  for name, tables in cal_tables.items():
+    for (table_type, irange), table in tables.items():
+      if table.points.any():
+        print(f"  {name} {table_type} table {irange}: {table.points}")
 
   assert not args.restore or not args.dump, "cannot simultaneously dump and restore"
   filename = f"{args.name_prefix}_{mac_postfix}.json"
@@ -31,14 +41,24 @@ if __name__ == "__main__":
     assert args.name_prefix, "name_prefix required"
     with open(filename, 'r') as f:
       cal_str_dict = json.load(f)
-    cal_dict = {key: Decimal(value) for key, value in cal_str_dict.items()}
+    cal_dict = {key: Decimal(value) for key, value in cal_str_dict.items() if not key.startswith(kTablePrefix)}
     smu.cal_set_all(cal_dict)
+    for name in smu.kCalTablePaths:  # tables are stored as 'table (name) (type) (range)': comma-separated points
+      tables = {}
+      for key, value in cal_str_dict.items():
+        key_split = key.split(' ')
+        if key.startswith(kTablePrefix) and key_split[1] == name:
+          tables[(key_split[2], int(key_split[3]))] = np.array([float(point) for point in value.split(',')])
+      smu.cal_set_tables(name, tables)
 
     print(f"Restored from {filename}")
 
   if args.dump:
     assert args.name_prefix, "name_prefix required"
     cal_str_dict = {key: str(value) for key, value in cal_dict.items()}
+    for name, tables in cal_tables.items():
+      for (table_type, irange), table in tables.items():
+        cal_str_dict[f"{kTablePrefix}{name} {table_type} {irange}"] = ','.join(str(point) for point in table.points)
     jsonstr = json.dumps(cal_str_dict, indent=2)
     with open(filename, 'w') as f:
       f.write(jsonstr)
@@ -4,13 +4,13 @@ import sys
 import time
 from typing import List, Tuple, Optional
 import decimal
+import numpy as np
 
-from SmuInterface import SmuInterface
+from SmuInterface import SmuInterface, SmuSampleGap
 
 
-kCsvCols = ['s', 'V', 'A', 'Ah', 'J']
-kAggregateMillis = 150  # max ms to consider samples part of the same row
-kNewRowCols = ['V', 'A']  # when a new sample overwrites one of these cols, starts a new row
+kCsvCols = ['s', 'V', 'A', 'W', 'Ah', 'J']
+kPairCols = ['V', 'A', 'W']  # recorded with the same timestamp per conversion cycle, a new timestamp starts a new row
 
 
 if __name__ == "__main__":
@@ -19,6 +19,9 @@ if __name__ == "__main__":
   parser.add_argument('name_prefix', type=str)
   parser.add_argument('--delay_on', action='store_true', help="don't store until current is non-NaN")
   parser.add_argument('--auto_stop', action='store_true', help="stop on first current NaN")
+  parser.add_argument('--stream', action='store_true', help="receive samples as they are recorded, instead of polling")
+  parser.add_argument('--period', type=int,
+                      help="log the device-side min, max and mean per period of this many seconds, instead of samples")
 
   args = parser.parse_args()
 
@@ -29,10 +32,41 @@ if __name__ == "__main__":
   mac_postfix = mac.replace(':', '').lower()
 
   samplebuf = smu.sample_buffer()
-  assert samplebuf.get() == []  # initial get to set the sample index, should be empty
+  if not args.stream:
+    assert samplebuf.get() == []  # initial get to set the sample index, should be empty
+
+  def sample_batches():
+    if args.stream:
+      yield from samplebuf.stream()
+    else:
+      while True:
+        yield samplebuf.get()
+        time.sleep(1)
 
   filename = f"{args.name_prefix}_{mac_postfix}.csv"
 
+  if args.period is not None:
+    with open(filename, 'w', newline='') as csvfile:
+      csvwriter = csv.writer(csvfile, delimiter=',', quoting=csv.QUOTE_MINIMAL)
+      csvwriter.writerow(['s'] + [f'{col}_{stat}' for col in kCsvCols[1:] for stat in ['min', 'max', 'mean']])
+      csvfile.flush()
+
+      since_millis: Optional[int] = None
+      start_millis: Optional[int] = None
+      while True:
+        sources, records, since_millis = samplebuf.get_aggregate(args.period, since_millis=since_millis)
+        for period_millis in np.unique(records['millis']):
+          if start_millis is None:
+            start_millis = period_millis
+          row = [decimal.Decimal(int(period_millis) - start_millis) / 1000] + [''] * (len(kCsvCols) - 1) * 3
+          for record in records[records['millis'] == period_millis]:
+            if record['count'] > 0 and sources[record['source']] in kCsvCols:
+              col = kCsvCols.index(sources[record['source']]) - 1
+              row[1 + col * 3:4 + col * 3] = [record['min'], record['max'], record['mean']]
+          csvwriter.writerow(row)
+        csvfile.flush()
+        time.sleep(args.period)
+
   with open(filename, 'w', newline='') as csvfile:
     csvwriter = csv.writer(csvfile, delimiter=',', quoting=csv.QUOTE_MINIMAL)
     csvwriter.writerow(kCsvCols)
@@ -44,11 +78,11 @@ if __name__ == "__main__":
     start_millis: Optional[int] = None
     last_row: Optional[Tuple[int, List[str]]] = None
 
-    done = False
-
-    while not done:
-      samples = samplebuf.get()
+    for samples in sample_batches():
       for sample in samples:
+        if isinstance(sample, SmuSampleGap):
+          print(f"Gap: {sample.lost} samples lost")
+          continue
         if not samples_valid:
           if sample.source == 'A' and not sample.value.is_nan():
             print("Start recording")
@@ -58,23 +92,24 @@ if __name__ == "__main__":
         if samples_valid:
           if sample.source == 'A' and sample.value.is_nan() and args.auto_stop:
             print("Done")
-            done = True
             sys.exit(0)
 
         sample_col = kCsvCols.index(sample.source)
 
         if start_millis is None:
           start_millis = sample.millis
-        if last_row is not None and ((last_row[0] + kAggregateMillis < sample.millis)
-          or (last_row[1][sample_col] != '' and sample.source in kNewRowCols)):
-          csvwriter.writerow([decimal.Decimal(last_row[0] - start_millis) / 1000] + last_row[1][1:])
-          last_row = None
+        # other cols are filled into the latest row
+        if last_row is not None and sample.source in kPairCols and last_row[0] != sample.millis:
+          if any(last_row[1][kCsvCols.index(col)] != '' for col in kPairCols):
+            csvwriter.writerow([decimal.Decimal(last_row[0] - start_millis) / 1000] + last_row[1][1:])
+            last_row = None
+          else:  # row of only other cols, takes the pair timestamp
+            last_row = (sample.millis, last_row[1])
         if last_row is None:
           last_row = (sample.millis, [''] * len(kCsvCols))
         last_row[1][sample_col] = sample.value
 
       csvfile.flush()
 
-      if samples:
+      if samples and not args.stream:
         print(f"Got {len(samples)} samples")
-      time.sleep(1)
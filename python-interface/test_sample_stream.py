@@ -0,0 +1,101 @@
+import decimal
+import struct
+import unittest
+from typing import List
+from unittest import mock
+
+from SmuInterface import SmuInterface, SmuSampleBuffer, SmuSampleRecord, SmuSampleGap
+
+
+class FakeSocket:
+  """Returns the given chunks from recv, then end of stream."""
+  def __init__(self, chunks: List[bytes]):
+    self._chunks = list(chunks)
+
+  def recv(self, size: int) -> bytes:
+    if not self._chunks:
+      return b''
+    chunk = self._chunks.pop(0)
+    assert len(chunk) <= size
+    return chunk
+
+  def __enter__(self):
+    return self
+
+  def __exit__(self, *args):
+    pass
+
+
+def header(sources: List[str], start: int) -> bytes:
+  data = bytes([SmuSampleBuffer.kBinaryFormatVersion, len(sources)])
+  for source in sources:
+    data += bytes([len(source)]) + source.encode('utf-8')
+  return data + struct.pack('<I', start)
+
+
+def record(millis: int, micros: int, source: int, decimals: int, value: float) -> bytes:
+  return struct.pack('<IHBbf', millis, micros, source, decimals, value)
+
+
+def split(data: bytes, size: int) -> List[bytes]:
+  return [data[i:i + size] for i in range(0, len(data), size)]
+
+
+class SampleStreamTestCase(unittest.TestCase):
+  kSources = ['Meas Voltage', 'Meas Current']
+  kRecords = record(1000, 250, 0, 3, 1.5) + record(1000, 500, 1, 4, -0.25) + \
+             record(42, 0, SmuSampleBuffer.kGapSource, 0, 0) + \
+             record(1001, 0, 1, 4, 0.125)
+
+  def stream(self, chunks: List[bytes], method: str = 'stream') -> list:
+    buffer = SmuSampleBuffer(SmuInterface('smu.local'))
+    with mock.patch('SmuInterface.socket.create_connection', return_value=FakeSocket(chunks)) as connect:
+      results = list(getattr(buffer, method)())
+    connect.assert_called_once_with(('smu.local', SmuSampleBuffer.kStreamPort))
+    self.assertEqual(buffer._last_sample, 17)
+    return results
+
+  def test_records_and_gap(self):
+    results = self.stream([header(self.kSources, 17) + self.kRecords])
+    self.assertEqual(results, [[
+      SmuSampleRecord(1000.25, 'Meas Voltage', decimal.Decimal('1.500')),
+      SmuSampleRecord(1000.5, 'Meas Current', decimal.Decimal('-0.2500')),
+      SmuSampleGap(42),
+      SmuSampleRecord(1001.0, 'Meas Current', decimal.Decimal('0.1250')),
+    ]])
+
+  def test_split_header_and_records(self):
+    # chunks that split the header, start index and records must be reassembled in order
+    for size in [1, 3, 7, 13]:
+      with self.subTest(size=size):
+        results = self.stream(split(header(self.kSources, 17) + self.kRecords, size))
+        samples = [sample for chunk in results for sample in chunk]
+        self.assertEqual(samples, [
+          SmuSampleRecord(1000.25, 'Meas Voltage', decimal.Decimal('1.500')),
+          SmuSampleRecord(1000.5, 'Meas Current', decimal.Decimal('-0.2500')),
+          SmuSampleGap(42),
+          SmuSampleRecord(1001.0, 'Meas Current', decimal.Decimal('0.1250')),
+        ])
+
+  def test_array(self):
+    results = self.stream(split(header(self.kSources, 17) + self.kRecords, 24), 'stream_array')
+    for sources, _ in results:
+      self.assertEqual(sources, self.kSources)
+    millis = [int(r['millis']) for _, records in results for r in records]
+    source = [int(r['source']) for _, records in results for r in records]
+    self.assertEqual(millis, [1000, 1000, 42, 1001])
+    self.assertEqual(source, [0, 1, SmuSampleBuffer.kGapSource, 1])
+
+  def test_truncated_record_dropped(self):
+    # a partial trailing record at the end of the stream is not returned
+    results = self.stream([header(self.kSources, 17) + self.kRecords[:-3]])
+    self.assertEqual(len(results[0]), 3)
+    self.assertEqual(results[0][-1], SmuSampleGap(42))
+
+  def test_unknown_version(self):
+    with self.assertRaises(Exception):
+      self.stream([bytes([SmuSampleBuffer.kBinaryFormatVersion + 1, 0]) + struct.pack('<I', 0)])
+
+
+if __name__ == '__main__':
+  unittest.main()